@@ -0,0 +1,564 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include "memory.h"
+#include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+#include "columnar_types.h"
+#include "columnar_simd.h"
+#include "columnar_datagen.h"
+#include "columnar_threadpool.h"
+#include "columnar_jit.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define BENCH_HAVE_PERF 1
+#else
+#define BENCH_HAVE_PERF 0
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+// Keys hashed and probed per probe_hash_batch call
+#define BENCH_PROBE_BATCH 1024
+#define BENCH_PERF_COUNTERS 4
+
+typedef enum {
+    PHASE_BUILD,            // Hash table build from the build keys
+    PHASE_PROBE,            // Single-threaded batch probe into row pairs
+    PHASE_MATERIALIZE,      // Columnar gather of the row pairs
+    PHASE_LATE_MATERIALIZE, // Probe key and build payload of the row pairs, strings as views
+    PHASE_JOIN,             // End-to-end flexible join on the thread pool
+    PHASE_SEMI_JOIN,        // LEFT_SEMI_JOIN of the same inputs (key set build)
+    PHASE_JIT_JOIN,         // Single-threaded join with a JIT-compiled pipeline
+    NUM_PHASES
+} BenchPhase;
+
+static const char* phase_names[NUM_PHASES] = {"build", "probe", "materialize", "late-mat",
+                                               "join", "semi-join", "jit-join"};
+
+typedef struct {
+    NDBDataGenOptions data;
+    int hash_function;      // -1 = all
+    int simd_level;         // -1 = all supported
+    int num_threads;
+    int bloom_filter;       // NDBJoinOptions.bloom_filter of the join phases
+    int repeat;
+    int use_perf;
+} BenchOptions;
+
+typedef struct {
+    double seconds;
+    uint64_t tsc;
+    uint64_t counters[BENCH_PERF_COUNTERS];
+} PhaseResult;
+
+// =================== Timers and counters ===================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t read_tsc(void) {
+#if BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    int fds[BENCH_PERF_COUNTERS];
+    int available;
+} PerfCounters;
+
+static const char* perf_counter_names[BENCH_PERF_COUNTERS] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"
+};
+
+static void open_perf_counters(PerfCounters* perf, int wanted) {
+    perf->available = 0;
+    for (int i = 0; i < BENCH_PERF_COUNTERS; i++) {
+        perf->fds[i] = -1;
+    }
+#if BENCH_HAVE_PERF
+    if (!wanted) {
+        return;
+    }
+    static const uint64_t configs[BENCH_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < BENCH_PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // Counts the calling thread only, i.e. the single-threaded phases
+        perf->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (perf->fds[i] < 0) {
+            fprintf(stderr, "Warning: perf_event_open(%s) failed, hardware counters disabled\n",
+                    perf_counter_names[i]);
+            for (int j = 0; j < i; j++) {
+                close(perf->fds[j]);
+                perf->fds[j] = -1;
+            }
+            return;
+        }
+    }
+    perf->available = 1;
+#else
+    if (wanted) {
+        fprintf(stderr, "Warning: hardware counters need Linux perf_event_open\n");
+    }
+#endif
+}
+
+static void close_perf_counters(PerfCounters* perf) {
+    for (int i = 0; i < BENCH_PERF_COUNTERS; i++) {
+        if (perf->fds[i] >= 0) {
+            close(perf->fds[i]);
+        }
+    }
+}
+
+static void start_phase(PerfCounters* perf, PhaseResult* result) {
+#if BENCH_HAVE_PERF
+    for (int i = 0; perf->available && i < BENCH_PERF_COUNTERS; i++) {
+        ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    result->seconds = now_seconds();
+    result->tsc = read_tsc();
+}
+
+static void stop_phase(PerfCounters* perf, PhaseResult* result) {
+    result->tsc = read_tsc() - result->tsc;
+    result->seconds = now_seconds() - result->seconds;
+    memset(result->counters, 0, sizeof(result->counters));
+#if BENCH_HAVE_PERF
+    for (int i = 0; perf->available && i < BENCH_PERF_COUNTERS; i++) {
+        ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf->fds[i], &result->counters[i], sizeof(uint64_t)) != sizeof(uint64_t)) {
+            result->counters[i] = 0;
+        }
+    }
+#endif
+}
+
+// =================== Benchmark ===================
+
+static NDBTableC* create_result_table(const NDBTableC* probe, const NDBTableC* build) {
+    NDBFieldC schema[4];
+    int columns = 0;
+    for (int c = 0; c < probe->num_columns; c++) schema[columns++] = probe->fields[c];
+    for (int c = 0; c < build->num_columns; c++) schema[columns++] = build->fields[c];
+    return create_ndb_table(1, columns, schema);
+}
+
+// Probe key and build payload; a string payload stays in the build table
+static NDBTableC* create_projection_table(const NDBTableC* probe, const NDBTableC* build, NDBTableC** view) {
+    NDBFieldC schema[2] = {probe->fields[0], build->fields[build->num_columns - 1]};
+    *view = NULL;
+    if (schema[1].type_id == NDB_TYPE_STRING) {
+        *view = view_ndb_string_column(build, build->num_columns - 1);
+        if (!*view) {
+            return NULL;
+        }
+        schema[1].type_id = NDB_TYPE_STRING_VIEW;
+    }
+    NDBTableC* table = create_ndb_table(1, 2, schema);
+    if (table) {
+        table->columns[1].dictionary = *view;
+    } else {
+        free_ndb_table(*view);
+    }
+    return table;
+}
+
+// One repetition of every phase; returns output rows or -1 on failure
+static int64_t run_phases(const BenchOptions* options, NDBHashFunction hash_function,
+                          NDBTableC* build, NDBTableC* probe,
+                          PerfCounters* perf, PhaseResult* results) {
+    const int32_t* build_keys = (const int32_t*)build->columns[0].values;
+    const int32_t* probe_keys = (const int32_t*)probe->columns[0].values;
+    HashTable table;
+    NDBRowPairs pairs;
+    init_ndb_row_pairs(&pairs);
+    int64_t output_rows = -1;
+
+    start_phase(perf, &results[PHASE_BUILD]);
+    int status = init_hash_table(&table, build->num_rows, hash_function);
+    if (status == 0) {
+        status = build_hash_table(&table, build_keys, NULL, NULL, build->num_rows);
+    }
+    stop_phase(perf, &results[PHASE_BUILD]);
+    if (status != 0) {
+        free_hash_table(&table);
+        return -1;
+    }
+
+    start_phase(perf, &results[PHASE_PROBE]);
+    uint64_t hashes[BENCH_PROBE_BATCH];
+    for (int base = 0; base < probe->num_rows && status == 0; base += BENCH_PROBE_BATCH) {
+        int n = probe->num_rows - base < BENCH_PROBE_BATCH ? probe->num_rows - base : BENCH_PROBE_BATCH;
+        ndb_hash_keys(hash_function, probe_keys + base, hashes, n);
+        HashProbeCursor cursor;
+        init_hash_probe_cursor(&cursor);
+        while (cursor.key_idx < n) {
+            if (reserve_ndb_row_pairs(&pairs, BENCH_PROBE_BATCH) != 0) {
+                status = -1;
+                break;
+            }
+            pairs.count += probe_hash_batch(&table, probe_keys + base, hashes, n, base, 0, &cursor,
+                                            pairs.left_rows + pairs.count, pairs.right_rows + pairs.count,
+                                            (int)(pairs.capacity - pairs.count));
+        }
+    }
+    stop_phase(perf, &results[PHASE_PROBE]);
+    free_hash_table(&table);
+
+    NDBTableC* result = status == 0 ? create_result_table(probe, build) : NULL;
+    if (result) {
+        int result_rows = 0;
+        start_phase(perf, &results[PHASE_MATERIALIZE]);
+        status = materialize_ndb_row_pairs(&pairs, 0, pairs.count, probe, build, result, &result_rows);
+        stop_phase(perf, &results[PHASE_MATERIALIZE]);
+        output_rows = status == 0 ? result_rows : -1;
+        free_ndb_table(result);
+    }
+    NDBTableC* view = NULL;
+    NDBTableC* projection = output_rows >= 0 ? create_projection_table(probe, build, &view) : NULL;
+    if (projection) {
+        NDBOutputColumn columns[2] = {{1, 0}, {0, build->num_columns - 1}};
+        int projection_rows = 0;
+        start_phase(perf, &results[PHASE_LATE_MATERIALIZE]);
+        status = materialize_ndb_projection(&pairs, 0, pairs.count, probe, build, columns, 2,
+                                            projection, &projection_rows);
+        stop_phase(perf, &results[PHASE_LATE_MATERIALIZE]);
+        if (status != 0 || projection_rows != output_rows) {
+            output_rows = -1;
+        }
+        free_ndb_table(projection);
+        free_ndb_table(view);
+    } else {
+        output_rows = -1;
+    }
+    free_ndb_row_pairs(&pairs);
+    if (output_rows < 0) {
+        return -1;
+    }
+
+    NDBJoinOptions join_options;
+    init_ndb_join_options(&join_options);
+    join_options.num_threads = options->num_threads;
+    join_options.bloom_filter = options->bloom_filter;
+    join_options.hash_function = hash_function;
+    result = create_result_table(probe, build);
+    if (!result) {
+        return -1;
+    }
+    int join_rows = 0;
+    start_phase(perf, &results[PHASE_JOIN]);
+    flexible_ndb_hash_join_with_options(probe, build, 0, 0, INNER_JOIN, result, &join_rows,
+                                        standard_ndb_match_processor, standard_ndb_unmatch_processor,
+                                        &join_options);
+    stop_phase(perf, &results[PHASE_JOIN]);
+    free_ndb_table(result);
+    if (join_rows != output_rows) {
+        fprintf(stderr, "Error: join produced %d rows, phased run %lld\n", join_rows, (long long)output_rows);
+        return -1;
+    }
+
+    result = create_ndb_table(1, probe->num_columns, probe->fields);
+    if (!result) {
+        return -1;
+    }
+    start_phase(perf, &results[PHASE_SEMI_JOIN]);
+    flexible_ndb_hash_join_with_options(probe, build, 0, 0, LEFT_SEMI_JOIN, result, &join_rows,
+                                        NULL, standard_ndb_unmatch_processor, &join_options);
+    stop_phase(perf, &results[PHASE_SEMI_JOIN]);
+    free_ndb_table(result);
+    if (join_rows > output_rows) {
+        fprintf(stderr, "Error: semi join produced %d rows, join %lld\n", join_rows, (long long)output_rows);
+        return -1;
+    }
+
+    // The kernel is compiled on the first repetition and cached after it
+    results[PHASE_JIT_JOIN].seconds = 0.0;
+    if (!ndb_jit_available()) {
+        return output_rows;
+    }
+    result = create_result_table(probe, build);
+    if (!result) {
+        return -1;
+    }
+    start_phase(perf, &results[PHASE_JIT_JOIN]);
+    status = jit_ndb_hash_join(probe, build, 0, 0, INNER_JOIN, NULL, 0, result, &join_rows, &join_options);
+    stop_phase(perf, &results[PHASE_JIT_JOIN]);
+    free_ndb_table(result);
+    if (status != 0 || join_rows != output_rows) {
+        fprintf(stderr, "Error: JIT join produced %d rows, phased run %lld\n", join_rows, (long long)output_rows);
+        return -1;
+    }
+    return output_rows;
+}
+
+static void print_phase(NDBHashFunction hash_function, SimdLevel level, BenchPhase phase,
+                        const PhaseResult* result, int64_t rows, int have_counters) {
+    double per_row = rows > 0 ? 1.0 / (double)rows : 0.0;
+    printf("%-15s %-7s %-12s %10.2f %10.1f", ndb_hash_function_name(hash_function),
+           simd_level_name(level), phase_names[phase], result->seconds * 1e3,
+           result->seconds > 0 ? (double)rows / result->seconds / 1e6 : 0.0);
+    if (BENCH_HAVE_TSC) {
+        printf(" %10.1f", (double)result->tsc * per_row);
+    } else {
+        printf(" %10s", "n/a");
+    }
+    if (have_counters && phase != PHASE_JOIN && phase != PHASE_SEMI_JOIN) {
+        for (int i = 0; i < BENCH_PERF_COUNTERS; i++) {
+            printf(" %12.2f", (double)result->counters[i] * per_row);
+        }
+    }
+    printf("\n");
+}
+
+static int run_config(const BenchOptions* options, NDBHashFunction hash_function, SimdLevel level,
+                      NDBTableC* build, NDBTableC* probe, PerfCounters* perf) {
+    simd_set_level(level);
+
+    PhaseResult best[NUM_PHASES];
+    for (int p = 0; p < NUM_PHASES; p++) {
+        best[p].seconds = DBL_MAX;
+    }
+    int64_t output_rows = 0;
+    for (int r = 0; r < options->repeat; r++) {
+        PhaseResult results[NUM_PHASES];
+        output_rows = run_phases(options, hash_function, build, probe, perf, results);
+        if (output_rows < 0) {
+            fprintf(stderr, "Error: benchmark run failed (%s, %s)\n",
+                    ndb_hash_function_name(hash_function), simd_level_name(level));
+            return -1;
+        }
+        for (int p = 0; p < NUM_PHASES; p++) {
+            if (results[p].seconds < best[p].seconds) {
+                best[p] = results[p];
+            }
+        }
+    }
+
+    int64_t phase_rows[NUM_PHASES] = {
+        [PHASE_BUILD] = build->num_rows,
+        [PHASE_PROBE] = probe->num_rows,
+        [PHASE_MATERIALIZE] = output_rows,
+        [PHASE_LATE_MATERIALIZE] = output_rows,
+        [PHASE_JOIN] = (int64_t)build->num_rows + probe->num_rows,
+        [PHASE_SEMI_JOIN] = (int64_t)build->num_rows + probe->num_rows,
+        [PHASE_JIT_JOIN] = (int64_t)build->num_rows + probe->num_rows,
+    };
+    for (int p = 0; p < NUM_PHASES; p++) {
+        if (p == PHASE_JIT_JOIN && !ndb_jit_available()) {
+            continue;
+        }
+        print_phase(hash_function, level, (BenchPhase)p, &best[p], phase_rows[p], perf->available);
+    }
+    return 0;
+}
+
+// =================== Command line ===================
+
+static void usage(const char* program) {
+    printf("Usage: %s [options]\n"
+           "  --build-rows N      build (right) side rows (default 1048576)\n"
+           "  --probe-rows N      probe (left) side rows (default 4194304)\n"
+           "  --dist D            uniform | zipf | sequential (default uniform)\n"
+           "  --theta T           Zipf skew in (0, 1) (default 0.99)\n"
+           "  --match-rate R      fraction of probe rows with a match (default 1.0)\n"
+           "  --dup N             build rows per distinct key (default 1)\n"
+           "  --width N           payload string bytes per row, 0 = none (default 16)\n"
+           "  --seed N            generator seed (default 42)\n"
+           "  --hash H            multiply-shift | crc32c | xxh3 | all (default multiply-shift)\n"
+           "  --simd L            scalar | avx2 | avx512 | all (default: best supported)\n"
+           "  --threads N         join worker threads, 0 = all cores (default 0)\n"
+           "  --bloom B           auto | on | off: Bloom filter in the join phases (default auto)\n"
+           "  --repeat N          repetitions, the fastest is reported (default 3)\n"
+           "  --perf              add perf_event_open counters per row\n",
+           program);
+}
+
+static int parse_choice(const char* value, const char* const* names, int count) {
+    if (strcmp(value, "all") == 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -2;
+}
+
+static int parse_options(int argc, char** argv, BenchOptions* options) {
+    static const char* const dist_names[] = {"uniform", "zipf", "sequential"};
+    static const char* const hash_names[] = {"multiply-shift", "crc32c", "xxh3"};
+    static const char* const simd_names[] = {"scalar", "avx2", "avx512"};
+    static const char* const bloom_names[] = {"off", "auto", "on"};
+    static const struct option long_options[] = {
+        {"build-rows", required_argument, NULL, 'b'},
+        {"probe-rows", required_argument, NULL, 'p'},
+        {"dist", required_argument, NULL, 'd'},
+        {"theta", required_argument, NULL, 't'},
+        {"match-rate", required_argument, NULL, 'm'},
+        {"dup", required_argument, NULL, 'u'},
+        {"width", required_argument, NULL, 'w'},
+        {"seed", required_argument, NULL, 's'},
+        {"hash", required_argument, NULL, 'H'},
+        {"simd", required_argument, NULL, 'S'},
+        {"threads", required_argument, NULL, 'T'},
+        {"bloom", required_argument, NULL, 'B'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"perf", no_argument, NULL, 'P'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    init_ndb_datagen_options(&options->data);
+    options->hash_function = NDB_HASH_DEFAULT;
+    options->simd_level = simd_detected_level();
+    options->num_threads = 0;
+    options->bloom_filter = 0;
+    options->repeat = 3;
+    options->use_perf = 0;
+
+    int opt, choice;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'b': options->data.build_rows = atoi(optarg); break;
+        case 'p': options->data.probe_rows = atoi(optarg); break;
+        case 'd':
+            choice = parse_choice(optarg, dist_names, 3);
+            if (choice < 0) {
+                fprintf(stderr, "Error: unknown distribution '%s'\n", optarg);
+                return -1;
+            }
+            options->data.distribution = (NDBKeyDistribution)choice;
+            break;
+        case 't': options->data.zipf_theta = atof(optarg); break;
+        case 'm': options->data.match_rate = atof(optarg); break;
+        case 'u': options->data.duplicates = atoi(optarg); break;
+        case 'w': options->data.string_width = atoi(optarg); break;
+        case 's': options->data.seed = strtoull(optarg, NULL, 10); break;
+        case 'H':
+            options->hash_function = parse_choice(optarg, hash_names, 3);
+            if (options->hash_function < -1) {
+                fprintf(stderr, "Error: unknown hash function '%s'\n", optarg);
+                return -1;
+            }
+            break;
+        case 'S':
+            options->simd_level = parse_choice(optarg, simd_names, 3);
+            if (options->simd_level < -1) {
+                fprintf(stderr, "Error: unknown SIMD level '%s'\n", optarg);
+                return -1;
+            }
+            break;
+        case 'T': options->num_threads = atoi(optarg); break;
+        case 'B':
+            choice = parse_choice(optarg, bloom_names, 3);
+            if (choice < 0) {
+                fprintf(stderr, "Error: unknown Bloom filter mode '%s'\n", optarg);
+                return -1;
+            }
+            options->bloom_filter = choice - 1;
+            break;
+        case 'r': options->repeat = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'P': options->use_perf = 1; break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (options->simd_level > (int)simd_detected_level()) {
+        fprintf(stderr, "Error: this CPU supports SIMD up to %s\n", simd_level_name(simd_detected_level()));
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (parse_options(argc, argv, &options) != 0) {
+        return 1;
+    }
+
+    NDBTableC* build = NULL;
+    NDBTableC* probe = NULL;
+    double gen_start = now_seconds();
+    if (generate_ndb_join_inputs(&options.data, &build, &probe) != 0) {
+        fprintf(stderr, "Error: failed to generate input tables (check the options)\n");
+        return 1;
+    }
+
+    printf("column_join_bench: build %d rows, probe %d rows, %s keys", build->num_rows, probe->num_rows,
+           ndb_key_distribution_name(options.data.distribution));
+    if (options.data.distribution == NDB_KEYS_ZIPF) {
+        printf(" (theta %.2f)", options.data.zipf_theta);
+    }
+    printf(", match rate %.2f, %d dup, %d byte strings, generated in %.2f s\n",
+           options.data.match_rate, options.data.duplicates, options.data.string_width,
+           now_seconds() - gen_start);
+    printf("cycles/row counts %s; the join phase runs on %d thread(s)\n",
+           BENCH_HAVE_TSC ? "TSC ticks" : "nothing (no TSC)",
+           options.num_threads > 0 ? options.num_threads : online_core_count());
+
+    PerfCounters perf;
+    open_perf_counters(&perf, options.use_perf);
+
+    printf("%-15s %-7s %-12s %10s %10s %10s", "hash", "simd", "phase", "ms", "Mrows/s", "cycles/row");
+    if (perf.available) {
+        for (int i = 0; i < BENCH_PERF_COUNTERS; i++) {
+            printf(" %12s", perf_counter_names[i]);
+        }
+    }
+    printf("\n");
+
+    int status = 0;
+    for (int h = 0; h < 3 && status == 0; h++) {
+        if (options.hash_function >= 0 && options.hash_function != h) {
+            continue;
+        }
+        for (int level = 0; level <= (int)simd_detected_level() && status == 0; level++) {
+            if (options.simd_level >= 0 && options.simd_level != level) {
+                continue;
+            }
+            status = run_config(&options, (NDBHashFunction)h, (SimdLevel)level, build, probe, &perf);
+        }
+    }
+
+    close_perf_counters(&perf);
+    free_ndb_table(build);
+    free_ndb_table(probe);
+    return status == 0 ? 0 : 1;
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "memory.h"
 #include "columnar_hashjoin.h"
+#include "columnar_types.h"
 
 void print_table(const NDBTableC* table) {
     for (int row = 0; row < table->num_rows; row++) {
@@ -20,15 +21,9 @@ void print_table(const NDBTableC* table) {
                 }
             }
             
-            if (array->type_id == 0) {  // int32
-                int32_t* data = (int32_t*)array->values;
-                printf("%s: %d\t", field->name, data[row]);
-            } else if (array->type_id == 1) {  // string
-                int32_t start = array->offsets[row];
-                int32_t end = array->offsets[row + 1];
-                char* str = (char*)array->values + start;
-                printf("%s: %.*s\t", field->name, end - start, str);
-            }
+            char value[256];
+            format_ndb_value(table, col, row, value, sizeof(value));
+            printf("%s: %s\t", field->name, value);
         }
         printf("\n");
     }
@@ -92,11 +87,33 @@ NDBTableC* create_department_table() {
     return table;
 }
 
+// Department table whose dept_name of emp_id 3 is NULL, written row by row
+NDBTableC* create_department_table_with_null() {
+    NDBFieldC schema[2] = {
+        {.name = "emp_id", .type_id = 0, .nullable = 0},     // int32, not null
+        {.name = "dept_name", .type_id = 1, .nullable = 1}   // string, nullable
+    };
+
+    NDBTableC* table = create_ndb_table(5, 2, schema);
+    int32_t emp_ids[] = {2, 3, 4, 5};
+    const char* dept_names[] = {"Engineering", NULL, "Sales", "HR"};
+    for (int i = 0; i < 4; i++) {
+        table->num_rows = i + 1;
+        ((int32_t*)table->columns[0].values)[i] = emp_ids[i];
+        if (dept_names[i]) {
+            set_ndb_string_value(table, 1, i, dept_names[i], strlen(dept_names[i]));
+        } else {
+            set_ndb_value_null(table, 1, i);
+        }
+    }
+    return table;
+}
+
 // Create result table for storing join results
 NDBTableC* create_result_table() {
     NDBFieldC schema[4] = {
-        {.name = "emp_id", .type_id = 0, .nullable = 0},       // int32, not null
-        {.name = "emp_name", .type_id = 1, .nullable = 0},     // string, not null
+        {.name = "emp_id", .type_id = 0, .nullable = 1},       // int32, nullable (for FULL JOIN)
+        {.name = "emp_name", .type_id = 1, .nullable = 1},     // string, nullable (for FULL JOIN)
         {.name = "emp_id_right", .type_id = 0, .nullable = 1}, // int32, nullable (for LEFT JOIN)
         {.name = "dept_name", .type_id = 1, .nullable = 1}     // string, nullable (for LEFT JOIN)
     };
@@ -135,23 +152,13 @@ void print_table_debug(const NDBTableC* table, const char* table_name) {
                 continue;
             }
             
-            if (array->type_id == 0) {  // int32
-                if (!array->values) {
-                    printf("%s: <NULL_PTR>\t", field->name);
-                    continue;
-                }
-                int32_t* data = (int32_t*)array->values;
-                printf("%s: %d\t", field->name, data[row]);
-            } else if (array->type_id == 1) {  // string
-                if (!array->values || !array->offsets) {
-                    printf("%s: <NULL_PTR>\t", field->name);
-                    continue;
-                }
-                int32_t start = array->offsets[row];
-                int32_t end = array->offsets[row + 1];
-                char* str = (char*)array->values + start;
-                printf("%s: %.*s\t", field->name, end - start, str);
+            if (!array->values || (array->type_id == NDB_TYPE_STRING && !array->offsets)) {
+                printf("%s: <NULL_PTR>\t", field->name);
+                continue;
             }
+            char value[256];
+            format_ndb_value(table, col, row, value, sizeof(value));
+            printf("%s: %s\t", field->name, value);
         }
         printf("\n");
     }
@@ -223,6 +230,29 @@ int main() {
     // print_table_debug(result_table, "LEFT JOIN result table");
     print_table(result_table);
 
+    // FULL OUTER JOIN keeps unmatched rows of both sides
+    printf("\n--- FULL OUTER JOIN Result ---\n");
+    result_row_count = 0;
+    
+    free_ndb_table(result_table);
+    result_table = create_result_table();
+    
+    flexible_ndb_hash_join(
+        emp_table,           // Left table (employee table)
+        dept_table,          // Right table (department table)
+        0,                   // Left table join key column index (emp_id)
+        0,                   // Right table join key column index (emp_id)
+        FULL_JOIN,           // Join type
+        result_table,        // Result table
+        &result_row_count,   // Result row count
+        standard_ndb_match_processor,    // Match processor
+        standard_ndb_unmatch_processor   // Unmatch processor
+    );
+    
+    printf("FULL OUTER JOIN result (emp_id = emp_id):\n");
+    printf("Total rows: %d\n", result_row_count);
+    print_table(result_table);
+
     // Demonstrate selective join
     printf("\n--- Selective join (only select specific columns) ---\n");
     result_row_count = 0;
@@ -254,6 +284,48 @@ int main() {
     // print_table_debug(result_table, "selective join result table");
     print_table(result_table);
 
+    // A NULL string on the matched side must stay NULL and leave later rows intact
+    printf("\n--- Selective join with a NULL dept_name ---\n");
+    result_row_count = 0;
+    
+    free_ndb_table(result_table);
+    simple_schema[1].nullable = 1;
+    result_table = create_ndb_table(1, 2, simple_schema);
+    NDBTableC* null_dept_table = create_department_table_with_null();
+    
+    flexible_ndb_hash_join(
+        emp_table,           // Left table (employee table)
+        null_dept_table,     // Right table (dept_name of emp_id 3 is NULL)
+        0,                   // Left table join key column index (emp_id)
+        0,                   // Right table join key column index (emp_id)
+        INNER_JOIN,          // Join type
+        result_table,        // Result table
+        &result_row_count,   // Result row count
+        selective_ndb_match_processor,   // Selective match processor
+        NULL                               // Don't handle unmatched
+    );
+    
+    printf("Rows: %d\n", result_row_count);
+    print_table(result_table);
+    
+    // Expected: emp 2 Engineering, emp 3 NULL, emp 4 Sales, in any order
+    int status = result_row_count == 3 ? 0 : 1;
+    for (int row = 0; row < result_row_count && status == 0; row++) {
+        int32_t emp_id = ((int32_t*)result_table->columns[0].values)[row];
+        const char* expected = emp_id == 2 ? "Engineering" : emp_id == 4 ? "Sales" : NULL;
+        char* name;
+        int len;
+        get_ndb_string_value(result_table, 1, row, &name, &len);
+        if (expected ? (!name || len != (int)strlen(expected) || memcmp(name, expected, len) != 0)
+                     : (emp_id != 3 || !is_ndb_value_null(result_table, 1, row))) {
+            status = 1;
+        }
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error: selective join lost the NULL dept_name\n");
+    }
+    free_ndb_table(null_dept_table);
+
     // Clean up memory
     free_ndb_table(emp_table);
     free_ndb_table(dept_table);
@@ -261,5 +333,5 @@ int main() {
 
     printf("\n=== Hash join example completed ===\n");
 
-    return 0;
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef COLUMNAR_ARENA_H
+#define COLUMNAR_ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for table buffers. Memory is carved from chunks whose
+// size doubles as the arena fills, is handed out uninitialized and is
+// only released all at once by ndb_arena_destroy. Blocks of at least
+// NDB_ARENA_BLOCK_BYTES get a chunk of their own instead, which is freed
+// as soon as the block is resized.
+typedef struct NDBArenaChunk NDBArenaChunk;
+
+#define NDB_ARENA_BLOCK_BYTES (64 * 1024)
+
+typedef struct NDBArena {
+    NDBArenaChunk* chunks;      // Chunk being carved first, then older ones
+    NDBArenaChunk* blocks;      // Chunks holding one large block each
+    size_t next_chunk_size;     // Size of the next regular chunk
+    size_t reserved_bytes;      // Total size of all chunks
+} NDBArena;
+
+// initial_bytes sizes the first chunk (0 = default)
+NDBArena* ndb_arena_create(size_t initial_bytes);
+void ndb_arena_destroy(NDBArena* arena);
+
+// 64-byte aligned block of size bytes, NULL when out of memory
+void* ndb_arena_alloc(NDBArena* arena, size_t size);
+
+// Resize a block of old_size bytes. A large block moves and its chunk is
+// freed; the most recent small block of the current chunk grows in place
+// while it stays small and fits; any other small block moves and stays
+// dead until the arena is destroyed. Growing buffers thus leave less
+// than 2 * NDB_ARENA_BLOCK_BYTES dead behind each.
+void* ndb_arena_realloc(NDBArena* arena, void* ptr, size_t old_size, size_t new_size);
+
+#endif /* COLUMNAR_ARENA_H */
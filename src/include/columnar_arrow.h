@@ -0,0 +1,76 @@
+#ifndef COLUMNAR_ARROW_H
+#define COLUMNAR_ARROW_H
+
+#include <stdint.h>
+#include "memory.h"
+
+// Exchange of tables with Arrow through the Arrow C data interface
+// (https://arrow.apache.org/docs/format/CDataInterface.html). A table
+// travels as a struct array with one child per column; no buffer is
+// copied in either direction.
+//
+//   int32 "i", int64 "l", float64 "g", date32 "tdD", timestamp "tsu:..."
+//   (microseconds, any time zone), string "u" (int32 offsets), dictionary
+//   string: int32 indices "i" with a "u" dictionary
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  // Array type description
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+
+  // Release callback
+  void (*release)(struct ArrowSchema*);
+  // Opaque producer-specific data
+  void* private_data;
+};
+
+struct ArrowArray {
+  // Array data description
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+
+  // Release callback
+  void (*release)(struct ArrowArray*);
+  // Opaque producer-specific data
+  void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+// Wrap a struct array described by schema as a table whose columns point
+// at the Arrow buffers. On success the table takes over array (its
+// release is called by free_ndb_table and array is marked released);
+// schema stays with the caller. Sliced arrays keep their values in place,
+// only unaligned validity bitmaps and non-zero based offsets are copied.
+// An Arrow dictionary must hold distinct non-NULL strings. Returns NULL on
+// an unsupported or malformed input, leaving array to the caller.
+NDBTableC* import_ndb_arrow_table(const struct ArrowSchema* schema, struct ArrowArray* array);
+
+// Describe rows 0 .. num_rows of table as a struct array. The exported
+// arrays point at the table's buffers, so the table moves into the export:
+// on success it must not be used or freed any more, and is freed when the
+// consumer has released the array and every child it moved out. The
+// dictionaries of dictionary columns must live until then. The schema is
+// independent of the table. Returns 0 on success; -1 on an unsupported
+// column or when out of memory, with the table still the caller's.
+int export_ndb_arrow_table(NDBTableC* table, struct ArrowSchema* schema, struct ArrowArray* array);
+
+#endif /* COLUMNAR_ARROW_H */
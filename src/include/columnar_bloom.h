@@ -0,0 +1,59 @@
+#ifndef COLUMNAR_BLOOM_H
+#define COLUMNAR_BLOOM_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "columnar_hash.h"
+
+// Bits of filter per distinct key; with 4 bits set per key this keeps
+// the false positive rate of the register-blocked layout around 1%
+#define NDB_BLOOM_BITS_PER_KEY 16
+
+// Register-blocked Bloom filter over key hashes: every key maps to one
+// 64-bit block and sets 4 bits in it, so a test is one load and a
+// compare. Built from the same hashes as the hash table, it lets a probe
+// drop most misses before touching a bucket.
+typedef struct {
+    uint64_t* blocks;           // NULL = no filter, every key passes
+    uint64_t block_mask;        // num_blocks - 1, num_blocks is a power of two
+} NDBBloomFilter;
+
+// The block comes from hash bits 32 and up, the bit positions from bits
+// 0..23; the SIMD kernels compute the same
+static inline uint64_t ndb_bloom_block(uint64_t hash, uint64_t block_mask) {
+    return (hash >> 32) & block_mask;
+}
+
+static inline uint64_t ndb_bloom_bits(uint64_t hash) {
+    return (1ULL << (hash & 63)) | (1ULL << ((hash >> 6) & 63)) |
+           (1ULL << ((hash >> 12) & 63)) | (1ULL << ((hash >> 18) & 63));
+}
+
+// Size an empty filter for expected_keys distinct keys, 0 on success
+int init_ndb_bloom_filter(NDBBloomFilter* filter, int64_t expected_keys);
+void free_ndb_bloom_filter(NDBBloomFilter* filter);
+
+void add_ndb_bloom_hashes(NDBBloomFilter* filter, const uint64_t* hashes, int count);
+
+// Bit i of pass[i / 64] is set when hashes[i] may be in the filter;
+// pass holds (count + 63) / 64 words. Tests 4 (AVX2) or 8 (AVX-512)
+// hashes per instruction sequence.
+void test_ndb_bloom_hashes(const NDBBloomFilter* filter, const uint64_t* hashes, int count, uint64_t* pass);
+
+// Filter over the key column of a build table, for pushing into a scan of
+// the probe side before the join. The key column must be int32 or date32
+// (other keys join through codes the filter cannot know); rows with a
+// NULL key are left out. Returns 0 on success, -1 on another key column
+// or when out of memory.
+int build_ndb_bloom_filter(NDBBloomFilter* filter, const NDBTableC* table, int key_column,
+                           NDBHashFunction hash_function);
+
+// Scan rows [start, start + count) of the key column and write the rows
+// whose key may match to rows; a NULL key never does. Returns how many
+// were written (<= count), or -1 on a key column build_ndb_bloom_filter
+// rejects or rows outside the table. hash_function must be the one the
+// filter was built with.
+int filter_ndb_rows(const NDBBloomFilter* filter, const NDBTableC* table, int key_column,
+                    NDBHashFunction hash_function, int start, int count, int32_t* rows);
+
+#endif /* COLUMNAR_BLOOM_H */
@@ -0,0 +1,38 @@
+#ifndef COLUMNAR_DATAGEN_H
+#define COLUMNAR_DATAGEN_H
+
+#include <stdint.h>
+#include "memory.h"
+
+// How probe rows pick among the distinct build keys
+typedef enum {
+    NDB_KEYS_UNIFORM,       // Every build key equally likely
+    NDB_KEYS_ZIPF,          // Skewed: a few hot keys take most probes
+    NDB_KEYS_SEQUENTIAL     // Build keys sorted, probes walk them in order
+} NDBKeyDistribution;
+
+// Synthetic join inputs: build (right) and probe (left) tables with
+// columns {key int32, payload string}. Build key k occurs `duplicates`
+// times; probe rows hit a build key with probability match_rate, misses
+// use keys absent from the build side.
+typedef struct {
+    int build_rows;
+    int probe_rows;
+    NDBKeyDistribution distribution;
+    double zipf_theta;      // Skew of NDB_KEYS_ZIPF, in (0, 1)
+    double match_rate;      // Fraction of probe rows with a build match
+    int duplicates;         // Build rows per distinct key
+    int string_width;       // Payload bytes per row, 0 = no payload column
+    uint64_t seed;
+} NDBDataGenOptions;
+
+void init_ndb_datagen_options(NDBDataGenOptions* options);
+
+// Generate both tables; returns 0 on success, -1 on bad options or out
+// of memory. Free the tables with free_ndb_table.
+int generate_ndb_join_inputs(const NDBDataGenOptions* options,
+                             NDBTableC** build_table, NDBTableC** probe_table);
+
+const char* ndb_key_distribution_name(NDBKeyDistribution distribution);
+
+#endif /* COLUMNAR_DATAGEN_H */
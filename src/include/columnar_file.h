@@ -0,0 +1,61 @@
+#ifndef COLUMNAR_FILE_H
+#define COLUMNAR_FILE_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "columnar_join_index.h"
+
+// On-disk columnar tables. A file holds every buffer of every column as a
+// 64-byte aligned segment (validity, offsets, values, and the strings of a
+// dictionary column's dictionary), followed by a footer with the schema
+// and per-column statistics. Values are stored in native byte order.
+//
+// Reading a file maps it and points the columns straight at the mapped
+// pages: nothing is copied or parsed per row, pages load on first touch
+// and the page cache shares them between processes. The mapping is
+// private, so writing to a mapped table changes only this process's copy;
+// growing a column copies it into the table's arena.
+//
+// A file may also hold join indexes over the table (columnar_join_index.h),
+// stored as segments of their own, so a reader maps a ready hash table
+// instead of building one.
+
+// Statistics of one column over its non-NULL values
+typedef struct {
+    int64_t null_count;
+    int32_t has_range;          // 1 = the min/max fields of the type are set
+    int32_t max_length;         // Longest string in bytes (string and dictionary string columns)
+    int64_t min_int;            // int32, int64, date32 and timestamp columns
+    int64_t max_int;
+    double min_float;           // float64 columns, NaN left out
+    double max_float;
+} NDBColumnStats;
+
+// Write rows 0 .. num_rows of table to path, replacing the file.
+// Returns 0 on success, -1 on an I/O error or a dictionary column without
+// dictionary.
+int write_ndb_table_file(const NDBTableC* table, const char* path);
+
+// write_ndb_table_file, storing join indexes of table with it so that
+// readers map them (map_ndb_join_index) instead of building them. Each
+// index must have been built over table itself.
+int write_ndb_table_file_with_indexes(const NDBTableC* table, const NDBJoinIndex* const* indexes, int num_indexes,
+                                      const char* path);
+
+// Map a file written by write_ndb_table_file. The table keeps the mapping
+// until free_ndb_table; columns sharing a dictionary when written share
+// one again. Returns NULL on an I/O error or a malformed file.
+NDBTableC* map_ndb_table_file(const char* path);
+
+// Statistics of column of a table returned by map_ndb_table_file, read
+// from the footer. Returns 0, or -1 when the table is not mapped from a
+// file or column is out of range.
+int get_ndb_file_column_stats(const NDBTableC* table, int column, NDBColumnStats* stats);
+
+// The index stored with a table returned by map_ndb_table_file over
+// exactly these key columns, read from the mapping in place: the index
+// must be freed before the table. NULL when the file holds no such index
+// or the table is not mapped from a file.
+NDBJoinIndex* map_ndb_join_index(const NDBTableC* table, const int* key_columns, int num_key_columns);
+
+#endif /* COLUMNAR_FILE_H */
@@ -0,0 +1,23 @@
+#ifndef COLUMNAR_HASH_H
+#define COLUMNAR_HASH_H
+
+#include <stdint.h>
+
+// Key hash functions. Build, probe and radix partitioning must agree on
+// one of them; every function yields a full 64-bit hash whose low bits
+// pick the home bucket, bits 32..38 the slot tag and top bits the partition.
+typedef enum {
+    NDB_HASH_MULTIPLY_SHIFT = 0,    // One multiply, vectorized with AVX2/AVX-512
+    NDB_HASH_CRC32C,                // SSE4.2 crc32 instruction, software fallback
+    NDB_HASH_XXH3                   // XXH3_64bits of the 4 key bytes
+} NDBHashFunction;
+
+#define NDB_HASH_DEFAULT NDB_HASH_MULTIPLY_SHIFT
+
+// Hash one key / keys[0..count) into hashes[0..count)
+uint64_t ndb_hash_key(NDBHashFunction function, int32_t key);
+void ndb_hash_keys(NDBHashFunction function, const int32_t* keys, uint64_t* hashes, int count);
+
+const char* ndb_hash_function_name(NDBHashFunction function);
+
+#endif /* COLUMNAR_HASH_H */
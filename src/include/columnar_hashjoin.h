@@ -3,8 +3,25 @@
 
 #include <stddef.h>
 #include "memory.h"
+#include "columnar_hash.h"
 
-typedef enum { INNER_JOIN, LEFT_JOIN, RIGHT_JOIN } JoinType;
+typedef enum { INNER_JOIN, LEFT_JOIN, RIGHT_JOIN, FULL_JOIN, LEFT_SEMI_JOIN, LEFT_ANTI_JOIN } JoinType;
+
+// Outer joins keep the unmatched rows of the left (probe) and/or right
+// (build) input, with the other side's columns NULL
+static inline int ndb_join_keeps_left(JoinType join_type) {
+    return join_type == LEFT_JOIN || join_type == FULL_JOIN;
+}
+
+static inline int ndb_join_keeps_right(JoinType join_type) {
+    return join_type == RIGHT_JOIN || join_type == FULL_JOIN;
+}
+
+// Semi (EXISTS / IN) and anti (NOT EXISTS) joins output each qualifying
+// left row once and no right columns; the build side is only a key set
+static inline int ndb_join_is_semi(JoinType join_type) {
+    return join_type == LEFT_SEMI_JOIN || join_type == LEFT_ANTI_JOIN;
+}
 
 typedef int (*GetKeyFromNDBColumnFunc)(const NDBTableC* table, int column_idx, int row_idx);
 
@@ -20,7 +37,104 @@ typedef void (*ProcessNDBUnmatchedFunc)(
     int is_left
 );
 
-// Customizable hash join function - using callback functions and NDB format
+// Growable list of (left_row, right_row) join pairs, -1 marks the side
+// that has no match (right = -1: unmatched left row, left = -1: unmatched
+// right row)
+typedef struct {
+    int32_t* left_rows;
+    int32_t* right_rows;
+    int64_t count;
+    int64_t capacity;
+} NDBRowPairs;
+
+void init_ndb_row_pairs(NDBRowPairs* pairs);
+void free_ndb_row_pairs(NDBRowPairs* pairs);
+// Returns 0 on success, -1 when out of memory
+int append_ndb_row_pair(NDBRowPairs* pairs, int32_t left_row, int32_t right_row);
+// Make room for at least extra more pairs, returns 0 on success
+int reserve_ndb_row_pairs(NDBRowPairs* pairs, int64_t extra);
+// Append pairs [start, start + count) of src, returns 0 on success
+int append_ndb_row_pair_range(NDBRowPairs* pairs, const NDBRowPairs* src, int64_t start, int64_t count);
+// Set bit row of the build side matched bitmap for each right_rows[i] >= 0.
+// Safe to call from several threads on the same bitmap.
+void mark_ndb_matched_rows(uint64_t* matched, const int32_t* right_rows, int64_t count);
+// Append (-1, row) for every position p in [0, count) whose matched bit is
+// clear: row = rows[p], or p when rows is NULL. Returns 0 on success.
+int append_unmatched_ndb_rows(NDBRowPairs* pairs, const uint64_t* matched, int count, const int32_t* rows);
+// Append (row, -1), or (-1, row) when !is_left, for every row set in the
+// NULL-key bitmap nulls (see find_ndb_null_keys). Returns 0 on success.
+int append_null_key_ndb_rows(NDBRowPairs* pairs, const uint64_t* nulls, int num_rows, int is_left);
+// Hand pairs [start, start + count) to the processors, in order
+void emit_ndb_row_pairs(
+    const NDBRowPairs* pairs, int64_t start, int64_t count,
+    const NDBTableC* left_table, const NDBTableC* right_table,
+    NDBTableC* result_table, int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor
+);
+
+// Columnar gather: dst[dst_row + i] = src[rows[i]] for i in [0, count),
+// rows[i] = -1 writes NULL. One typed loop per column instead of one
+// callback per value, prefetching the source values ahead. The
+// destination table grows as needed. Dictionary and view columns copy
+// their codes and the destination takes the source's dictionary. A
+// string column gathers into a NDB_TYPE_STRING_VIEW column whose
+// dictionary is a view of it (view_ndb_string_column) as its row numbers,
+// copying no characters. Returns 0 on success, -1 on type or dictionary
+// mismatch or when out of memory.
+int gather_ndb_column(const NDBTableC* src_table, int src_col,
+                      const int32_t* rows, int64_t count,
+                      NDBTableC* dst_table, int dst_col, int dst_row);
+
+// Materialize pairs [start, start + count) at row *result_row_count with
+// the layout of standard_ndb_match_processor (left columns, then right
+// columns), gathering one column at a time. A NULL right_table writes the
+// left columns only. Returns 0 on success.
+int materialize_ndb_row_pairs(
+    const NDBRowPairs* pairs, int64_t start, int64_t count,
+    const NDBTableC* left_table, const NDBTableC* right_table,
+    NDBTableC* result_table, int* result_row_count
+);
+
+// One output column of a late-materialized join: column `column` of the
+// left (is_left = 1) or the right table
+typedef struct {
+    int is_left;
+    int column;
+} NDBOutputColumn;
+
+// Late materialization: write only the projected columns of pairs
+// [start, start + count), columns[c] into result column c, at row
+// *result_row_count. Each column is one gather_ndb_column pass over the
+// row ids, so a string column is copied once per output column, or not
+// at all into a view column. right_table may be NULL when no column is
+// taken from it. Returns 0 on success.
+int materialize_ndb_projection(
+    const NDBRowPairs* pairs, int64_t start, int64_t count,
+    const NDBTableC* left_table, const NDBTableC* right_table,
+    const NDBOutputColumn* columns, int num_columns,
+    NDBTableC* result_table, int* result_row_count
+);
+
+// Whether the joins may replace these processors by
+// materialize_ndb_row_pairs: the standard ones, writing the left columns
+// only (semi/anti) or both sides
+int ndb_join_output_is_columnar(const NDBTableC* left_table, const NDBTableC* result_table, JoinType join_type,
+                                ProcessNDBMatchFunc match_processor, ProcessNDBUnmatchedFunc unmatch_processor);
+
+// Customizable hash join function - using callback functions and NDB format.
+// The probe runs as morsels of left_table rows on the default thread pool;
+// matches are buffered per worker and handed to the processors in left row
+// order once all morsels finished. With the standard processors the
+// matches are materialized column by column instead of row by row.
+// RIGHT_JOIN and FULL_JOIN track which build rows matched and emit the
+// others last, in right row order, through the unmatch processor (is_left = 0).
+// LEFT_SEMI_JOIN and LEFT_ANTI_JOIN build a key set only, stop probing a
+// key at its first match and pass each qualifying left row once to the
+// unmatch processor (is_left = 1); the match processor is not called.
+// With the standard processors result_table takes the left schema.
+// A NULL key equals nothing, not even another NULL: NULL-key rows never
+// match, LEFT/FULL/ANTI keep such left rows and RIGHT/FULL such right rows.
 void flexible_ndb_hash_join(
     const NDBTableC* left_table,
     const NDBTableC* right_table,
@@ -33,6 +147,141 @@ void flexible_ndb_hash_join(
     ProcessNDBUnmatchedFunc unmatch_processor
 );
 
+// Tuning knobs of the joins, 0 means "choose automatically"
+typedef struct {
+    int num_threads;        // Worker threads, 0 = all online cores
+    int radix_bits;         // Total partition bits, 0 = fit one build partition in L2
+    int radix_passes;       // Partitioning passes (1 or 2), 0 = by fan-out
+    NDBHashFunction hash_function;  // Key hash of build, probe and partitioning
+    int bloom_filter;       // Probe-side Bloom filter: 1 = on, -1 = off, 0 = when
+                            // the probe has NDB_BLOOM_AUTO_RATIO x more rows than
+                            // the build has distinct keys and a sample of probe
+                            // keys mostly misses (flexible join only)
+    int64_t memory_limit;   // Bytes the flexible join may spend on its build side,
+                            // 0 = no limit; a larger build runs as a grace join
+    const char* spill_directory;    // Temporary files of the grace join, NULL = $TMPDIR or /tmp
+} NDBJoinOptions;
+
+#define NDB_BLOOM_AUTO_RATIO 4
+
+void init_ndb_join_options(NDBJoinOptions* options);
+
+// flexible_ndb_hash_join with explicit options (NULL = defaults);
+// radix_bits and radix_passes are ignored
+void flexible_ndb_hash_join_with_options(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+);
+
+// Join on several key columns: left_key_columns[k] = right_key_columns[k]
+// for every k < num_key_columns, paired columns of the same key type (see
+// columnar_types.h). One int32, date32 or dictionary column (same
+// dictionary on both sides) joins on its values directly; any other key
+// is normalized into int32 codes first (see columnar_keys.h). The
+// single-column joins also take int64, float64, timestamp and string key
+// columns this way.
+void flexible_ndb_hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+);
+
+// flexible_ndb_hash_join_multi that outputs row ids only, for late
+// materialization: the join's (left_row, right_row) pairs are appended to
+// pairs in the order the processors would see them, -1 marking the
+// missing side (semi and anti joins pair each left row with -1). No
+// column is copied; materialize_ndb_projection then gathers the columns
+// downstream needs. options as for the flexible join (NULL = defaults),
+// except memory_limit: the build always stays in memory. Returns 0, or
+// -1 on bad key columns or when out of memory.
+int flexible_ndb_hash_join_pairs(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBRowPairs* pairs,
+    const NDBJoinOptions* options
+);
+
+// Radix-partitioned parallel hash join: both inputs are partitioned on the
+// key hash, each partition is built and probed by a worker, and the
+// per-partition results are handed to the processors in partition order.
+// Semi/anti joins build a key set per partition, as in the flexible join.
+// NULL keys as in the flexible join; their rows skip the partitioning and
+// the kept ones follow the last partition.
+void partitioned_ndb_hash_join(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+);
+
+// partitioned_ndb_hash_join on several key columns, keys as in
+// flexible_ndb_hash_join_multi
+void partitioned_ndb_hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+);
+
+// Grace hash join for build sides larger than options->memory_limit: the
+// (key, row) pairs of both inputs are hash-partitioned into temporary
+// files, then each partition is built and probed on its own, probe rows
+// streamed in chunks. Partitions whose build still exceeds the limit are
+// partitioned again on further hash bits. Memory stays around the limit
+// plus the output of one chunk, whatever the input sizes (keys that need
+// codes are encoded in memory first, see columnar_keys.h). Results come
+// partition by partition, NULL-key rows last. Without a limit the
+// partitions are sized for 64 MB builds.
+void grace_ndb_hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+);
+
+// Estimated bytes a hash join build of build_rows rows holds
+int64_t estimate_ndb_build_bytes(int64_t build_rows);
+
 // Predefined callback functions - NDB version
 void standard_ndb_match_processor(
     const NDBTableC* left_table, int left_row_idx,
@@ -52,6 +301,8 @@ void aggregate_ndb_match_processor(
     NDBTableC* result_table, int* result_row_count
 );
 
+// Left rows fill the first table->num_columns result columns, right rows
+// the last ones; the other result columns are NULL
 void standard_ndb_unmatch_processor(
     const NDBTableC* table, int row_idx,
     NDBTableC* result_table, int* result_row_count,
@@ -67,16 +318,27 @@ void count_ndb_unmatch_processor(
 // NDB vectorization function declarations
 void vectorized_get_ndb_keys(const NDBTableC* table, int key_column, int* keys, int start_row, int count);
 
-// Hash functions with different strategies (unchanged)
-void simple_hash_keys(int* keys, unsigned int* hashes, int count);
-void aligned_hash_keys(int* keys, unsigned int* hashes, int count);
-
 
 // NDB utility functions
+// max_rows is the initial row capacity; the table grows past it on demand
 NDBTableC* create_ndb_table(int max_rows, int column_count, NDBFieldC* schema);
+// Table of num_rows rows whose columns have no buffers yet, for pointing
+// them at memory owned elsewhere (set release to give it back). Growing
+// such a column copies it into the table's arena. NULL when out of memory.
+NDBTableC* wrap_ndb_table(int num_rows, int column_count, const NDBFieldC* schema);
 void free_ndb_table(NDBTableC* table);
+// Grow every column to hold num_rows rows (capacity doubles), 0 on success
+int reserve_ndb_table_rows(NDBTableC* table, int num_rows);
+// Grow a string column's character buffer to num_bytes, 0 on success
+int reserve_ndb_string_bytes(NDBTableC* table, int column_idx, int64_t num_bytes);
+// Give a column an all-valid NULL bitmap if it has none, 0 on success
+int ensure_ndb_validity(NDBTableC* table, int column_idx);
+// data points to one value of the column's type (see columnar_types.h): a
+// NUL-terminated string for strings, the code for dictionary strings
 void add_ndb_column_data(NDBTableC* table, int column_idx, void* data, int row_idx);
+// Pointer to the value, for string and dictionary columns to the characters
 void* get_ndb_column_data(const NDBTableC* table, int column_idx, int row_idx);
+// Value of an int32, date32 or dictionary column, 0 for NULL and other types
 int get_int_key_from_ndb_column(const NDBTableC* table, int column_idx, int row_idx);
 
 // NDB specific helper functions
@@ -85,6 +347,24 @@ void set_ndb_value_null(NDBTableC* table, int column_idx, int row_idx);
 void copy_ndb_value(const NDBTableC* src_table, int src_col, int src_row,
                       NDBTableC* dst_table, int dst_col, int dst_row);
 
+// Append-only writer of a string column: keeps the character tail so each
+// row costs O(1), grows the buffers on demand and bulk-copies runs of
+// consecutive source rows. Rows must be appended in order.
+typedef struct {
+    NDBTableC* table;
+    int column_idx;
+    int row;                // Next row to write
+    int32_t tail;           // Character offset where that row starts
+} NDBStringBuilder;
+
+// Start appending at row, at most the table's num_rows (earlier rows must
+// be written and counted); all functions return 0 on success, -1 on a bad
+// column, a start row past num_rows or out of memory
+int init_ndb_string_builder(NDBStringBuilder* builder, NDBTableC* table, int column_idx, int row);
+int append_ndb_string(NDBStringBuilder* builder, const char* str, int str_len);
+// Append source rows [src_row, src_row + count) of a string column
+int append_ndb_string_run(NDBStringBuilder* builder, const NDBArrayC* src, int src_row, int count);
+
 // NDB string processing functions
 void get_ndb_string_value(const NDBTableC* table, int column_idx, int row_idx, 
                            char** str_ptr, int* str_len);
@@ -0,0 +1,144 @@
+#ifndef COLUMNAR_HASHTABLE_H
+#define COLUMNAR_HASHTABLE_H
+
+#include <stdint.h>
+#include "columnar_hash.h"
+#include "columnar_bloom.h"
+
+#define HASH_BUCKET_SLOTS 7
+#define HASH_TAG_EMPTY 0x00
+#define HASH_TAG_OCCUPIED 0x80
+#define HASH_TAG_TOMBSTONE 0x01     // Deleted key: matches nothing, but does not end a chain
+
+// One bucket fills exactly one 64-byte cache line: a tag byte per slot
+// (high bit = occupied, low 7 bits taken from the key hash), followed by
+// the keys and group ids of the seven slots.
+typedef struct {
+    uint8_t tags[8];                        // tags[7] is padding
+    int32_t keys[HASH_BUCKET_SLOTS];
+    int32_t group_ids[HASH_BUCKET_SLOTS];
+} HashBucket;
+
+// Open-addressing hash table, probing bucket by bucket.
+// Every distinct key owns one group; the build rows of group g are
+// row_ids[group_offsets[g] .. group_offsets[g + 1]), stored contiguously
+// in build order so the probe walks duplicates without pointer chasing.
+// A table changed after its build (see Maintenance) ends group g at
+// group_ends[g] instead, leaving room between groups.
+typedef struct {
+    HashBucket* buckets;
+    uint64_t bucket_mask;       // num_buckets - 1, num_buckets is a power of two
+    int64_t count;              // Number of distinct keys (= groups)
+    int32_t* group_offsets;     // Prefix sum of group sizes, count + 1 entries
+    int32_t* group_ends;        // End of each group's rows, NULL = group_offsets[g + 1]
+    int32_t* row_ids;           // Build row indices ordered by group
+    int32_t num_rows;           // Number of build rows (row_ids entries used)
+    NDBHashFunction hash_function;  // Probes must hash their keys the same way
+    NDBBloomFilter bloom;       // Optional filter over the keys, tested before the buckets
+    int64_t used_slots;         // Slots holding a key or a tombstone
+    int64_t tombstones;
+    HashBucket* next_buckets;   // Rehash in progress into these, else NULL
+    uint64_t next_mask;
+    int64_t next_tombstones;
+    uint64_t rehashed;          // Buckets already copied to next_buckets
+} HashTable;
+
+static inline uint64_t hash_bucket_index(uint64_t hash, uint64_t bucket_mask) {
+    return hash & bucket_mask;
+}
+
+static inline uint8_t hash_tag(uint64_t hash) {
+    return (uint8_t)(HASH_TAG_OCCUPIED | ((hash >> 32) & 0x7F));
+}
+
+// Allocate a table sized for expected_rows entries, returns 0 on success
+int init_hash_table(HashTable* table, int64_t expected_rows, NDBHashFunction hash_function);
+void free_hash_table(HashTable* table);
+
+// Build the table from keys[0..count); entry i is build row rows[i], or
+// row i when rows is NULL. hashes holds the keys' hashes under the table's
+// hash function, or is NULL to hash them here.
+// Returns 0 on success, -1 when out of memory.
+int build_hash_table(HashTable* table, const int32_t* keys, const uint64_t* hashes,
+                     const int32_t* rows, int count);
+
+// Key-only build for semi/anti joins: the distinct keys of keys[0..count)
+// get a group each, but no rows are kept (group_offsets and row_ids stay
+// NULL), so only lookup_hash and probe_hash_key_set may use the table.
+// Returns 0 on success, -1 when out of memory.
+int build_hash_key_set(HashTable* table, const int32_t* keys, const uint64_t* hashes, int count);
+
+// Build table->bloom over the table's distinct keys. The batch probes test
+// it first and only look at the buckets of keys that pass, which pays off
+// when most probe keys miss. Returns 0 on success.
+int build_hash_table_bloom(HashTable* table);
+
+// Search hash table - return matching group id, -1 means not found
+int lookup_hash(const HashTable* table, int key);
+
+// A key the table does not contain, for probe rows that must not match
+int32_t absent_hash_key(const HashTable* table);
+
+static inline int32_t hash_group_end(const HashTable* table, int group) {
+    return table->group_ends ? table->group_ends[group] : table->group_offsets[group + 1];
+}
+
+// Rows of a group returned by lookup_hash
+static inline const int32_t* hash_group_rows(const HashTable* table, int group, int* row_count) {
+    *row_count = hash_group_end(table, group) - table->group_offsets[group];
+    return table->row_ids + table->group_offsets[group];
+}
+
+// Resume point of probe_hash_batch when the output filled up mid-batch
+typedef struct {
+    int key_idx;            // Next key of the batch to probe
+    int group;              // Group being emitted, -1 when none
+    int group_pos;          // Next row within that group
+} HashProbeCursor;
+
+static inline void init_hash_probe_cursor(HashProbeCursor* cursor) {
+    cursor->key_idx = 0;
+    cursor->group = -1;
+    cursor->group_pos = 0;
+}
+
+// Probe keys[0..count) and emit the matches as two parallel arrays:
+// left_rows[i] = left_row_base + batch position, right_rows[i] = build row.
+// With emit_unmatched, a key without match emits right_rows[i] = -1.
+// hashes are the keys' precomputed hashes (NULL = hash them here).
+// Writes at most capacity pairs and returns how many were written; call
+// again with the same cursor until cursor->key_idx == count.
+int probe_hash_batch(const HashTable* table, const int32_t* keys, const uint64_t* hashes, int count,
+                     int left_row_base, int emit_unmatched, HashProbeCursor* cursor,
+                     int32_t* left_rows, int32_t* right_rows, int capacity);
+
+// Semi/anti probe: write left_row_base + i to left_rows for every key of
+// keys[0..count) that is present (anti = 0) or absent (anti = 1). A key
+// stops at its first match, so at most count rows are written; returns
+// how many. Works on key sets and on full tables.
+int probe_hash_key_set(const HashTable* table, const int32_t* keys, const uint64_t* hashes, int count,
+                       int left_row_base, int anti, int32_t* left_rows);
+
+// =================== Maintenance ===================
+//
+// Keys can be added to and removed from a built table one at a time; the
+// caller keeps the groups' rows. A removed key leaves a tombstone that
+// lookups step over and later inserts reuse. Once keys and tombstones
+// fill 5/8 of the slots, a rehash into a new bucket array starts and
+// moves HASH_REHASH_STEP buckets per change, dropping the tombstones;
+// lookups use the old array until the last bucket has moved, so no single
+// change pays for a whole rehash. The probes of a changing table must not
+// run concurrently with the changes.
+
+// Buckets moved to the new array per insert or delete
+#define HASH_REHASH_STEP 4
+
+// Add key, which the table must not hold, as group group. hash is its
+// hash under the table's function. Returns 0, or -1 when out of memory.
+int insert_hash_key(HashTable* table, int32_t key, uint64_t hash, int32_t group);
+// Remove key; returns its group, or -1 when the table does not hold it
+int delete_hash_key(HashTable* table, int32_t key, uint64_t hash);
+// Copy of a table (buckets, groups and filter) in memory of its own, 0 on success
+int copy_hash_table(const HashTable* table, HashTable* copy);
+
+#endif /* COLUMNAR_HASHTABLE_H */
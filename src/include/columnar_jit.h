@@ -0,0 +1,49 @@
+#ifndef COLUMNAR_JIT_H
+#define COLUMNAR_JIT_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "columnar_hashjoin.h"
+
+// Output column i of a JIT join is column `column` of the left (side 0)
+// or right (side 1) input
+typedef struct {
+    int side;
+    int column;
+} NDBJitProjection;
+
+typedef struct {
+    int64_t compiled;       // Kernels compiled by LLVM
+    int64_t cache_hits;     // Joins that reused a compiled kernel
+} NDBJitStats;
+
+// Is the LLVM JIT usable in this process? Initializes it on first call.
+int ndb_jit_available(void);
+
+// Hash join whose result rows are written by a kernel compiled for the
+// plan: input schemas, key columns, join type and projection. The kernel
+// is one loop over the matches of a probe batch writing every fixed-width
+// column with its type and NULL handling baked in, so no callbacks or type
+// switches remain; string columns use the batch gather of the same pairs.
+// Kernels are cached by plan signature and reused by later joins.
+// projections = NULL projects all left columns, then all right columns.
+// Runs on the calling thread; of the options (NULL = defaults) only
+// hash_function is used.
+// Supports INNER_JOIN and LEFT_JOIN on int32 keys; returns 0 on success,
+// -1 when the JIT or the plan is unsupported (nothing was written then).
+int jit_ndb_hash_join(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    JoinType join_type,
+    const NDBJitProjection* projections,
+    int num_projections,
+    NDBTableC* result_table,
+    int* result_row_count,
+    const NDBJoinOptions* options
+);
+
+void get_ndb_jit_stats(NDBJitStats* stats);
+
+#endif /* COLUMNAR_JIT_H */
@@ -0,0 +1,111 @@
+#ifndef COLUMNAR_JOIN_INDEX_H
+#define COLUMNAR_JOIN_INDEX_H
+
+#include <stdint.h>
+#include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+
+// Build side of a hash join kept as an object of its own: the hash table
+// over the key columns of a table, with the key codes of composite and
+// non-int32 keys. Built once, it serves any number of joins of any type
+// (see open_ndb_join_index_stream), and since probes only read it, any
+// number of threads at once, each through a stream of its own:
+//
+//   NDBJoinIndex* index = create_ndb_join_index(dim, &key, 1, NULL);
+//   // per thread, per query:
+//   NDBJoinStream* stream = open_ndb_join_index_stream(index, INNER_JOIN);
+//   probe_ndb_join_stream(stream, batch, &key);
+//   while (next_ndb_join_pairs(stream, &pairs, 4096) > 0) { ... }
+//   close_ndb_join_stream(stream);
+//
+// An index can also be stored in a table file with its table
+// (write_ndb_table_file_with_indexes) and mapped back with it
+// (map_ndb_join_index), which skips the build at startup.
+typedef struct NDBJoinIndex NDBJoinIndex;
+
+// Hash the key columns of table. table must outlive the index and only
+// change as the index is told (see Maintenance). options: hash_function
+// and bloom_filter (> 0 builds the filter) as for the flexible join,
+// NULL = defaults. NULL on bad key columns or when out of memory.
+NDBJoinIndex* create_ndb_join_index(const NDBTableC* table, const int* key_columns, int num_key_columns,
+                                    const NDBJoinOptions* options);
+void free_ndb_join_index(NDBJoinIndex* index);
+
+const NDBTableC* ndb_join_index_table(const NDBJoinIndex* index);
+int ndb_join_index_key_columns(const NDBJoinIndex* index, const int** key_columns);
+
+// =================== Probing ===================
+
+// The index's hash table, for the probe functions of columnar_hashtable.h
+const HashTable* ndb_join_index_hash_table(const NDBJoinIndex* index);
+// Bitmap of the table's rows deleted from the index (see Maintenance),
+// which RIGHT and FULL joins must not emit; NULL when none were. Rows past
+// *num_words * 64 were not deleted.
+const uint64_t* ndb_join_index_dropped_rows(const NDBJoinIndex* index, int64_t* num_words);
+
+// Keys of the rows of batch as the hash table holds them, its key columns
+// paired with the index's: *keys points at the key column itself, or at
+// buffer (batch->num_rows entries) when the keys take codes or have
+// NULLs, which get a key absent from the table. Returns 0, or -1 when the
+// columns do not pair or out of memory.
+int ndb_join_index_probe_keys(const NDBJoinIndex* index, const NDBTableC* batch, const int* key_columns,
+                              int32_t* buffer, const int32_t** keys);
+
+// =================== Maintenance ===================
+//
+// An index follows changes to its table without a rebuild: rows appended
+// to the table are inserted, rows removed deleted, and rows replaced by
+// new versions updated. Deleted keys leave tombstones in the hash table
+// and grown tables rehash a few buckets per change; groups that outgrow
+// their room in row_ids move to its end, and the room they leave is
+// reclaimed by a compaction once it exceeds the rows indexed. A change
+// needs the index to itself: no stream open on it and no probe running.
+// A mapped index is copied into memory on its first change.
+
+// Index rows of the table (which may have grown since the index was
+// built). Rows with a NULL key are skipped, as by the build. Returns 0,
+// or -1 on a row outside the table or when out of memory.
+int insert_ndb_join_index_rows(NDBJoinIndex* index, const int32_t* rows, int count);
+// Drop rows from the index, and from the build rows RIGHT and FULL joins
+// emit unmatched; rows it does not hold are only dropped from those.
+// Their key columns must still hold the values they were indexed under.
+int delete_ndb_join_index_rows(NDBJoinIndex* index, const int32_t* rows, int count);
+// Updates as the table makes them, a new version of each row appended:
+// drop old_rows[i] and index new_rows[i] in its place, pair by pair in
+// order, so a batch may update a row it created (29 -> 317, 317 -> 322).
+// A key changed in place instead is a delete before the change and an
+// insert after it.
+int update_ndb_join_index_rows(NDBJoinIndex* index, const int32_t* old_rows, const int32_t* new_rows, int count);
+// Rebuild densely over the rows indexed, dropping tombstones and room
+int compact_ndb_join_index(NDBJoinIndex* index);
+
+typedef struct {
+    int64_t keys;               // Distinct keys
+    int64_t rows;               // Rows indexed
+    int64_t tombstones;         // Slots of deleted keys not reclaimed yet
+    int64_t unused_rows;        // row_ids entries left behind by moved groups
+    int rehashing;              // A rehash is under way
+} NDBJoinIndexStats;
+
+void get_ndb_join_index_stats(const NDBJoinIndex* index, NDBJoinIndexStats* stats);
+
+// =================== Storage ===================
+
+// An index as flat scalars and arrays, the form table files store
+#define NDB_JOIN_INDEX_SCALARS 16
+#define NDB_JOIN_INDEX_ARRAYS 12
+
+typedef struct {
+    int64_t scalars[NDB_JOIN_INDEX_SCALARS];
+    const void* arrays[NDB_JOIN_INDEX_ARRAYS];
+    uint64_t bytes[NDB_JOIN_INDEX_ARRAYS];
+} NDBJoinIndexImage;
+
+// The image points into the index, valid while it lives
+void get_ndb_join_index_image(const NDBJoinIndex* index, NDBJoinIndexImage* image);
+// Index over table reading the image's arrays in place; they must outlive
+// it unchanged. Sizes are checked, contents trusted as for the columns of
+// a mapped file. NULL when the image does not fit table.
+NDBJoinIndex* load_ndb_join_index_image(const NDBTableC* table, const NDBJoinIndexImage* image);
+
+#endif /* COLUMNAR_JOIN_INDEX_H */
@@ -0,0 +1,60 @@
+#ifndef COLUMNAR_JOIN_STREAM_H
+#define COLUMNAR_JOIN_STREAM_H
+
+#include <stdint.h>
+#include "columnar_hashjoin.h"
+#include "columnar_join_index.h"
+
+// Streaming hash join: the build (right) side is hashed once when the
+// stream opens; the probe (left) side then arrives as any number of
+// batches, each an NDBTableC of its own, and the output of each batch is
+// pulled as bounded chunks of row pairs. Memory stays at the build plus
+// one batch plus one chunk, however long the probe side is.
+//
+//   NDBJoinStream* stream = open_ndb_join_stream(dim, &key, 1, LEFT_JOIN, NULL);
+//   while ((batch = next_upstream_batch()) != NULL) {
+//       probe_ndb_join_stream(stream, batch, &key);
+//       while (next_ndb_join_pairs(stream, &pairs, 4096) > 0) {
+//           materialize_ndb_row_pairs(&pairs, 0, pairs.count, batch, dim, out, &out_rows);
+//       }
+//   }
+//   finish_ndb_join_stream(stream);        // RIGHT/FULL: unmatched build rows
+//   while (next_ndb_join_pairs(stream, &pairs, 4096) > 0) { ... }
+//   close_ndb_join_stream(stream);
+//
+// Left rows in the pairs are rows of the current batch, right rows rows
+// of the build table; -1 marks the missing side as in NDBRowPairs. Semi
+// and anti joins pair each qualifying left row with -1. Keys and NULL keys
+// behave as in flexible_ndb_hash_join_multi. A stream is used by one
+// thread at a time.
+typedef struct NDBJoinStream NDBJoinStream;
+
+// Hash the build side. right_table must outlive the stream. options: as
+// for the flexible join (NULL = defaults); bloom_filter = 0 leaves the
+// filter off, since no probe keys are known yet. NULL on bad key columns
+// or when out of memory.
+NDBJoinStream* open_ndb_join_stream(const NDBTableC* right_table, const int* right_key_columns,
+                                    int num_key_columns, JoinType join_type, const NDBJoinOptions* options);
+
+// Stream over a built index instead, which must outlive it. Streams only
+// read the index, so any number may probe it at once from different
+// threads. NULL when out of memory.
+NDBJoinStream* open_ndb_join_index_stream(const NDBJoinIndex* index, JoinType join_type);
+
+// Start probing a batch, dropping what is left of the previous one. The
+// batch must stay unchanged until the next call. Returns 0, or -1 when
+// its key columns do not pair with the build keys or out of memory.
+int probe_ndb_join_stream(NDBJoinStream* stream, const NDBTableC* left_batch, const int* left_key_columns);
+
+// End of the probe side: the following next_ndb_join_pairs calls return
+// the build rows that matched no batch (RIGHT/FULL joins only)
+void finish_ndb_join_stream(NDBJoinStream* stream);
+
+// Replace the contents of pairs with up to max_pairs pairs of output, in
+// left row order. Returns how many; 0 when the current batch (or after
+// finish, the build side) is exhausted; -1 when out of memory.
+int64_t next_ndb_join_pairs(NDBJoinStream* stream, NDBRowPairs* pairs, int64_t max_pairs);
+
+void close_ndb_join_stream(NDBJoinStream* stream);
+
+#endif /* COLUMNAR_JOIN_STREAM_H */
@@ -0,0 +1,125 @@
+#ifndef COLUMNAR_KEYS_H
+#define COLUMNAR_KEYS_H
+
+#include <stdint.h>
+#include "memory.h"
+
+// Join keys made of several columns, or of a column whose values are not
+// int32 (see NDBTypeInfo.int32_key), are normalized and replaced by int32
+// codes before the join: equal keys get equal codes on both sides, so the
+// int32 hash joins run unchanged.
+//
+// Each key row is normalized to bytes (fixed-width types: their value
+// bytes, with -0.0 and NaNs made canonical; strings and dictionary
+// strings: length + characters). When every key of both inputs fits in 8
+// bytes (e.g. an int64 or timestamp, two int32 columns, or an int32 and a
+// short string) the bytes are packed into one uint64, a column at a time,
+// and hashed and compared as such; otherwise the keys are hashed and
+// compared as variable-width byte strings.
+// Rows with a NULL in any key column never match (see find_ndb_null_keys);
+// their codes are arbitrary.
+
+// Codes of every row of both inputs. Build (right) keys get the dense
+// codes 0 .. distinct - 1; a left key absent from the right input gets -1.
+typedef struct {
+    int32_t* left;
+    int32_t* right;
+    int32_t distinct;           // Distinct right keys
+    int packed;                 // 1 = keys were packed into uint64
+} NDBKeyCodes;
+
+// Whether these key columns need codes, i.e. are not one column of int32
+// values of the same type on both sides (and the same dictionary)
+int ndb_join_keys_need_codes(const NDBTableC* left_table, const int* left_key_columns,
+                             const NDBTableC* right_table, const int* right_key_columns,
+                             int num_key_columns);
+
+// Encode the keys left_key_columns[k] = right_key_columns[k] of both
+// inputs. Paired columns must have the same key type: the same type, or
+// string and dictionary string.
+// Returns 0 on success, -1 on bad columns or when out of memory.
+int encode_ndb_join_keys(const NDBTableC* left_table, const int* left_key_columns,
+                         const NDBTableC* right_table, const int* right_key_columns,
+                         int num_key_columns, NDBKeyCodes* codes);
+void free_ndb_key_codes(NDBKeyCodes* codes);
+
+// The right side's codes kept to encode left keys that arrive later, one
+// batch at a time. Key packing is sized from the right keys alone: a left
+// string longer than every right one simply gets -1.
+typedef struct NDBKeyEncoder NDBKeyEncoder;
+
+// Encode the right keys; right_codes (NULL = not wanted) receives the code
+// of every right row. The encoder refers to right_table, which must
+// outlive it. NULL on bad columns or when out of memory.
+NDBKeyEncoder* create_ndb_key_encoder(const NDBTableC* right_table, const int* right_key_columns,
+                                      int num_key_columns, int32_t* right_codes);
+// Distinct right keys
+int32_t ndb_key_encoder_distinct(const NDBKeyEncoder* encoder);
+// codes[row] = code of each left row, -1 when absent from the right keys.
+// Only reads the encoder, so threads may encode concurrently.
+// Returns 0, or -1 on key columns that do not pair with the right ones.
+int encode_ndb_left_keys(const NDBKeyEncoder* encoder, const NDBTableC* left_table, const int* left_key_columns,
+                         int32_t* codes);
+void free_ndb_key_encoder(NDBKeyEncoder* encoder);
+
+// Codes of rows rows[0..count) of the encoder's right table, which may
+// have grown since: with add, keys not seen yet get new codes, otherwise
+// -1. Returns 0; 1 when an added key does not fit the packed widths taken
+// at creation (a string longer than any before), so that only a new
+// encoder can code it; -1 when out of memory.
+int encode_ndb_right_rows(NDBKeyEncoder* encoder, const int32_t* rows, int count, int add, int32_t* codes);
+// Copy the arrays of a loaded encoder (load_ndb_key_encoder_image) into
+// memory of its own so it can take new keys; 0 on success
+int own_ndb_key_encoder(NDBKeyEncoder* encoder);
+
+// The arrays behind an encoder, for storing it (see columnar_join_index.h).
+// Everything but right_table and the key columns is in them.
+typedef struct {
+    int32_t packed;             // 1 = packed keys, 0 = variable-width keys
+    int32_t count;              // Distinct right keys
+    uint64_t slot_mask;         // Dictionary slots - 1
+    const void* slots;          // slot_mask + 1 slots of slot_bytes
+    const int* widths;          // Packed width of each key column
+    const uint64_t* packed_keys;    // count keys when packed
+    const int64_t* key_offsets;     // count + 1 offsets into bytes when not
+    const uint8_t* bytes;
+    uint64_t slot_bytes;
+    uint64_t key_bytes;         // key_offsets[count]
+} NDBKeyEncoderImage;
+
+void get_ndb_key_encoder_image(const NDBKeyEncoder* encoder, NDBKeyEncoderImage* image);
+// Encoder over the image's arrays in place: they must stay unchanged and
+// outlive it, and free_ndb_key_encoder leaves them alone. The array
+// sizes are checked against each other, their contents are trusted.
+// NULL on bad columns or an inconsistent image.
+NDBKeyEncoder* load_ndb_key_encoder_image(const NDBTableC* right_table, const int* right_key_columns,
+                                          int num_key_columns, const NDBKeyEncoderImage* image);
+
+// =================== NULL keys ===================
+
+// SQL equality: a key with a NULL in any key column equals nothing. The
+// joins leave such rows out of the build, and give them a key absent from
+// the build (absent_hash_key) on the probe side, so they take the
+// unmatched path of outer and anti joins.
+
+// 1 when there is a key column and each is a column of its table,
+// else 0 after an error message; joins check this before they read keys
+int valid_ndb_join_key_columns(const NDBTableC* left_table, const int* left_key_columns,
+                               const NDBTableC* right_table, const int* right_key_columns,
+                               int num_key_columns);
+
+// *null_rows = bitmap of the rows whose key has a NULL (bit r of word
+// r / 64), OR-ed together from the validity bitmaps a 64-bit word at a
+// time; NULL when no key is NULL. Returns 0, or -1 when out of memory.
+int find_ndb_null_keys(const NDBTableC* table, const int* key_columns, int num_key_columns,
+                       uint64_t** null_rows);
+
+// Copy the keys of rows [0, num_rows) that are not set in null_rows to
+// out_keys and their row ids to out_rows; returns how many
+int compact_ndb_non_null_keys(const int32_t* keys, const uint64_t* null_rows, int num_rows,
+                              int32_t* out_keys, int32_t* out_rows);
+
+// keys[i] = absent_key for every NULL-key row start + i, i < count
+void mask_ndb_null_keys(int32_t* keys, const uint64_t* null_rows, int start, int count, int32_t absent_key);
+
+#endif /* COLUMNAR_KEYS_H */
@@ -0,0 +1,28 @@
+#ifndef COLUMNAR_REL_RUNTIME_H
+#define COLUMNAR_REL_RUNTIME_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "columnar_hashtable.h"
+
+// Entry points called by rel dialect pipelines lowered to LLVM
+// (src/lib/rel/RelToLLVM.cpp). Values are read as raw int32; the build
+// leaves NULL-key rows out, as the other joins do.
+
+int32_t ndb_rel_num_rows(const NDBTableC* table);
+// Values of an int32 column, NULL (and an error) for any other column
+const int32_t* ndb_rel_int_column(const NDBTableC* table, int32_t column);
+
+// Hash table over the key column with the default hash function, NULL on failure
+HashTable* ndb_rel_hash_build(const NDBTableC* table, int32_t key_column);
+void ndb_rel_hash_free(HashTable* table);
+// Group of key, -1 when absent; its build rows are
+// rows[offsets[group] .. offsets[group + 1])
+int32_t ndb_rel_lookup(const HashTable* table, int32_t key);
+const int32_t* ndb_rel_group_offsets(const HashTable* table);
+const int32_t* ndb_rel_group_rows(const HashTable* table);
+
+// Append one row of count int32 values, 0 on success
+int32_t ndb_rel_append_int_row(NDBTableC* table, const int32_t* values, int32_t count);
+
+#endif /* COLUMNAR_REL_RUNTIME_H */
@@ -0,0 +1,51 @@
+#ifndef COLUMNAR_SIMD_H
+#define COLUMNAR_SIMD_H
+
+#include <stdint.h>
+#include "columnar_hashtable.h"
+
+// Instruction set levels of the probe kernels, in increasing order
+typedef enum {
+    SIMD_LEVEL_SCALAR,
+    SIMD_LEVEL_AVX2,
+    SIMD_LEVEL_AVX512
+} SimdLevel;
+
+#define MULTIPLY_SHIFT_CONSTANT 0x9E3779B97F4A7C15ULL
+
+// Multiply-shift hash of a 32-bit key, folded so the low bits (bucket
+// index) depend on every key bit. The SIMD kernels compute the same value.
+static inline uint64_t multiply_shift_hash32(int32_t key) {
+    uint64_t product = (uint64_t)(uint32_t)key * MULTIPLY_SHIFT_CONSTANT;
+    return product ^ (product >> 32);
+}
+
+// hashes[i] = multiply_shift_hash32(keys[i]), 8 (AVX2) or 16 (AVX-512) at a time
+void simd_multiply_shift_keys(const int32_t* keys, uint64_t* hashes, int count);
+
+// 64-bit CRC32C hash: low half = crc32c(seed, key), high half continues
+// the CRC over the key once more. SSE4.2 crc32 instruction from the AVX2
+// level up, bit-identical table-driven software CRC below it.
+void simd_crc32c_keys(const int32_t* keys, uint64_t* hashes, int count);
+
+// For each hash, gather the tag bytes of its home bucket and compare them
+// with the hash's tag: bit s of masks[i] is set when slot s may hold the
+// key, bit 7 when the home bucket still has an empty slot (so a key not
+// found among the candidates is absent from the table).
+void simd_match_bucket_tags(const HashBucket* buckets, uint64_t bucket_mask,
+                            const uint64_t* hashes, uint8_t* masks, int count);
+
+// Register-blocked Bloom filter test (see columnar_bloom.h): bit i of
+// pass[i / 64] is set when all 4 bits of hashes[i] are set in its block.
+// Gathers 4 (AVX2) or 8 (AVX-512) blocks per instruction.
+void simd_test_bloom_blocks(const uint64_t* blocks, uint64_t block_mask,
+                            const uint64_t* hashes, int count, uint64_t* pass);
+
+// Best level this CPU supports / level the kernels currently dispatch to
+SimdLevel simd_detected_level(void);
+SimdLevel simd_active_level(void);
+// Force a lower level (e.g. for benchmarking); clamped to the detected level
+void simd_set_level(SimdLevel level);
+const char* simd_level_name(SimdLevel level);
+
+#endif /* COLUMNAR_SIMD_H */
@@ -0,0 +1,37 @@
+#ifndef COLUMNAR_THREADPOOL_H
+#define COLUMNAR_THREADPOOL_H
+
+#include <stdint.h>
+
+// Task body: task_idx in [0, num_tasks), worker_id in [0, thread_pool_size)
+typedef void (*ThreadPoolTaskFunc)(void* context, int task_idx, int worker_id);
+
+// Morsel body: processes the row range [start, end) of a parallel_for
+typedef void (*ThreadPoolMorselFunc)(void* context, int64_t start, int64_t end, int worker_id);
+
+typedef struct ThreadPool ThreadPool;
+
+// Start a pool with num_threads workers (0 = number of online cores)
+ThreadPool* create_thread_pool(int num_threads);
+void free_thread_pool(ThreadPool* pool);
+int thread_pool_size(const ThreadPool* pool);
+
+// Process-wide pool with one worker per online core, created on first use
+ThreadPool* get_default_thread_pool(void);
+
+// Split [begin, end) into morsels of morsel_size rows and run them on the
+// workers, blocking until all finished. Every worker starts on its own
+// contiguous share of morsels and steals half of a victim's remaining
+// morsels once its deque runs dry, so skewed morsels do not idle cores.
+// Jobs from concurrent callers run one after another; a morsel must not
+// start a nested job on the same pool.
+void thread_pool_parallel_for(ThreadPool* pool, int64_t begin, int64_t end, int64_t morsel_size,
+                              ThreadPoolMorselFunc morsel, void* context);
+
+// Run num_tasks tasks on the workers and block until all of them finished
+void thread_pool_run(ThreadPool* pool, ThreadPoolTaskFunc task, void* context, int num_tasks);
+
+// Number of online cores, at least 1
+int online_core_count(void);
+
+#endif /* COLUMNAR_THREADPOOL_H */
@@ -0,0 +1,100 @@
+#ifndef COLUMNAR_TYPES_H
+#define COLUMNAR_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "memory.h"
+
+// Column types: the type_id of NDBFieldC and NDBArrayC
+typedef enum {
+    NDB_TYPE_INT32 = 0,
+    NDB_TYPE_STRING = 1,        // offsets + characters
+    NDB_TYPE_INT64 = 2,
+    NDB_TYPE_FLOAT64 = 3,
+    NDB_TYPE_DATE32 = 4,        // int32 days since 1970-01-01
+    NDB_TYPE_TIMESTAMP = 5,     // int64 microseconds since 1970-01-01 00:00:00 UTC
+    NDB_TYPE_DICT_STRING = 6,   // int32 codes into the column's dictionary
+    NDB_TYPE_STRING_VIEW = 7,   // int32 rows of a string column seen in place
+    NDB_NUM_TYPES
+} NDBTypeId;
+
+// What storage, copies and joins need to know about a type. Code paths
+// switch on these properties once per column instead of on the type id
+// once per value.
+typedef struct {
+    const char* name;
+    int32_t width;              // Bytes per value in values, 0 = variable width
+    int32_t key_type;           // Join keys compare as values of this type
+                                // (a dictionary string as a string); the
+                                // two sides of a key must agree on it
+    int32_t int32_key;          // Values are int32 that join as they are
+    int32_t decoded;            // Values are rows of the column's dictionary
+                                // table, whose strings they stand for
+} NDBTypeInfo;
+
+// Registry entry of type_id, NULL for an unknown id
+const NDBTypeInfo* ndb_type_info(int32_t type_id);
+
+// Bytes per value, 0 for variable width and unknown types
+static inline int ndb_type_width(int32_t type_id) {
+    const NDBTypeInfo* info = ndb_type_info(type_id);
+    return info ? info->width : 0;
+}
+
+// Whether values stand for rows of the column's dictionary table
+static inline int ndb_type_decoded(int32_t type_id) {
+    const NDBTypeInfo* info = ndb_type_info(type_id);
+    return info ? info->decoded : 0;
+}
+
+// Format one value as text (dates as YYYY-MM-DD, timestamps as
+// YYYY-MM-DD HH:MM:SS.ffffff, NULL as "NULL"), truncated to size bytes.
+// Returns the length of the full text, like snprintf.
+int format_ndb_value(const NDBTableC* table, int column_idx, int row_idx, char* buf, size_t size);
+
+// =================== Dictionary strings ===================
+
+// A NDB_TYPE_DICT_STRING column stores one int32 code per row; code c
+// stands for row c of column 0 of its dictionary, a one-column string
+// table that every column encoded with it shares and that the caller owns
+// (it must outlive them). Columns on the same dictionary join and copy as
+// their codes; string accessors decode them.
+
+// Dictionary of the distinct values of string column `column`, in first
+// seen order; NULL on a bad column or when out of memory. Free it with
+// free_ndb_table.
+NDBTableC* build_ndb_string_dictionary(const NDBTableC* table, int column);
+
+// Write rows 0 .. num_rows of string column src_column as codes into the
+// dictionary column dst_column, which takes the dictionary. NULL stays
+// NULL. Returns 0 on success, -1 when a string is not in the dictionary
+// or out of memory.
+int encode_ndb_dictionary_column(const NDBTableC* src_table, int src_column,
+                                 const NDBTableC* dictionary,
+                                 NDBTableC* dst_table, int dst_column);
+
+// =================== String views ===================
+
+// A NDB_TYPE_STRING_VIEW column stores the source row of each value
+// instead of its characters: row r stands for row r of column 0 of its
+// dictionary, a view of a string column that reads the column's buffers
+// in place. Gathering a string column into a view column copies row
+// numbers only (see gather_ndb_column), which suits join output that is
+// read once and thrown away. Unlike dictionary codes, two rows of a view
+// may hold equal strings, so view columns join through key codes. A view
+// column cannot be written to a file or exported to Arrow; gather it into
+// a string column first.
+
+// One-column table whose column 0 reads string column `column` of table
+// in place, for the dictionary of view columns. table must outlive the
+// view, its column unchanged. NULL on a bad column or when out of
+// memory. Free it with free_ndb_table, which leaves the column alone.
+NDBTableC* view_ndb_string_column(const NDBTableC* table, int column);
+
+// Whether view is a view of column src (see view_ndb_string_column)
+static inline int ndb_is_string_view_of(const NDBTableC* view, const NDBArrayC* src) {
+    return view && view->num_columns == 1 && view->columns[0].type_id == NDB_TYPE_STRING &&
+           view->columns[0].offsets == src->offsets && view->columns[0].values == src->values;
+}
+
+#endif /* COLUMNAR_TYPES_H */
@@ -10,22 +10,33 @@ typedef struct {
   int8_t nullable;  // Whether null values are allowed
 } NDBFieldC;
 
+struct NDBTableC;
+
 // Data for each column (i.e., NDB Array)
-typedef struct {
+typedef struct NDBArrayC {
   uint8_t *validity; // Null bitmap (used only for nullable fields)
   int32_t *offsets;  // Used for variable-length types, e.g., string/list
   void *values;      // Actual value buffer, e.g., int32_t*, float*, char*
-  int32_t length;
+  int32_t length;         // Row capacity of the buffers
   int32_t null_count;
-  int32_t type_id; // Type identifier, e.g., 0=int32, 1=string
+  int32_t type_id; // Type identifier, see NDBTypeId in columnar_types.h
+  int32_t value_capacity; // Bytes in values (string columns)
+  const struct NDBTableC *dictionary; // Strings of a dictionary column, else NULL
 } NDBArrayC;
 
+struct NDBArena;
+
 // Table structure
-typedef struct {
+typedef struct NDBTableC {
   NDBFieldC *fields;  // Schema metadata for each column
   NDBArrayC *columns; // Actual column data
   int32_t num_columns;
   int32_t num_rows;
+  struct NDBArena *arena; // Owns the table and all its buffers (NULL = malloc'd)
+  // Buffers the table does not own (a mapped file, imported Arrow data)
+  // are given back by release, called by free_ndb_table; NULL = none
+  void (*release)(struct NDBTableC *table);
+  void *private_data; // State of release
 } NDBTableC;
 
 #endif // MEMORY_H
\ No newline at end of file
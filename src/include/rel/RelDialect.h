@@ -0,0 +1,22 @@
+#ifndef NDB_REL_DIALECT_H
+#define NDB_REL_DIALECT_H
+
+#include "mlir/Bytecode/BytecodeOpInterface.h"
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/Dialect.h"
+#include "mlir/IR/OpDefinition.h"
+#include "mlir/IR/OpImplementation.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+
+// Generated from rel/RelOps.td
+#include "rel/RelOpsDialect.h.inc"
+#include "rel/RelOpsEnums.h.inc"
+
+#define GET_TYPEDEF_CLASSES
+#include "rel/RelOpsTypes.h.inc"
+
+#define GET_OP_CLASSES
+#include "rel/RelOps.h.inc"
+
+#endif // NDB_REL_DIALECT_H
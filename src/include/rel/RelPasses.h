@@ -0,0 +1,32 @@
+#ifndef NDB_REL_PASSES_H
+#define NDB_REL_PASSES_H
+
+#include <memory>
+
+namespace mlir {
+class OpPassManager;
+class Pass;
+} // namespace mlir
+
+namespace ndb::rel {
+
+// rel-fuse: operator-level fusion. Composes projections, folds them into
+// scans and moves filters ahead of projections and probes, so pipelines
+// read fewer columns and probe fewer rows.
+std::unique_ptr<mlir::Pass> createRelFusionPass();
+
+// convert-rel-to-llvm: lower every pipeline (rel.scan ... rel.materialize)
+// to one fused loop of scf, arith and llvm ops calling the entry points of
+// columnar_rel_runtime.h; !rel.table arguments become !llvm.ptr
+std::unique_ptr<mlir::Pass> createConvertRelToLLVMPass();
+
+// rel-fuse, convert-rel-to-llvm and the upstream conversions down to the
+// LLVM dialect, ready for mlir-translate or the ExecutionEngine
+void buildRelToLLVMPipeline(mlir::OpPassManager& pm);
+
+// Register the passes above and the rel-to-llvm pipeline
+void registerRelPasses();
+
+} // namespace ndb::rel
+
+#endif // NDB_REL_PASSES_H
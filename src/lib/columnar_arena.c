@@ -0,0 +1,137 @@
+#include "columnar_arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 64
+#define ARENA_DEFAULT_CHUNK (64 * 1024)
+// Doubling stops here
+#define ARENA_MAX_CHUNK (64 * 1024 * 1024)
+
+struct NDBArenaChunk {
+    NDBArenaChunk* next;
+    size_t size;                // Usable bytes in data
+    size_t used;                // Bytes handed out
+    size_t last;                // Offset of the most recent block
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+static inline size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static NDBArenaChunk* new_chunk(NDBArena* arena, size_t size) {
+    size = align_up(size);
+    NDBArenaChunk* chunk = (NDBArenaChunk*)aligned_alloc(ARENA_ALIGNMENT, sizeof(NDBArenaChunk) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->last = 0;
+    arena->reserved_bytes += size;
+    return chunk;
+}
+
+NDBArena* ndb_arena_create(size_t initial_bytes) {
+    NDBArena* arena = (NDBArena*)malloc(sizeof(NDBArena));
+    if (!arena) {
+        return NULL;
+    }
+    arena->chunks = NULL;
+    arena->blocks = NULL;
+    arena->reserved_bytes = 0;
+    arena->next_chunk_size = initial_bytes > 0 ? align_up(initial_bytes) : ARENA_DEFAULT_CHUNK;
+    return arena;
+}
+
+void ndb_arena_destroy(NDBArena* arena) {
+    if (!arena) return;
+
+    NDBArenaChunk* lists[2] = {arena->chunks, arena->blocks};
+    for (int i = 0; i < 2; i++) {
+        NDBArenaChunk* chunk = lists[i];
+        while (chunk) {
+            NDBArenaChunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+    }
+    free(arena);
+}
+
+void* ndb_arena_alloc(NDBArena* arena, size_t size) {
+    size = align_up(size > 0 ? size : 1);
+    NDBArenaChunk* head = arena->chunks;
+    if (head && head->size - head->used >= size && size < NDB_ARENA_BLOCK_BYTES) {
+        head->last = head->used;
+        head->used += size;
+        return head->data + head->last;
+    }
+
+    if (size >= NDB_ARENA_BLOCK_BYTES) {
+        // Own chunk, so that a resize can free it
+        NDBArenaChunk* chunk = new_chunk(arena, size);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->used = size;
+        chunk->next = arena->blocks;
+        arena->blocks = chunk;
+        return chunk->data;
+    }
+
+    size_t chunk_size = arena->next_chunk_size;
+    while (chunk_size < size) {
+        chunk_size *= 2;
+    }
+    NDBArenaChunk* chunk = new_chunk(arena, chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+    if (chunk_size < ARENA_MAX_CHUNK) {
+        arena->next_chunk_size = chunk_size * 2;
+    }
+    chunk->next = head;
+    arena->chunks = chunk;
+    chunk->used = size;
+    return chunk->data;
+}
+
+void* ndb_arena_realloc(NDBArena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return ndb_arena_alloc(arena, new_size);
+    }
+
+    // A large block is the only one in its chunk
+    NDBArenaChunk** link = &arena->blocks;
+    while (*link && (unsigned char*)ptr != (*link)->data) {
+        link = &(*link)->next;
+    }
+    NDBArenaChunk* own = *link;
+
+    NDBArenaChunk* head = arena->chunks;
+    if (!own && head && (unsigned char*)ptr == head->data + head->last &&
+        align_up(new_size) < NDB_ARENA_BLOCK_BYTES && head->size - head->last >= align_up(new_size)) {
+        head->used = head->last + align_up(new_size);
+        return ptr;
+    }
+
+    // Unlinked first: a new large block goes to the front of the list
+    if (own) {
+        *link = own->next;
+    }
+    void* block = ndb_arena_alloc(arena, new_size);
+    if (block) {
+        memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    }
+    if (own && block) {
+        arena->reserved_bytes -= own->size;
+        free(own);
+    } else if (own) {
+        own->next = *link;
+        *link = own;
+    }
+    return block;
+}
@@ -0,0 +1,509 @@
+#include "columnar_arrow.h"
+#include "columnar_arena.h"
+#include "columnar_hashjoin.h"
+#include "columnar_keys.h"
+#include "columnar_types.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =================== Formats ===================
+
+static const char* const arrow_formats[NDB_NUM_TYPES] = {
+    [NDB_TYPE_INT32] = "i",
+    [NDB_TYPE_STRING] = "u",
+    [NDB_TYPE_INT64] = "l",
+    [NDB_TYPE_FLOAT64] = "g",
+    [NDB_TYPE_DATE32] = "tdD",
+    [NDB_TYPE_TIMESTAMP] = "tsu:UTC",
+    [NDB_TYPE_DICT_STRING] = "i",   // Indices; the dictionary is "u"
+    // No string views: as a dictionary they would hold duplicate strings
+};
+
+// Column type of an Arrow field, -1 when unsupported
+static int arrow_type_id(const struct ArrowSchema* schema) {
+    const char* format = schema->format;
+    if (schema->dictionary) {
+        return strcmp(format, "i") == 0 && strcmp(schema->dictionary->format, "u") == 0
+                   ? NDB_TYPE_DICT_STRING : -1;
+    }
+    if (strncmp(format, "tsu:", 4) == 0) {
+        return NDB_TYPE_TIMESTAMP;
+    }
+    for (int type_id = 0; type_id < NDB_NUM_TYPES; type_id++) {
+        if (type_id != NDB_TYPE_DICT_STRING && type_id != NDB_TYPE_TIMESTAMP && arrow_formats[type_id] &&
+            strcmp(format, arrow_formats[type_id]) == 0) {
+            return type_id;
+        }
+    }
+    return -1;
+}
+
+// NULLs among bits offset .. offset + length of a validity bitmap
+static int64_t count_arrow_nulls(const uint8_t* bitmap, int64_t offset, int64_t length) {
+    if (!bitmap) {
+        return 0;
+    }
+    int64_t valid = 0;
+    int64_t i = offset;
+    int64_t end = offset + length;
+    for (; i < end && (i & 63); i++) {
+        valid += (bitmap[i >> 3] >> (i & 7)) & 1;
+    }
+    for (; i + 64 <= end; i += 64) {
+        uint64_t word;
+        memcpy(&word, bitmap + (i >> 3), sizeof(word));
+        valid += __builtin_popcountll(word);
+    }
+    for (; i < end; i++) {
+        valid += (bitmap[i >> 3] >> (i & 7)) & 1;
+    }
+    return length - valid;
+}
+
+// =================== Import ===================
+
+typedef struct {
+    struct ArrowArray array;    // Moved from the producer
+    int num_columns;
+    NDBTableC** dictionaries;   // Dictionary made for each column that owns one
+} ImportedArrow;
+
+static void release_imported_arrow(NDBTableC* table) {
+    ImportedArrow* imported = (ImportedArrow*)table->private_data;
+    for (int i = 0; i < imported->num_columns; i++) {
+        free_ndb_table(imported->dictionaries[i]);
+    }
+    free(imported->dictionaries);
+    imported->array.release(&imported->array);
+    free(imported);
+    table->private_data = NULL;
+}
+
+// Validity of rows offset .. offset + rows. A bitmap that starts mid-byte
+// is copied into the table's arena, shifted to start at bit 0.
+static int import_validity(NDBTableC* table, NDBArrayC* column, const struct ArrowArray* source,
+                           int64_t offset, int rows) {
+    const uint8_t* bitmap = (const uint8_t*)source->buffers[0];
+    int64_t null_count = source->null_count;
+    if (!bitmap || null_count == 0) {
+        return 0;
+    }
+    if (null_count < 0 || source->offset != offset || source->length != rows) {
+        null_count = count_arrow_nulls(bitmap, offset, rows);  // Unknown or of another slice
+    }
+    if (null_count == 0) {
+        return 0;
+    }
+    column->null_count = (int32_t)null_count;
+    if (offset % 8 == 0) {
+        column->validity = (uint8_t*)bitmap + offset / 8;
+        return 0;
+    }
+
+    uint8_t* validity = (uint8_t*)ndb_arena_alloc(table->arena, ((size_t)rows + 7) / 8 + 1);
+    if (!validity) {
+        return -1;
+    }
+    memset(validity, 0, ((size_t)rows + 7) / 8);
+    for (int row = 0; row < rows; row++) {
+        int64_t bit = offset + row;
+        validity[row >> 3] |= (uint8_t)(((bitmap[bit >> 3] >> (bit & 7)) & 1) << (row & 7));
+    }
+    column->validity = validity;
+    return 0;
+}
+
+// Strings of rows offset .. offset + rows. The characters stay in place;
+// the offsets are rebased into the arena unless they already start at 0.
+static int import_strings(NDBTableC* table, NDBArrayC* column, const struct ArrowArray* source,
+                          int64_t offset, int rows) {
+    static const int32_t no_offsets[1] = {0};
+    static const char no_characters[1] = {0};
+    const int32_t* offsets = (const int32_t*)source->buffers[1];
+    const char* characters = (const char*)source->buffers[2];
+    if (!offsets) {
+        if (rows > 0) {
+            return -1;
+        }
+        offsets = no_offsets;
+        offset = 0;
+    }
+    offsets += offset;
+    if (offsets[rows] < offsets[0]) {
+        return -1;
+    }
+
+    if (offsets[0] == 0) {
+        column->offsets = (int32_t*)offsets;
+    } else {
+        column->offsets = (int32_t*)ndb_arena_alloc(table->arena, ((size_t)rows + 1) * sizeof(int32_t));
+        if (!column->offsets) {
+            return -1;
+        }
+        for (int row = 0; row <= rows; row++) {
+            column->offsets[row] = offsets[row] - offsets[0];
+        }
+    }
+    column->values = (char*)(characters ? characters + offsets[0] : no_characters);
+    column->value_capacity = offsets[rows] - offsets[0];
+    return 0;
+}
+
+// Wrap an Arrow dictionary as an NDB one: distinct strings without NULLs
+static NDBTableC* import_dictionary(const struct ArrowArray* source) {
+    if (source->n_buffers != 3 || source->length > INT32_MAX - 1 ||
+        count_arrow_nulls((const uint8_t*)source->buffers[0], source->offset, source->length) != 0) {
+        fprintf(stderr, "Error: Arrow dictionary is not a string array without NULLs\n");
+        return NULL;
+    }
+    NDBFieldC field = {.name = "value", .type_id = NDB_TYPE_STRING, .nullable = 0};
+    NDBTableC* dictionary = wrap_ndb_table((int)source->length, 1, &field);
+    if (!dictionary || import_strings(dictionary, &dictionary->columns[0], source, source->offset,
+                                      (int)source->length) != 0) {
+        free_ndb_table(dictionary);
+        return NULL;
+    }
+
+    // Dictionary columns join on their codes, which needs distinct strings
+    int column = 0;
+    NDBKeyCodes codes;
+    if (encode_ndb_join_keys(dictionary, &column, dictionary, &column, 1, &codes) != 0) {
+        free_ndb_table(dictionary);
+        return NULL;
+    }
+    int distinct = codes.distinct == dictionary->num_rows;
+    free_ndb_key_codes(&codes);
+    if (!distinct) {
+        fprintf(stderr, "Error: Arrow dictionary holds duplicate strings\n");
+        free_ndb_table(dictionary);
+        return NULL;
+    }
+    return dictionary;
+}
+
+static int same_arrow_strings(const struct ArrowArray* a, const struct ArrowArray* b) {
+    return a->length == b->length && a->offset == b->offset && a->n_buffers == 3 && b->n_buffers == 3 &&
+           a->buffers[1] == b->buffers[1] && a->buffers[2] == b->buffers[2];
+}
+
+static int import_column(NDBTableC* table, ImportedArrow* imported, const struct ArrowArray* parent, int i) {
+    const struct ArrowArray* source = parent->children[i];
+    NDBArrayC* column = &table->columns[i];
+    int rows = table->num_rows;
+    int64_t offset = parent->offset + source->offset;
+    int width = ndb_type_width(column->type_id);
+    if (source->offset < 0 || source->length < parent->offset + rows ||
+        source->n_buffers != (width > 0 ? 2 : 3) || (width > 0 && rows > 0 && !source->buffers[1])) {
+        fprintf(stderr, "Error: Arrow column %d does not match its format\n", i);
+        return -1;
+    }
+    if (import_validity(table, column, source, offset, rows) != 0) {
+        return -1;
+    }
+    if (width > 0) {
+        column->values = rows > 0 ? (char*)source->buffers[1] + offset * width : NULL;
+    } else if (import_strings(table, column, source, offset, rows) != 0) {
+        fprintf(stderr, "Error: Arrow string column %d has bad offsets\n", i);
+        return -1;
+    }
+    if (column->type_id != NDB_TYPE_DICT_STRING) {
+        return 0;
+    }
+
+    if (!source->dictionary) {
+        fprintf(stderr, "Error: Arrow dictionary column %d has no dictionary\n", i);
+        return -1;
+    }
+    // Columns whose dictionaries are the same buffers share one, so they
+    // still join on their codes
+    for (int k = 0; k < i; k++) {
+        if (imported->dictionaries[k] && same_arrow_strings(parent->children[k]->dictionary, source->dictionary)) {
+            column->dictionary = imported->dictionaries[k];
+            return 0;
+        }
+    }
+    imported->dictionaries[i] = import_dictionary(source->dictionary);
+    column->dictionary = imported->dictionaries[i];
+    return column->dictionary ? 0 : -1;
+}
+
+NDBTableC* import_ndb_arrow_table(const struct ArrowSchema* schema, struct ArrowArray* array) {
+    if (!array->release || strcmp(schema->format, "+s") != 0 || schema->n_children != array->n_children ||
+        array->length > INT32_MAX - 1 || array->offset < 0 ||
+        (array->n_buffers > 0 && count_arrow_nulls((const uint8_t*)array->buffers[0], array->offset,
+                                                   array->length) != 0)) {
+        fprintf(stderr, "Error: Arrow input is not a struct array without NULL rows\n");
+        return NULL;
+    }
+    int num_columns = (int)array->n_children;
+    NDBFieldC* fields = (NDBFieldC*)calloc(num_columns > 0 ? num_columns : 1, sizeof(NDBFieldC));
+    ImportedArrow* imported = (ImportedArrow*)calloc(1, sizeof(ImportedArrow));
+    if (imported) {
+        imported->dictionaries = (NDBTableC**)calloc(num_columns > 0 ? num_columns : 1, sizeof(NDBTableC*));
+    }
+    int ok = fields && imported && imported->dictionaries;
+    for (int i = 0; ok && i < num_columns; i++) {
+        const struct ArrowSchema* child = schema->children[i];
+        fields[i].name = child->name ? child->name : "";
+        fields[i].type_id = arrow_type_id(child);
+        fields[i].nullable = (child->flags & ARROW_FLAG_NULLABLE) != 0;
+        if (fields[i].type_id < 0) {
+            fprintf(stderr, "Error: Arrow column %d has unsupported format \"%s\"\n", i, child->format);
+            ok = 0;
+        }
+    }
+
+    NDBTableC* table = ok ? wrap_ndb_table((int)array->length, num_columns, fields) : NULL;
+    free(fields);
+    if (table) {
+        imported->num_columns = num_columns;
+        for (int i = 0; i < num_columns; i++) {
+            if (import_column(table, imported, array, i) != 0) {
+                free_ndb_table(table);
+                table = NULL;
+                break;
+            }
+        }
+    }
+    if (!table) {
+        for (int i = 0; imported && imported->dictionaries && i < num_columns; i++) {
+            free_ndb_table(imported->dictionaries[i]);
+        }
+        if (imported) {
+            free(imported->dictionaries);
+        }
+        free(imported);
+        return NULL;
+    }
+
+    // Move the array: the producer's copy is released from now on
+    imported->array = *array;
+    array->release = NULL;
+    table->release = release_imported_arrow;
+    table->private_data = imported;
+    return table;
+}
+
+// =================== Export ===================
+
+// The table behind an export, freed with the last exported array
+typedef struct {
+    NDBTableC* table;
+    atomic_int refs;
+} ExportedTable;
+
+// private_data of every exported array
+typedef struct {
+    ExportedTable* owner;
+    const void* buffers[3];
+    struct ArrowArray** child_pointers;
+    struct ArrowArray* children;
+    struct ArrowArray dictionary;
+} ExportedArray;
+
+static void release_exported_table(ExportedTable* owner) {
+    if (atomic_fetch_sub(&owner->refs, 1) == 1) {
+        free_ndb_table(owner->table);
+        free(owner);
+    }
+}
+
+// Children the consumer moved out have been marked released and are skipped
+static void release_exported_array(struct ArrowArray* array) {
+    ExportedArray* node = (ExportedArray*)array->private_data;
+    for (int64_t i = 0; i < array->n_children; i++) {
+        if (array->children[i]->release) {
+            array->children[i]->release(array->children[i]);
+        }
+    }
+    if (array->dictionary && array->dictionary->release) {
+        array->dictionary->release(array->dictionary);
+    }
+    free(node->child_pointers);
+    free(node->children);
+    release_exported_table(node->owner);
+    free(node);
+    array->release = NULL;
+}
+
+static int init_exported_array(ExportedTable* owner, struct ArrowArray* array, int64_t length,
+                               int64_t null_count, int n_buffers, int n_children) {
+    memset(array, 0, sizeof(*array));
+    ExportedArray* node = (ExportedArray*)calloc(1, sizeof(ExportedArray));
+    if (!node) {
+        return -1;
+    }
+    if (n_children > 0) {
+        node->child_pointers = (struct ArrowArray**)calloc(n_children, sizeof(struct ArrowArray*));
+        node->children = (struct ArrowArray*)calloc(n_children, sizeof(struct ArrowArray));
+        if (!node->child_pointers || !node->children) {
+            free(node->child_pointers);
+            free(node->children);
+            free(node);
+            return -1;
+        }
+        for (int i = 0; i < n_children; i++) {
+            node->child_pointers[i] = &node->children[i];
+        }
+    }
+    atomic_fetch_add(&owner->refs, 1);
+    node->owner = owner;
+    array->length = length;
+    array->null_count = null_count;
+    array->n_buffers = n_buffers;
+    array->n_children = n_children;
+    array->buffers = node->buffers;
+    array->children = node->child_pointers;
+    array->release = release_exported_array;
+    array->private_data = node;
+    return 0;
+}
+
+static int export_column(ExportedTable* owner, const NDBArrayC* column, int rows, struct ArrowArray* array) {
+    int64_t null_count = count_arrow_nulls(column->validity, 0, rows);
+    int width = ndb_type_width(column->type_id);
+    if (init_exported_array(owner, array, rows, null_count, width > 0 ? 2 : 3, 0) != 0) {
+        return -1;
+    }
+    ExportedArray* node = (ExportedArray*)array->private_data;
+    node->buffers[0] = null_count > 0 ? column->validity : NULL;
+    if (width > 0) {
+        node->buffers[1] = column->values;
+    } else {
+        node->buffers[1] = column->offsets;
+        node->buffers[2] = column->values;
+    }
+    if (column->type_id != NDB_TYPE_DICT_STRING) {
+        return 0;
+    }
+
+    const NDBTableC* dictionary = column->dictionary;
+    if (!dictionary || init_exported_array(owner, &node->dictionary, dictionary->num_rows, 0, 3, 0) != 0) {
+        return -1;
+    }
+    array->dictionary = &node->dictionary;
+    ExportedArray* strings = (ExportedArray*)node->dictionary.private_data;
+    strings->buffers[1] = dictionary->columns[0].offsets;
+    strings->buffers[2] = dictionary->columns[0].values;
+    return 0;
+}
+
+// private_data of every exported schema
+typedef struct {
+    char* name;
+    struct ArrowSchema** child_pointers;
+    struct ArrowSchema* children;
+    struct ArrowSchema dictionary;
+} ExportedSchema;
+
+static void release_exported_schema(struct ArrowSchema* schema) {
+    ExportedSchema* node = (ExportedSchema*)schema->private_data;
+    for (int64_t i = 0; i < schema->n_children; i++) {
+        if (schema->children[i]->release) {
+            schema->children[i]->release(schema->children[i]);
+        }
+    }
+    if (schema->dictionary && schema->dictionary->release) {
+        schema->dictionary->release(schema->dictionary);
+    }
+    free(node->name);
+    free(node->child_pointers);
+    free(node->children);
+    free(node);
+    schema->release = NULL;
+}
+
+static int init_exported_schema(struct ArrowSchema* schema, const char* format, const char* name,
+                                int64_t flags, int n_children) {
+    memset(schema, 0, sizeof(*schema));
+    ExportedSchema* node = (ExportedSchema*)calloc(1, sizeof(ExportedSchema));
+    if (!node) {
+        return -1;
+    }
+    node->name = name ? strdup(name) : NULL;
+    if (n_children > 0) {
+        node->child_pointers = (struct ArrowSchema**)calloc(n_children, sizeof(struct ArrowSchema*));
+        node->children = (struct ArrowSchema*)calloc(n_children, sizeof(struct ArrowSchema));
+    }
+    if ((name && !node->name) || (n_children > 0 && (!node->child_pointers || !node->children))) {
+        free(node->name);
+        free(node->child_pointers);
+        free(node->children);
+        free(node);
+        return -1;
+    }
+    for (int i = 0; i < n_children; i++) {
+        node->child_pointers[i] = &node->children[i];
+    }
+    schema->format = format;
+    schema->name = node->name;
+    schema->flags = flags;
+    schema->n_children = n_children;
+    schema->children = node->child_pointers;
+    schema->release = release_exported_schema;
+    schema->private_data = node;
+    return 0;
+}
+
+static int export_schema(const NDBTableC* table, struct ArrowSchema* schema) {
+    if (init_exported_schema(schema, "+s", "", 0, table->num_columns) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < table->num_columns; i++) {
+        const NDBFieldC* field = &table->fields[i];
+        int64_t flags = field->nullable ? ARROW_FLAG_NULLABLE : 0;
+        struct ArrowSchema* child = schema->children[i];
+        if (init_exported_schema(child, arrow_formats[field->type_id], field->name, flags, 0) != 0) {
+            schema->release(schema);
+            return -1;
+        }
+        if (field->type_id == NDB_TYPE_DICT_STRING) {
+            ExportedSchema* node = (ExportedSchema*)child->private_data;
+            if (init_exported_schema(&node->dictionary, "u", NULL, 0, 0) != 0) {
+                schema->release(schema);
+                return -1;
+            }
+            child->dictionary = &node->dictionary;
+        }
+    }
+    return 0;
+}
+
+int export_ndb_arrow_table(NDBTableC* table, struct ArrowSchema* schema, struct ArrowArray* array) {
+    for (int i = 0; i < table->num_columns; i++) {
+        int type_id = table->columns[i].type_id;
+        if (type_id < 0 || type_id >= NDB_NUM_TYPES || !arrow_formats[type_id] ||
+            type_id != table->fields[i].type_id ||
+            (type_id == NDB_TYPE_DICT_STRING && !table->columns[i].dictionary)) {
+            fprintf(stderr, "Error: column %d cannot be exported to Arrow\n", i);
+            return -1;
+        }
+    }
+    if (export_schema(table, schema) != 0) {
+        return -1;
+    }
+
+    // The export holds a reference of its own until every array is set up
+    ExportedTable* owner = (ExportedTable*)malloc(sizeof(ExportedTable));
+    if (!owner) {
+        schema->release(schema);
+        return -1;
+    }
+    owner->table = table;
+    atomic_init(&owner->refs, 1);
+    int status = init_exported_array(owner, array, table->num_rows, 0, 1, table->num_columns);
+    for (int i = 0; status == 0 && i < table->num_columns; i++) {
+        status = export_column(owner, &table->columns[i], table->num_rows, array->children[i]);
+    }
+    if (status != 0) {
+        owner->table = NULL;        // Still the caller's
+        if (array->release) {
+            array->release(array);
+        }
+        schema->release(schema);
+    }
+    release_exported_table(owner);
+    return status;
+}
@@ -0,0 +1,126 @@
+#include "columnar_bloom.h"
+#include "columnar_hashjoin.h"
+#include "columnar_simd.h"
+#include "columnar_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOOM_ALIGNMENT 64
+
+// Keys hashed and tested together
+#define BLOOM_BATCH 64
+
+int init_ndb_bloom_filter(NDBBloomFilter* filter, int64_t expected_keys) {
+    uint64_t wanted = (uint64_t)((expected_keys > 0 ? expected_keys : 1) * NDB_BLOOM_BITS_PER_KEY + 63) / 64;
+    uint64_t num_blocks = 1;
+    while (num_blocks < wanted) {
+        num_blocks <<= 1;
+    }
+    size_t bytes = num_blocks * sizeof(uint64_t);
+    filter->blocks = (uint64_t*)aligned_alloc(BLOOM_ALIGNMENT, bytes > BLOOM_ALIGNMENT ? bytes : BLOOM_ALIGNMENT);
+    filter->block_mask = num_blocks - 1;
+    if (!filter->blocks) {
+        return -1;
+    }
+    memset(filter->blocks, 0, bytes);
+    return 0;
+}
+
+void free_ndb_bloom_filter(NDBBloomFilter* filter) {
+    free(filter->blocks);
+    filter->blocks = NULL;
+    filter->block_mask = 0;
+}
+
+void add_ndb_bloom_hashes(NDBBloomFilter* filter, const uint64_t* hashes, int count) {
+    for (int i = 0; i < count; i++) {
+        filter->blocks[ndb_bloom_block(hashes[i], filter->block_mask)] |= ndb_bloom_bits(hashes[i]);
+    }
+}
+
+void test_ndb_bloom_hashes(const NDBBloomFilter* filter, const uint64_t* hashes, int count, uint64_t* pass) {
+    if (!filter->blocks) {
+        for (int w = 0; w < (count + 63) / 64; w++) {
+            pass[w] = ~0ULL;
+        }
+        return;
+    }
+    simd_test_bloom_blocks(filter->blocks, filter->block_mask, hashes, count, pass);
+}
+
+// Only int32 values hash alike in any two tables: other types join
+// through codes that the two sides of one join share, dictionary codes
+// only within one dictionary
+static int bloom_key_column(const NDBTableC* table, int key_column) {
+    const NDBTypeInfo* info = key_column >= 0 && key_column < table->num_columns
+                              ? ndb_type_info(table->columns[key_column].type_id) : NULL;
+    if (!info || !info->int32_key || info->decoded) {
+        fprintf(stderr, "Error: column %d is not an int32 key column a Bloom filter can take\n", key_column);
+        return 0;
+    }
+    return 1;
+}
+
+// Bit j set when row base + j (j < n <= 64) has a key: a NULL key
+// matches nothing, so it is never added nor passed
+static uint64_t present_keys(const NDBArrayC* array, int base, int n) {
+    uint64_t present = n == 64 ? ~0ULL : (1ULL << n) - 1;
+    for (int j = 0; array->validity && j < n; j++) {
+        int row = base + j;
+        if (!(array->validity[row >> 3] & (1 << (row & 7)))) {
+            present &= ~(1ULL << j);
+        }
+    }
+    return present;
+}
+
+int build_ndb_bloom_filter(NDBBloomFilter* filter, const NDBTableC* table, int key_column,
+                           NDBHashFunction hash_function) {
+    filter->blocks = NULL;
+    filter->block_mask = 0;
+    if (!bloom_key_column(table, key_column) || init_ndb_bloom_filter(filter, table->num_rows) != 0) {
+        return -1;
+    }
+    const NDBArrayC* array = &table->columns[key_column];
+    uint64_t hashes[BLOOM_BATCH];
+    for (int base = 0; base < table->num_rows; base += BLOOM_BATCH) {
+        int n = table->num_rows - base < BLOOM_BATCH ? table->num_rows - base : BLOOM_BATCH;
+        // Same keys and hashes as the join build
+        ndb_hash_keys(hash_function, (const int32_t*)array->values + base, hashes, n);
+        uint64_t present = present_keys(array, base, n);
+        int kept = 0;
+        for (uint64_t bits = present; bits; bits &= bits - 1) {
+            hashes[kept++] = hashes[__builtin_ctzll(bits)];
+        }
+        add_ndb_bloom_hashes(filter, hashes, kept);
+    }
+    return 0;
+}
+
+int filter_ndb_rows(const NDBBloomFilter* filter, const NDBTableC* table, int key_column,
+                    NDBHashFunction hash_function, int start, int count, int32_t* rows) {
+    if (!bloom_key_column(table, key_column)) {
+        return -1;
+    }
+    if (start < 0 || count < 0 || start > table->num_rows - count) {
+        fprintf(stderr, "Error: rows [%d, %d + %d) are not rows of the table\n", start, start, count);
+        return -1;
+    }
+    const NDBArrayC* array = &table->columns[key_column];
+    int out = 0;
+    uint64_t hashes[BLOOM_BATCH];
+    uint64_t pass;
+    for (int base = start; base < start + count; base += BLOOM_BATCH) {
+        int n = start + count - base < BLOOM_BATCH ? start + count - base : BLOOM_BATCH;
+        // Same keys and hashes as the join probe
+        ndb_hash_keys(hash_function, (const int32_t*)array->values + base, hashes, n);
+        test_ndb_bloom_hashes(filter, hashes, n, &pass);
+        pass &= present_keys(array, base, n);
+        while (pass) {
+            rows[out++] = base + __builtin_ctzll(pass);
+            pass &= pass - 1;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,205 @@
+#include "columnar_datagen.h"
+#include "columnar_hashjoin.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =================== Random numbers ===================
+
+// splitmix64: small, fast and good enough for data generation
+static inline uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t random_below(uint64_t* state, uint64_t bound) {
+    return (uint64_t)(((unsigned __int128)next_random(state) * bound) >> 64);
+}
+
+static inline double random_unit(uint64_t* state) {
+    return (double)(next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Zipf ranks in [0, n) after Gray et al., "Quickly Generating
+// Billion-Record Synthetic Databases"; rank 0 is the most frequent
+typedef struct {
+    uint64_t n;
+    double rank1_cutoff;    // 1 + 0.5^theta: u * zeta(n) below it draws rank 1
+    double alpha;
+    double zetan;
+    double eta;
+} ZipfGenerator;
+
+static void init_zipf(ZipfGenerator* zipf, uint64_t n, double theta) {
+    double zetan = 0.0;
+    for (uint64_t i = 1; i <= n; i++) {
+        zetan += 1.0 / pow((double)i, theta);
+    }
+    double zeta2 = 1.0 + pow(0.5, theta);
+    zipf->n = n;
+    zipf->rank1_cutoff = zeta2;
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->zetan = zetan;
+    zipf->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+
+static uint64_t next_zipf(const ZipfGenerator* zipf, uint64_t* state) {
+    double u = random_unit(state);
+    double uz = u * zipf->zetan;
+    if (uz < 1.0) return 0;
+    if (uz < zipf->rank1_cutoff) return 1;
+    uint64_t rank = (uint64_t)((double)zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+// =================== Table generation ===================
+
+// Build keys are even, so odd keys are guaranteed misses
+static inline int32_t hit_key(int64_t key_idx) {
+    return (int32_t)(key_idx * 2);
+}
+
+static inline int32_t miss_key(uint64_t* state, int64_t num_keys) {
+    return (int32_t)(random_below(state, (uint64_t)num_keys + 1) * 2 + 1);
+}
+
+void init_ndb_datagen_options(NDBDataGenOptions* options) {
+    options->build_rows = 1 << 20;
+    options->probe_rows = 1 << 22;
+    options->distribution = NDB_KEYS_UNIFORM;
+    options->zipf_theta = 0.99;
+    options->match_rate = 1.0;
+    options->duplicates = 1;
+    options->string_width = 16;
+    options->seed = 42;
+}
+
+const char* ndb_key_distribution_name(NDBKeyDistribution distribution) {
+    switch (distribution) {
+    case NDB_KEYS_UNIFORM: return "uniform";
+    case NDB_KEYS_ZIPF: return "zipf";
+    case NDB_KEYS_SEQUENTIAL: return "sequential";
+    }
+    return "unknown";
+}
+
+static NDBTableC* create_input_table(const char* key_name, const char* payload_name,
+                                     int rows, int string_width) {
+    NDBFieldC schema[2] = {
+        {.name = key_name, .type_id = 0, .nullable = 0},
+        {.name = payload_name, .type_id = 1, .nullable = 0}
+    };
+    NDBTableC* table = create_ndb_table(rows, string_width > 0 ? 2 : 1, schema);
+    if (table && string_width > 0 &&
+        reserve_ndb_string_bytes(table, 1, (int64_t)rows * string_width) != 0) {
+        free_ndb_table(table);
+        return NULL;
+    }
+    return table;
+}
+
+// Fixed-width payload derived from the row number
+static int fill_payload(NDBTableC* table, int rows, int width) {
+    if (width <= 0) {
+        return 0;
+    }
+    char* text = (char*)malloc(width);
+    NDBStringBuilder builder;
+    if (!text || init_ndb_string_builder(&builder, table, 1, 0) != 0) {
+        free(text);
+        return -1;
+    }
+    for (int i = 0; i < rows; i++) {
+        uint32_t x = (uint32_t)i;
+        for (int c = 0; c < width; c++) {
+            text[c] = (char)('a' + x % 26);
+            x = x / 26 + (uint32_t)c * 7;
+        }
+        if (append_ndb_string(&builder, text, width) != 0) {
+            free(text);
+            return -1;
+        }
+    }
+    free(text);
+    return 0;
+}
+
+int generate_ndb_join_inputs(const NDBDataGenOptions* options,
+                             NDBTableC** build_table, NDBTableC** probe_table) {
+    *build_table = NULL;
+    *probe_table = NULL;
+    if (options->build_rows <= 0 || options->probe_rows < 0 || options->duplicates <= 0 ||
+        options->match_rate < 0.0 || options->match_rate > 1.0 ||
+        options->string_width < 0 || (int64_t)options->build_rows * 2 > INT32_MAX ||
+        (options->distribution == NDB_KEYS_ZIPF &&
+         (options->zipf_theta <= 0.0 || options->zipf_theta >= 1.0))) {
+        return -1;
+    }
+
+    uint64_t state = options->seed;
+    int64_t num_keys = (options->build_rows + options->duplicates - 1) / options->duplicates;
+    NDBTableC* build = create_input_table("build_key", "build_payload", options->build_rows,
+                                          options->string_width);
+    NDBTableC* probe = create_input_table("probe_key", "probe_payload", options->probe_rows,
+                                          options->string_width);
+    if (!build || !probe) {
+        free_ndb_table(build);
+        free_ndb_table(probe);
+        return -1;
+    }
+
+    // Build side: key i repeated `duplicates` times; shuffled unless sequential
+    int32_t* build_keys = (int32_t*)build->columns[0].values;
+    for (int i = 0; i < options->build_rows; i++) {
+        build_keys[i] = hit_key(i / options->duplicates);
+    }
+    if (options->distribution != NDB_KEYS_SEQUENTIAL) {
+        for (int i = options->build_rows - 1; i > 0; i--) {
+            int j = (int)random_below(&state, (uint64_t)i + 1);
+            int32_t tmp = build_keys[i];
+            build_keys[i] = build_keys[j];
+            build_keys[j] = tmp;
+        }
+    }
+    build->num_rows = options->build_rows;
+
+    // Probe side: pick a key index per row, or a miss key
+    ZipfGenerator zipf = {0};
+    if (options->distribution == NDB_KEYS_ZIPF) {
+        init_zipf(&zipf, (uint64_t)num_keys, options->zipf_theta);
+    }
+    int32_t* probe_keys = (int32_t*)probe->columns[0].values;
+    for (int i = 0; i < options->probe_rows; i++) {
+        if (random_unit(&state) >= options->match_rate) {
+            probe_keys[i] = miss_key(&state, num_keys);
+            continue;
+        }
+        int64_t key_idx;
+        switch (options->distribution) {
+        case NDB_KEYS_ZIPF:
+            key_idx = (int64_t)next_zipf(&zipf, &state);
+            break;
+        case NDB_KEYS_SEQUENTIAL:
+            key_idx = i % num_keys;
+            break;
+        default:
+            key_idx = (int64_t)random_below(&state, (uint64_t)num_keys);
+            break;
+        }
+        probe_keys[i] = hit_key(key_idx);
+    }
+    probe->num_rows = options->probe_rows;
+
+    if (fill_payload(build, options->build_rows, options->string_width) != 0 ||
+        fill_payload(probe, options->probe_rows, options->string_width) != 0) {
+        free_ndb_table(build);
+        free_ndb_table(probe);
+        return -1;
+    }
+
+    *build_table = build;
+    *probe_table = probe;
+    return 0;
+}
@@ -0,0 +1,564 @@
+#include "columnar_file.h"
+#include "columnar_hashjoin.h"
+#include "columnar_join_index.h"
+#include "columnar_types.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =================== File layout ===================
+//
+//   header (64 bytes)
+//   column 0 segments, column 1 segments, ...   each 64-byte aligned
+//   index 0 segments, index 1 segments, ...
+//   footer: FileFooter, FileColumn[num_columns], column names, FileIndex[num_indexes]
+//   trailer: where the footer is
+//
+// The footer comes last so the writer streams the segments without
+// knowing their sizes up front; the reader finds it from the trailer.
+
+#define NDB_FILE_MAGIC "NDBCOLF1"
+#define NDB_FILE_VERSION 3               // 2: join indexes, 3: changed join indexes
+#define NDB_FILE_BYTE_ORDER 0x01020304u   // Reads back differently on a foreign byte order
+#define NDB_FILE_ALIGN 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint8_t padding[48];
+} FileHeader;
+
+typedef struct {
+    uint64_t offset;            // From the start of the file, 0 with bytes = 0 when absent
+    uint64_t bytes;
+} FileSegment;
+
+typedef struct {
+    int32_t type_id;
+    int32_t nullable;
+    uint32_t name_offset;       // Into the names after the columns
+    int32_t dictionary_source;  // Earlier column whose dictionary this one shares, -1 = none
+    int32_t dictionary_rows;
+    int32_t padding;
+    FileSegment validity;
+    FileSegment offsets;
+    FileSegment values;
+    FileSegment dictionary_offsets;
+    FileSegment dictionary_values;
+    NDBColumnStats stats;
+} FileColumn;
+
+// A join index: its image (see NDBJoinIndexImage) with the arrays as segments
+typedef struct {
+    int64_t scalars[NDB_JOIN_INDEX_SCALARS];
+    FileSegment arrays[NDB_JOIN_INDEX_ARRAYS];
+} FileIndex;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t num_columns;
+    int32_t num_rows;
+    uint32_t names_bytes;
+    int32_t num_indexes;
+    int32_t padding;
+} FileFooter;
+
+typedef struct {
+    uint64_t footer_offset;
+    uint64_t footer_bytes;
+    char magic[8];
+} FileTrailer;
+
+static inline int bitmap_get(const uint8_t* bitmap, int64_t idx) {
+    return (bitmap[idx >> 3] >> (idx & 7)) & 1;
+}
+
+// =================== Statistics ===================
+
+static void compute_column_stats(const NDBTableC* table, int column, NDBColumnStats* stats) {
+    const NDBArrayC* array = &table->columns[column];
+    memset(stats, 0, sizeof(*stats));
+
+    for (int row = 0; row < table->num_rows; row++) {
+        if (array->validity && !bitmap_get(array->validity, row)) {
+            stats->null_count++;
+            continue;
+        }
+        int64_t value;
+        switch (array->type_id) {
+        case NDB_TYPE_INT32:
+        case NDB_TYPE_DATE32:
+            value = ((const int32_t*)array->values)[row];
+            break;
+        case NDB_TYPE_INT64:
+        case NDB_TYPE_TIMESTAMP:
+            value = ((const int64_t*)array->values)[row];
+            break;
+        case NDB_TYPE_FLOAT64: {
+            double v = ((const double*)array->values)[row];
+            if (isnan(v)) {
+                continue;
+            }
+            if (!stats->has_range || v < stats->min_float) stats->min_float = v;
+            if (!stats->has_range || v > stats->max_float) stats->max_float = v;
+            stats->has_range = 1;
+            continue;
+        }
+        case NDB_TYPE_STRING:
+            if (array->offsets[row + 1] - array->offsets[row] > stats->max_length) {
+                stats->max_length = array->offsets[row + 1] - array->offsets[row];
+            }
+            continue;
+        default:
+            continue;
+        }
+        if (!stats->has_range || value < stats->min_int) stats->min_int = value;
+        if (!stats->has_range || value > stats->max_int) stats->max_int = value;
+        stats->has_range = 1;
+    }
+
+    // A dictionary column is as long as its longest dictionary string
+    if (array->type_id == NDB_TYPE_DICT_STRING && array->dictionary) {
+        const NDBArrayC* strings = &array->dictionary->columns[0];
+        for (int row = 0; row < array->dictionary->num_rows; row++) {
+            if (strings->offsets[row + 1] - strings->offsets[row] > stats->max_length) {
+                stats->max_length = strings->offsets[row + 1] - strings->offsets[row];
+            }
+        }
+    }
+}
+
+// =================== Writer ===================
+
+typedef struct {
+    FILE* file;
+    uint64_t position;
+    int failed;
+} FileWriter;
+
+static void write_bytes(FileWriter* writer, const void* data, size_t bytes) {
+    if (writer->failed || bytes == 0) {
+        return;
+    }
+    if (fwrite(data, 1, bytes, writer->file) != bytes) {
+        writer->failed = 1;
+        return;
+    }
+    writer->position += bytes;
+}
+
+static void write_padding(FileWriter* writer) {
+    static const uint8_t zeros[NDB_FILE_ALIGN];
+    write_bytes(writer, zeros, (NDB_FILE_ALIGN - writer->position % NDB_FILE_ALIGN) % NDB_FILE_ALIGN);
+}
+
+static FileSegment write_segment(FileWriter* writer, const void* data, size_t bytes) {
+    FileSegment segment = {0, 0};
+    if (bytes == 0) {
+        return segment;
+    }
+    write_padding(writer);
+    segment.offset = writer->position;
+    segment.bytes = bytes;
+    write_bytes(writer, data, bytes);
+    return segment;
+}
+
+// Offsets and characters of the first rows of a string column
+static void write_string_segments(FileWriter* writer, const NDBArrayC* array, int rows,
+                                  FileSegment* offsets, FileSegment* values) {
+    static const int32_t no_strings[1] = {0};
+    if (!array->offsets) {
+        *offsets = write_segment(writer, no_strings, sizeof(no_strings));
+        *values = write_segment(writer, NULL, 0);
+        return;
+    }
+    *offsets = write_segment(writer, array->offsets, ((size_t)rows + 1) * sizeof(int32_t));
+    *values = write_segment(writer, array->values, (size_t)array->offsets[rows]);
+}
+
+int write_ndb_table_file(const NDBTableC* table, const char* path) {
+    return write_ndb_table_file_with_indexes(table, NULL, 0, path);
+}
+
+int write_ndb_table_file_with_indexes(const NDBTableC* table, const NDBJoinIndex* const* indexes, int num_indexes,
+                                      const char* path) {
+    int num_columns = table->num_columns;
+    int rows = table->num_rows;
+    for (int i = 0; i < num_columns; i++) {
+        if (table->columns[i].type_id == NDB_TYPE_STRING_VIEW) {
+            fprintf(stderr, "Error: column %d is a string view, gather it into strings to write it\n", i);
+            return -1;
+        }
+    }
+    for (int x = 0; x < num_indexes; x++) {
+        if (ndb_join_index_table(indexes[x]) != table) {
+            fprintf(stderr, "Error: index %d is not an index of the table written\n", x);
+            return -1;
+        }
+    }
+    FileColumn* columns = (FileColumn*)calloc(num_columns > 0 ? num_columns : 1, sizeof(FileColumn));
+    FileIndex* file_indexes = (FileIndex*)calloc(num_indexes > 0 ? num_indexes : 1, sizeof(FileIndex));
+    if (!columns || !file_indexes) {
+        free(columns);
+        free(file_indexes);
+        return -1;
+    }
+    FileWriter writer = {fopen(path, "wb"), 0, 0};
+    if (!writer.file) {
+        fprintf(stderr, "Error: cannot create %s\n", path);
+        free(columns);
+        free(file_indexes);
+        return -1;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NDB_FILE_MAGIC, sizeof(header.magic));
+    header.version = NDB_FILE_VERSION;
+    header.byte_order = NDB_FILE_BYTE_ORDER;
+    write_bytes(&writer, &header, sizeof(header));
+
+    uint32_t names_bytes = 0;
+    for (int i = 0; i < num_columns && !writer.failed; i++) {
+        const NDBArrayC* array = &table->columns[i];
+        FileColumn* column = &columns[i];
+        column->type_id = array->type_id;
+        column->nullable = table->fields[i].nullable;
+        column->name_offset = names_bytes;
+        column->dictionary_source = -1;
+        names_bytes += (uint32_t)strlen(table->fields[i].name) + 1;
+        compute_column_stats(table, i, &column->stats);
+
+        if (array->validity && column->stats.null_count > 0) {
+            column->validity = write_segment(&writer, array->validity, ((size_t)rows + 7) / 8);
+        }
+        int width = ndb_type_width(array->type_id);
+        if (width > 0) {
+            column->values = write_segment(&writer, array->values, (size_t)rows * width);
+        } else if (array->type_id == NDB_TYPE_STRING) {
+            write_string_segments(&writer, array, rows, &column->offsets, &column->values);
+        } else {
+            fprintf(stderr, "Error: column %d has unknown type %d\n", i, array->type_id);
+            writer.failed = 1;
+        }
+        if (array->type_id != NDB_TYPE_DICT_STRING) {
+            continue;
+        }
+
+        // A dictionary goes to the file once, with the first column using it
+        if (!array->dictionary) {
+            fprintf(stderr, "Error: dictionary column %d has no dictionary\n", i);
+            writer.failed = 1;
+            break;
+        }
+        for (int k = 0; k < i && column->dictionary_source < 0; k++) {
+            if (table->columns[k].type_id == NDB_TYPE_DICT_STRING &&
+                table->columns[k].dictionary == array->dictionary) {
+                column->dictionary_source = k;
+            }
+        }
+        if (column->dictionary_source < 0) {
+            column->dictionary_rows = array->dictionary->num_rows;
+            write_string_segments(&writer, &array->dictionary->columns[0], column->dictionary_rows,
+                                  &column->dictionary_offsets, &column->dictionary_values);
+        }
+    }
+
+    for (int x = 0; x < num_indexes && !writer.failed; x++) {
+        NDBJoinIndexImage image;
+        get_ndb_join_index_image(indexes[x], &image);
+        memcpy(file_indexes[x].scalars, image.scalars, sizeof(image.scalars));
+        for (int a = 0; a < NDB_JOIN_INDEX_ARRAYS; a++) {
+            file_indexes[x].arrays[a] = write_segment(&writer, image.arrays[a], image.bytes[a]);
+        }
+    }
+
+    names_bytes = (names_bytes + 7) & ~7u;     // Keeps the indexes and trailer aligned
+
+    FileFooter footer;
+    memset(&footer, 0, sizeof(footer));
+    memcpy(footer.magic, NDB_FILE_MAGIC, sizeof(footer.magic));
+    footer.version = NDB_FILE_VERSION;
+    footer.num_columns = num_columns;
+    footer.num_rows = rows;
+    footer.names_bytes = names_bytes;
+    footer.num_indexes = num_indexes;
+
+    write_padding(&writer);
+    FileTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.footer_offset = writer.position;
+    write_bytes(&writer, &footer, sizeof(footer));
+    write_bytes(&writer, columns, (size_t)num_columns * sizeof(FileColumn));
+    for (int i = 0; i < num_columns; i++) {
+        write_bytes(&writer, table->fields[i].name, strlen(table->fields[i].name) + 1);
+    }
+    write_bytes(&writer, "\0\0\0\0\0\0\0", (8 - writer.position % 8) % 8);
+    write_bytes(&writer, file_indexes, (size_t)num_indexes * sizeof(FileIndex));
+    trailer.footer_bytes = writer.position - trailer.footer_offset;
+    memcpy(trailer.magic, NDB_FILE_MAGIC, sizeof(trailer.magic));
+    write_bytes(&writer, &trailer, sizeof(trailer));
+    free(columns);
+    free(file_indexes);
+
+    if (fclose(writer.file) != 0) {
+        writer.failed = 1;
+    }
+    if (writer.failed) {
+        fprintf(stderr, "Error: failed to write %s\n", path);
+        remove(path);
+        return -1;
+    }
+    return 0;
+}
+
+// =================== Reader ===================
+
+typedef struct {
+    void* base;
+    size_t size;
+    const FileColumn* columns;  // In the mapped footer
+    int num_columns;
+    const FileIndex* indexes;   // In the mapped footer
+    int num_indexes;
+    uint64_t data_end;          // Where the footer starts
+    NDBTableC** dictionaries;   // Dictionary of each column that owns one
+} MappedFile;
+
+static void release_mapped_file(NDBTableC* table) {
+    MappedFile* mapped = (MappedFile*)table->private_data;
+    for (int i = 0; i < mapped->num_columns; i++) {
+        free_ndb_table(mapped->dictionaries[i]);
+    }
+    free(mapped->dictionaries);
+    munmap(mapped->base, mapped->size);
+    free(mapped);
+    table->private_data = NULL;
+}
+
+// Is the segment inside the data area, aligned, and exactly bytes long?
+static int segment_ok(const FileSegment* segment, uint64_t bytes, uint64_t data_end) {
+    if (segment->bytes != bytes) {
+        return 0;
+    }
+    return bytes == 0 || (segment->offset % NDB_FILE_ALIGN == 0 && segment->offset <= data_end &&
+                          segment->bytes <= data_end - segment->offset);
+}
+
+static void* segment_data(const MappedFile* mapped, const FileSegment* segment) {
+    return segment->bytes ? (char*)mapped->base + segment->offset : NULL;
+}
+
+// Point a string column at its mapped segments. Only the first and last
+// offsets are checked: the others are trusted, so that mapping a column
+// does not read it.
+static int map_string_segments(const MappedFile* mapped, const FileSegment* offsets_segment,
+                               const FileSegment* values_segment, int rows, uint64_t data_end,
+                               NDBArrayC* array) {
+    if (!segment_ok(offsets_segment, ((uint64_t)rows + 1) * sizeof(int32_t), data_end) ||
+        !segment_ok(values_segment, values_segment->bytes, data_end) || values_segment->bytes > INT32_MAX) {
+        return -1;
+    }
+    int32_t* offsets = (int32_t*)segment_data(mapped, offsets_segment);
+    if (offsets[0] != 0 || (uint64_t)offsets[rows] != values_segment->bytes) {
+        return -1;
+    }
+    array->offsets = offsets;
+    array->values = segment_data(mapped, values_segment);
+    array->value_capacity = (int32_t)values_segment->bytes;
+    return 0;
+}
+
+static int map_column(MappedFile* mapped, NDBTableC* table, int i, uint64_t data_end) {
+    const FileColumn* column = &mapped->columns[i];
+    NDBArrayC* array = &table->columns[i];
+    int rows = table->num_rows;
+    array->null_count = (int32_t)column->stats.null_count;
+
+    if (!segment_ok(&column->validity, column->validity.bytes ? ((uint64_t)rows + 7) / 8 : 0, data_end)) {
+        return -1;
+    }
+    array->validity = (uint8_t*)segment_data(mapped, &column->validity);
+
+    int width = ndb_type_width(column->type_id);
+    if (width > 0) {
+        if (!segment_ok(&column->values, (uint64_t)rows * width, data_end)) {
+            return -1;
+        }
+        array->values = segment_data(mapped, &column->values);
+    } else if (map_string_segments(mapped, &column->offsets, &column->values, rows, data_end, array) != 0) {
+        return -1;
+    }
+    if (column->type_id != NDB_TYPE_DICT_STRING) {
+        return 0;
+    }
+
+    if (column->dictionary_source >= 0) {
+        if (column->dictionary_source >= i ||
+            mapped->columns[column->dictionary_source].type_id != NDB_TYPE_DICT_STRING) {
+            return -1;
+        }
+        array->dictionary = table->columns[column->dictionary_source].dictionary;
+        return 0;
+    }
+    NDBFieldC field = {.name = "value", .type_id = NDB_TYPE_STRING, .nullable = 0};
+    NDBTableC* dictionary = wrap_ndb_table(column->dictionary_rows, 1, &field);
+    if (!dictionary || column->dictionary_rows < 0) {
+        free_ndb_table(dictionary);
+        return -1;
+    }
+    mapped->dictionaries[i] = dictionary;
+    array->dictionary = dictionary;
+    return map_string_segments(mapped, &column->dictionary_offsets, &column->dictionary_values,
+                               column->dictionary_rows, data_end, &dictionary->columns[0]);
+}
+
+// Footer of a mapped file, or NULL when the file is not one of ours
+static const FileFooter* find_footer(const MappedFile* mapped, uint64_t* data_end) {
+    if (mapped->size < sizeof(FileHeader) + sizeof(FileTrailer)) {
+        return NULL;
+    }
+    const FileHeader* header = (const FileHeader*)mapped->base;
+    const FileTrailer* trailer = (const FileTrailer*)((const char*)mapped->base + mapped->size - sizeof(FileTrailer));
+    if (memcmp(header->magic, NDB_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        memcmp(trailer->magic, NDB_FILE_MAGIC, sizeof(trailer->magic)) != 0 ||
+        header->version != NDB_FILE_VERSION || header->byte_order != NDB_FILE_BYTE_ORDER) {
+        return NULL;
+    }
+
+    uint64_t trailer_offset = mapped->size - sizeof(FileTrailer);
+    if (trailer->footer_offset % NDB_FILE_ALIGN != 0 || trailer->footer_offset > trailer_offset ||
+        trailer->footer_bytes != trailer_offset - trailer->footer_offset ||
+        trailer->footer_bytes < sizeof(FileFooter)) {
+        return NULL;
+    }
+    const FileFooter* footer = (const FileFooter*)((const char*)mapped->base + trailer->footer_offset);
+    if (memcmp(footer->magic, NDB_FILE_MAGIC, sizeof(footer->magic)) != 0 ||
+        footer->version != NDB_FILE_VERSION || footer->num_columns < 0 || footer->num_rows < 0 ||
+        footer->num_indexes < 0 || footer->names_bytes % 8 != 0 ||
+        trailer->footer_bytes != sizeof(FileFooter) + (uint64_t)footer->num_columns * sizeof(FileColumn) +
+                                 footer->names_bytes + (uint64_t)footer->num_indexes * sizeof(FileIndex)) {
+        return NULL;
+    }
+    *data_end = trailer->footer_offset;
+    return footer;
+}
+
+NDBTableC* map_ndb_table_file(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: cannot open %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    MappedFile* mapped = (MappedFile*)calloc(1, sizeof(MappedFile));
+    if (!mapped || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        fprintf(stderr, "Error: cannot read %s\n", path);
+        free(mapped);
+        close(fd);
+        return NULL;
+    }
+    // Private and writable: the table may be modified in place like any
+    // other, without the changes reaching the file
+    mapped->size = (size_t)st.st_size;
+    mapped->base = mmap(NULL, mapped->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped->base == MAP_FAILED) {
+        fprintf(stderr, "Error: cannot map %s\n", path);
+        free(mapped);
+        return NULL;
+    }
+
+    uint64_t data_end = 0;
+    const FileFooter* footer = find_footer(mapped, &data_end);
+    int num_columns = footer ? footer->num_columns : 0;
+    const char* names = NULL;
+    NDBFieldC* schema = NULL;
+    if (footer) {
+        mapped->columns = (const FileColumn*)(footer + 1);
+        names = (const char*)(mapped->columns + num_columns);
+        mapped->indexes = (const FileIndex*)(names + footer->names_bytes);
+        mapped->num_indexes = footer->num_indexes;
+        mapped->data_end = data_end;
+        schema = (NDBFieldC*)calloc(num_columns > 0 ? num_columns : 1, sizeof(NDBFieldC));
+        mapped->dictionaries = (NDBTableC**)calloc(num_columns > 0 ? num_columns : 1, sizeof(NDBTableC*));
+    }
+    int ok = footer && schema && mapped->dictionaries;
+    for (int i = 0; ok && i < num_columns; i++) {
+        const FileColumn* column = &mapped->columns[i];
+        ok = ndb_type_info(column->type_id) != NULL && column->type_id != NDB_TYPE_STRING_VIEW &&
+             column->name_offset < footer->names_bytes &&
+             memchr(names + column->name_offset, '\0', footer->names_bytes - column->name_offset) != NULL;
+        if (ok) {
+            schema[i].name = names + column->name_offset;
+            schema[i].type_id = column->type_id;
+            schema[i].nullable = (int8_t)column->nullable;
+        }
+    }
+
+    NDBTableC* table = ok ? wrap_ndb_table(footer->num_rows, num_columns, schema) : NULL;
+    free(schema);
+    if (table) {
+        mapped->num_columns = num_columns;
+        table->release = release_mapped_file;
+        table->private_data = mapped;
+        for (int i = 0; i < num_columns; i++) {
+            if (map_column(mapped, table, i, data_end) != 0) {
+                free_ndb_table(table);
+                table = NULL;
+                break;
+            }
+        }
+    } else {
+        free(mapped->dictionaries);
+        munmap(mapped->base, mapped->size);
+        free(mapped);
+    }
+    if (!table) {
+        fprintf(stderr, "Error: %s is not a valid table file\n", path);
+    }
+    return table;
+}
+
+int get_ndb_file_column_stats(const NDBTableC* table, int column, NDBColumnStats* stats) {
+    if (table->release != release_mapped_file || column < 0 || column >= table->num_columns) {
+        return -1;
+    }
+    const MappedFile* mapped = (const MappedFile*)table->private_data;
+    *stats = mapped->columns[column].stats;
+    return 0;
+}
+
+NDBJoinIndex* map_ndb_join_index(const NDBTableC* table, const int* key_columns, int num_key_columns) {
+    if (table->release != release_mapped_file) {
+        return NULL;
+    }
+    const MappedFile* mapped = (const MappedFile*)table->private_data;
+    for (int x = 0; x < mapped->num_indexes; x++) {
+        const FileIndex* file_index = &mapped->indexes[x];
+        NDBJoinIndexImage image;
+        int ok = 1;
+        for (int a = 0; a < NDB_JOIN_INDEX_ARRAYS && ok; a++) {
+            ok = segment_ok(&file_index->arrays[a], file_index->arrays[a].bytes, mapped->data_end);
+            image.arrays[a] = segment_data(mapped, &file_index->arrays[a]);
+            image.bytes[a] = file_index->arrays[a].bytes;
+        }
+        memcpy(image.scalars, file_index->scalars, sizeof(image.scalars));
+        NDBJoinIndex* index = ok ? load_ndb_join_index_image(table, &image) : NULL;
+        const int* index_columns;
+        if (index && ndb_join_index_key_columns(index, &index_columns) == num_key_columns &&
+            memcmp(index_columns, key_columns, num_key_columns * sizeof(int)) == 0) {
+            return index;
+        }
+        free_ndb_join_index(index);
+    }
+    return NULL;
+}
@@ -0,0 +1,257 @@
+#include "columnar_hashjoin.h"
+#include "columnar_types.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// =================== Columnar gather ===================
+
+static inline int bitmap_get(const uint8_t* bitmap, int64_t idx) {
+    return (bitmap[idx >> 3] >> (idx & 7)) & 1;
+}
+
+static inline void bitmap_set(uint8_t* bitmap, int64_t idx, int valid) {
+    if (valid) {
+        bitmap[idx >> 3] |= (uint8_t)(1 << (idx & 7));
+    } else {
+        bitmap[idx >> 3] &= (uint8_t)~(1 << (idx & 7));
+    }
+}
+
+// Does the gather produce any NULL? (missing row or NULL source value)
+static int gather_has_nulls(const NDBArrayC* src, const int32_t* rows, int64_t count) {
+    for (int64_t i = 0; i < count; i++) {
+        if (rows[i] < 0 || (src->validity && !bitmap_get(src->validity, rows[i]))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Rows ahead of the copy whose source values are prefetched: join output
+// visits the source in hash order, so most values miss the cache
+#define GATHER_PREFETCH_DISTANCE 16
+
+// Fixed-width gather, one copy per value width: float64 and timestamps
+// move as their 64-bit patterns, dates and dictionary codes as int32
+#define DEFINE_GATHER_FIXED(name, value_type)                                      \
+    static void name(const NDBArrayC* src, const int32_t* rows, int64_t count,     \
+                     NDBArrayC* dst, int dst_row, int has_nulls) {                 \
+        const value_type* src_data = (const value_type*)src->values;               \
+        value_type* dst_data = (value_type*)dst->values + dst_row;                 \
+                                                                                   \
+        if (!has_nulls) {                                                          \
+            /* Tight gather loop, no branches */                                   \
+            int64_t i = 0;                                                         \
+            for (; i + GATHER_PREFETCH_DISTANCE < count; i++) {                    \
+                __builtin_prefetch(&src_data[rows[i + GATHER_PREFETCH_DISTANCE]]); \
+                dst_data[i] = src_data[rows[i]];                                   \
+            }                                                                      \
+            for (; i < count; i++) {                                               \
+                dst_data[i] = src_data[rows[i]];                                   \
+            }                                                                      \
+            return;                                                                \
+        }                                                                          \
+                                                                                   \
+        for (int64_t i = 0; i < count; i++) {                                      \
+            int32_t row = rows[i];                                                 \
+            int valid = row >= 0 && (!src->validity || bitmap_get(src->validity, row)); \
+            dst_data[i] = valid ? src_data[row] : 0;                               \
+            bitmap_set(dst->validity, dst_row + i, valid);                         \
+            if (!valid) dst->null_count++;                                         \
+        }                                                                          \
+    }
+
+DEFINE_GATHER_FIXED(gather_fixed32, int32_t)
+DEFINE_GATHER_FIXED(gather_fixed64, int64_t)
+
+// Gather of a string column into a view of it: the rows themselves
+static void gather_view_rows(const NDBArrayC* src, const int32_t* rows, int64_t count,
+                             NDBArrayC* dst, int dst_row, int has_nulls) {
+    int32_t* dst_data = (int32_t*)dst->values + dst_row;
+    if (!has_nulls) {
+        memcpy(dst_data, rows, count * sizeof(int32_t));
+        return;
+    }
+    for (int64_t i = 0; i < count; i++) {
+        int32_t row = rows[i];
+        int valid = row >= 0 && (!src->validity || bitmap_get(src->validity, row));
+        dst_data[i] = valid ? row : 0;
+        bitmap_set(dst->validity, dst_row + i, valid);
+        if (!valid) dst->null_count++;
+    }
+}
+
+static int gather_string(const NDBArrayC* src, const int32_t* rows, int64_t count,
+                         NDBTableC* dst_table, int dst_col, int dst_row, int has_nulls) {
+    NDBStringBuilder builder;
+    if (init_ndb_string_builder(&builder, dst_table, dst_col, dst_row) != 0) {
+        return -1;
+    }
+
+    // Size the character buffer for the whole gather up front
+    int64_t bytes = 0;
+    for (int64_t i = 0; i < count; i++) {
+        int32_t row = rows[i];
+        if (row >= 0) {
+            bytes += src->offsets[row + 1] - src->offsets[row];
+        }
+    }
+    if (reserve_ndb_string_bytes(dst_table, dst_col, builder.tail + bytes) != 0) {
+        return -1;
+    }
+
+    NDBArrayC* dst = &dst_table->columns[dst_col];
+    int64_t i = 0;
+    while (i < count) {
+        int32_t row = rows[i];
+        int valid = row >= 0 && (!src->validity || bitmap_get(src->validity, row));
+        if (!valid) {
+            if (append_ndb_string(&builder, NULL, 0) != 0) {
+                return -1;
+            }
+            bitmap_set(dst->validity, dst_row + i, 0);
+            dst->null_count++;
+            i++;
+            continue;
+        }
+
+        // Extend over consecutive valid source rows and copy them in one go
+        int64_t run = 1;
+        while (i + run < count && rows[i + run] == row + run &&
+               (!src->validity || bitmap_get(src->validity, row + (int32_t)run))) {
+            run++;
+        }
+        if (append_ndb_string_run(&builder, src, row, (int)run) != 0) {
+            return -1;
+        }
+        if (has_nulls) {
+            for (int64_t k = 0; k < run; k++) {
+                bitmap_set(dst->validity, dst_row + i + k, 1);
+            }
+        }
+        i += run;
+    }
+    return 0;
+}
+
+int gather_ndb_column(const NDBTableC* src_table, int src_col,
+                      const int32_t* rows, int64_t count,
+                      NDBTableC* dst_table, int dst_col, int dst_row) {
+    if (src_col < 0 || src_col >= src_table->num_columns ||
+        dst_col < 0 || dst_col >= dst_table->num_columns || dst_row < 0) {
+        return -1;
+    }
+
+    const NDBArrayC* src = &src_table->columns[src_col];
+    NDBArrayC* dst = &dst_table->columns[dst_col];
+    // A string column gathers into a view column on a view of it
+    int to_view = src->type_id == NDB_TYPE_STRING && dst->type_id == NDB_TYPE_STRING_VIEW;
+    if ((src->type_id != dst->type_id && !to_view) || (to_view && !ndb_is_string_view_of(dst->dictionary, src)) ||
+        dst_row + count > INT32_MAX - 1 || reserve_ndb_table_rows(dst_table, (int)(dst_row + count)) != 0) {
+        return -1;
+    }
+    if (ndb_type_decoded(src->type_id)) {
+        if (dst->dictionary && dst->dictionary != src->dictionary) {
+            return -1;
+        }
+        dst->dictionary = src->dictionary;
+    }
+
+    int has_nulls = gather_has_nulls(src, rows, count);
+    if (has_nulls && ensure_ndb_validity(dst_table, dst_col) != 0) {
+        return -1;
+    }
+
+    if (to_view) {
+        gather_view_rows(src, rows, count, dst, dst_row, has_nulls);
+    } else {
+        switch (ndb_type_width(src->type_id)) {
+        case sizeof(int32_t):
+            gather_fixed32(src, rows, count, dst, dst_row, has_nulls);
+            break;
+        case sizeof(int64_t):
+            gather_fixed64(src, rows, count, dst, dst_row, has_nulls);
+            break;
+        default:
+            if (src->type_id != NDB_TYPE_STRING ||
+                gather_string(src, rows, count, dst_table, dst_col, dst_row, has_nulls) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    if (dst_table->num_rows < dst_row + count) {
+        dst_table->num_rows = (int32_t)(dst_row + count);
+    }
+    return 0;
+}
+
+int materialize_ndb_row_pairs(
+    const NDBRowPairs* pairs, int64_t start, int64_t count,
+    const NDBTableC* left_table, const NDBTableC* right_table,
+    NDBTableC* result_table, int* result_row_count
+) {
+    int dst_row = *result_row_count;
+    if (count == 0) {
+        return 0;
+    }
+    int right_columns = right_table ? right_table->num_columns : 0;
+    if (left_table->num_columns + right_columns > result_table->num_columns) {
+        return -1;
+    }
+
+    // Grow every output column once for the whole chunk
+    if (dst_row + count > INT32_MAX - 1 ||
+        reserve_ndb_table_rows(result_table, (int)(dst_row + count)) != 0) {
+        return -1;
+    }
+
+    // One pass per output column: left columns first, then right columns
+    for (int col = 0; col < left_table->num_columns; col++) {
+        if (gather_ndb_column(left_table, col, pairs->left_rows + start, count,
+                              result_table, col, dst_row) != 0) {
+            return -1;
+        }
+    }
+    for (int col = 0; col < right_columns; col++) {
+        if (gather_ndb_column(right_table, col, pairs->right_rows + start, count,
+                              result_table, left_table->num_columns + col, dst_row) != 0) {
+            return -1;
+        }
+    }
+
+    *result_row_count = dst_row + (int)count;
+    return 0;
+}
+
+int materialize_ndb_projection(
+    const NDBRowPairs* pairs, int64_t start, int64_t count,
+    const NDBTableC* left_table, const NDBTableC* right_table,
+    const NDBOutputColumn* columns, int num_columns,
+    NDBTableC* result_table, int* result_row_count
+) {
+    int dst_row = *result_row_count;
+    if (count == 0) {
+        return 0;
+    }
+    if (num_columns > result_table->num_columns || dst_row + count > INT32_MAX - 1 ||
+        reserve_ndb_table_rows(result_table, (int)(dst_row + count)) != 0) {
+        return -1;
+    }
+
+    // Only the projected columns are read, each in one pass
+    for (int col = 0; col < num_columns; col++) {
+        const NDBTableC* src_table = columns[col].is_left ? left_table : right_table;
+        const int32_t* rows = columns[col].is_left ? pairs->left_rows : pairs->right_rows;
+        if (!src_table || gather_ndb_column(src_table, columns[col].column, rows + start, count,
+                                            result_table, col, dst_row) != 0) {
+            return -1;
+        }
+    }
+
+    *result_row_count = dst_row + (int)count;
+    return 0;
+}
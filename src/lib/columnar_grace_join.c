@@ -0,0 +1,543 @@
+#include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+#include "columnar_keys.h"
+#include "memory.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// Build footprint per row: buckets at 75% load + group offsets + row ids,
+// plus the partition's keys and row ids read back from disk
+#define GRACE_BUILD_BYTES_PER_ROW 32
+// Partition sizes aimed at when the join was called without a limit
+#define GRACE_DEFAULT_LIMIT (64L << 20)
+// Partitions per pass: one open file and one write buffer each
+#define GRACE_MAX_FANOUT 128
+// Passes partition on the top hash bits; the buckets index with the low ones
+#define GRACE_MAX_HASH_BITS 32
+// Probe entries read and joined at a time
+#define GRACE_CHUNK_ENTRIES 16384
+#define GRACE_PROBE_BATCH 64
+// Write buffer per partition, in entries: large writes keep the disk streaming
+#define GRACE_MIN_BUFFER_ENTRIES 512
+#define GRACE_MAX_BUFFER_ENTRIES (1 << 17)
+
+int64_t estimate_ndb_build_bytes(int64_t build_rows) {
+    return build_rows * GRACE_BUILD_BYTES_PER_ROW;
+}
+
+// One row of a partition
+typedef struct {
+    int32_t key;
+    int32_t row;                // Row of the input table
+} SpillEntry;
+
+// Append-only temporary file of entries, removed from the directory as
+// soon as it is created so it disappears with the process
+typedef struct {
+    int fd;
+    int64_t count;              // Entries written to the file
+    SpillEntry* buffer;         // Entries not written yet
+    int buffered;
+    int capacity;
+} SpillFile;
+
+typedef struct {
+    const NDBTableC* left_table;
+    const NDBTableC* right_table;
+    JoinType join_type;
+    NDBTableC* result_table;
+    int* result_row_count;
+    ProcessNDBMatchFunc match_processor;
+    ProcessNDBUnmatchedFunc unmatch_processor;
+    int columnar;               // Output gathered by materialize_ndb_row_pairs
+    NDBHashFunction hash_function;
+    int64_t memory_limit;
+    const char* directory;
+} GraceJoin;
+
+// =================== Spill files ===================
+
+static int open_spill_file(GraceJoin* join, SpillFile* file, int capacity) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/ndb_spill_XXXXXX", join->directory);
+    file->fd = mkstemp(path);
+    file->count = 0;
+    file->buffered = 0;
+    file->capacity = capacity;
+    file->buffer = NULL;
+    if (file->fd < 0) {
+        fprintf(stderr, "Error: cannot create a spill file in %s: %s\n", join->directory, strerror(errno));
+        return -1;
+    }
+    unlink(path);
+    file->buffer = (SpillEntry*)malloc((size_t)capacity * sizeof(SpillEntry));
+    return file->buffer ? 0 : -1;
+}
+
+static void close_spill_file(SpillFile* file) {
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    free(file->buffer);
+    file->fd = -1;
+    file->buffer = NULL;
+}
+
+static int flush_spill_file(SpillFile* file) {
+    const char* data = (const char*)file->buffer;
+    size_t left = (size_t)file->buffered * sizeof(SpillEntry);
+    while (left > 0) {
+        ssize_t written = write(file->fd, data, left);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            fprintf(stderr, "Error: failed to write spill file: %s\n", strerror(errno));
+            return -1;
+        }
+        data += written;
+        left -= (size_t)written;
+    }
+    file->count += file->buffered;
+    file->buffered = 0;
+    return 0;
+}
+
+static inline int spill_entry(SpillFile* file, int32_t key, int32_t row) {
+    file->buffer[file->buffered].key = key;
+    file->buffer[file->buffered].row = row;
+    return ++file->buffered == file->capacity ? flush_spill_file(file) : 0;
+}
+
+// Read entries [first, first + count) of a flushed file
+static int read_spill_entries(const SpillFile* file, int64_t first, int64_t count, SpillEntry* entries) {
+    char* data = (char*)entries;
+    size_t left = (size_t)count * sizeof(SpillEntry);
+    off_t offset = (off_t)first * (off_t)sizeof(SpillEntry);
+    while (left > 0) {
+        ssize_t got = pread(file->fd, data, left, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            fprintf(stderr, "Error: failed to read spill file: %s\n", got < 0 ? strerror(errno) : "truncated");
+            return -1;
+        }
+        data += got;
+        left -= (size_t)got;
+        offset += got;
+    }
+    return 0;
+}
+
+// =================== Partitioning ===================
+
+// Partitions of a pass for a build of build_rows rows: enough for each to
+// fit the limit with room to spare for skew
+static int choose_fanout(const GraceJoin* join, int64_t build_rows, int* bits) {
+    int64_t wanted = 2 * estimate_ndb_build_bytes(build_rows) / join->memory_limit + 1;
+    *bits = 1;
+    while ((1 << *bits) < wanted && (1 << *bits) < GRACE_MAX_FANOUT) {
+        (*bits)++;
+    }
+    return 1 << *bits;
+}
+
+static SpillFile* open_partitions(GraceJoin* join, int fanout) {
+    // All write buffers of a pass together take a quarter of the limit
+    int64_t capacity = join->memory_limit / 4 / fanout / (int64_t)sizeof(SpillEntry);
+    if (capacity < GRACE_MIN_BUFFER_ENTRIES) capacity = GRACE_MIN_BUFFER_ENTRIES;
+    if (capacity > GRACE_MAX_BUFFER_ENTRIES) capacity = GRACE_MAX_BUFFER_ENTRIES;
+
+    SpillFile* parts = (SpillFile*)malloc((size_t)fanout * sizeof(SpillFile));
+    if (!parts) {
+        return NULL;
+    }
+    for (int p = 0; p < fanout; p++) {
+        parts[p].fd = -1;
+        parts[p].buffer = NULL;
+    }
+    for (int p = 0; p < fanout; p++) {
+        if (open_spill_file(join, &parts[p], (int)capacity) != 0) {
+            for (int q = 0; q <= p; q++) {
+                close_spill_file(&parts[q]);
+            }
+            free(parts);
+            return NULL;
+        }
+    }
+    return parts;
+}
+
+static void close_partitions(SpillFile* parts, int fanout) {
+    for (int p = 0; parts && p < fanout; p++) {
+        close_spill_file(&parts[p]);
+    }
+    free(parts);
+}
+
+static int flush_partitions(SpillFile* parts, int fanout) {
+    for (int p = 0; p < fanout; p++) {
+        if (flush_spill_file(&parts[p]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Spill the non-NULL keys of rows [0, num_rows) by the hash bits above shift
+static int partition_keys(const GraceJoin* join, const int32_t* keys, const uint64_t* nulls, int num_rows,
+                          SpillFile* parts, int fanout, int shift) {
+    uint64_t hashes[GRACE_PROBE_BATCH];
+    for (int base = 0; base < num_rows; base += GRACE_PROBE_BATCH) {
+        int count = num_rows - base < GRACE_PROBE_BATCH ? num_rows - base : GRACE_PROBE_BATCH;
+        uint64_t null_word = nulls ? nulls[base >> 6] : 0;
+        ndb_hash_keys(join->hash_function, keys + base, hashes, count);
+        for (int i = 0; i < count; i++) {
+            if ((null_word >> i) & 1) {
+                continue;
+            }
+            int p = (int)(hashes[i] >> shift) & (fanout - 1);
+            if (spill_entry(&parts[p], keys[base + i], base + i) != 0) {
+                return -1;
+            }
+        }
+    }
+    return flush_partitions(parts, fanout);
+}
+
+// Spill the entries of a partition file on the next hash bits
+static int partition_spill_file(const GraceJoin* join, const SpillFile* source, SpillFile* parts, int fanout,
+                                int shift, SpillEntry* chunk, int32_t* keys, uint64_t* hashes) {
+    for (int64_t first = 0; first < source->count; first += GRACE_CHUNK_ENTRIES) {
+        int count = (int)(source->count - first < GRACE_CHUNK_ENTRIES ? source->count - first : GRACE_CHUNK_ENTRIES);
+        if (read_spill_entries(source, first, count, chunk) != 0) {
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            keys[i] = chunk[i].key;
+        }
+        ndb_hash_keys(join->hash_function, keys, hashes, count);
+        for (int i = 0; i < count; i++) {
+            int p = (int)(hashes[i] >> shift) & (fanout - 1);
+            if (spill_entry(&parts[p], chunk[i].key, chunk[i].row) != 0) {
+                return -1;
+            }
+        }
+    }
+    return flush_partitions(parts, fanout);
+}
+
+// =================== Partition join ===================
+
+static int emit_pairs(GraceJoin* join, const NDBRowPairs* pairs) {
+    if (join->columnar) {
+        int semi = ndb_join_is_semi(join->join_type);
+        if (materialize_ndb_row_pairs(pairs, 0, pairs->count, join->left_table,
+                                      semi ? NULL : join->right_table,
+                                      join->result_table, join->result_row_count) != 0) {
+            fprintf(stderr, "Error: failed to materialize join output\n");
+            return -1;
+        }
+        return 0;
+    }
+    emit_ndb_row_pairs(pairs, 0, pairs->count, join->left_table, join->right_table,
+                       join->result_table, join->result_row_count,
+                       join->match_processor, join->unmatch_processor);
+    return 0;
+}
+
+// Probe one chunk of probe entries; pairs get the input rows of both sides
+static int probe_chunk(GraceJoin* join, const HashTable* table, const int32_t* build_rows,
+                       const SpillEntry* chunk, int count, int32_t* keys, uint64_t* hashes,
+                       uint64_t* matched, NDBRowPairs* pairs) {
+    for (int i = 0; i < count; i++) {
+        keys[i] = chunk[i].key;
+    }
+    ndb_hash_keys(join->hash_function, keys, hashes, count);
+    pairs->count = 0;
+
+    if (ndb_join_is_semi(join->join_type)) {
+        if (reserve_ndb_row_pairs(pairs, count) != 0) {
+            return -1;
+        }
+        pairs->count = probe_hash_key_set(table, keys, hashes, count, 0,
+                                          join->join_type == LEFT_ANTI_JOIN, pairs->left_rows);
+    } else {
+        int emit_unmatched = ndb_join_keeps_left(join->join_type);
+        HashProbeCursor cursor;
+        init_hash_probe_cursor(&cursor);
+        while (cursor.key_idx < count) {
+            if (reserve_ndb_row_pairs(pairs, GRACE_PROBE_BATCH) != 0) {
+                return -1;
+            }
+            int64_t first = pairs->count;
+            pairs->count += probe_hash_batch(table, keys, hashes, count, 0, emit_unmatched, &cursor,
+                                             pairs->left_rows + first, pairs->right_rows + first,
+                                             (int)(pairs->capacity - first));
+            if (matched) {
+                mark_ndb_matched_rows(matched, pairs->right_rows + first, pairs->count - first);
+            }
+        }
+    }
+
+    // Positions in the chunk and the build partition back to input rows
+    for (int64_t k = 0; k < pairs->count; k++) {
+        pairs->left_rows[k] = chunk[pairs->left_rows[k]].row;
+        pairs->right_rows[k] = ndb_join_is_semi(join->join_type) || pairs->right_rows[k] < 0 ? -1 :
+                               build_rows[pairs->right_rows[k]];
+    }
+    return emit_pairs(join, pairs);
+}
+
+// Emit every entry of a file as unmatched, without building anything
+static int emit_unmatched_entries(GraceJoin* join, const SpillFile* file, int is_left, SpillEntry* chunk) {
+    NDBRowPairs pairs;
+    init_ndb_row_pairs(&pairs);
+    int status = reserve_ndb_row_pairs(&pairs, GRACE_CHUNK_ENTRIES);
+    for (int64_t first = 0; status == 0 && first < file->count; first += GRACE_CHUNK_ENTRIES) {
+        int count = (int)(file->count - first < GRACE_CHUNK_ENTRIES ? file->count - first : GRACE_CHUNK_ENTRIES);
+        status = read_spill_entries(file, first, count, chunk);
+        for (int i = 0; status == 0 && i < count; i++) {
+            pairs.left_rows[i] = is_left ? chunk[i].row : -1;
+            pairs.right_rows[i] = is_left ? -1 : chunk[i].row;
+        }
+        pairs.count = count;
+        if (status == 0) {
+            status = emit_pairs(join, &pairs);
+        }
+    }
+    free_ndb_row_pairs(&pairs);
+    return status;
+}
+
+// Build one partition in memory and stream its probe entries through it
+static int join_partition(GraceJoin* join, const SpillFile* build, const SpillFile* probe,
+                          SpillEntry* chunk, int32_t* keys, uint64_t* hashes) {
+    // With one side empty nothing matches: only its unmatched rows are output
+    if (build->count == 0) {
+        int keep = ndb_join_keeps_left(join->join_type) || join->join_type == LEFT_ANTI_JOIN;
+        return keep ? emit_unmatched_entries(join, probe, 1, chunk) : 0;
+    }
+    if (probe->count == 0) {
+        return ndb_join_keeps_right(join->join_type) ? emit_unmatched_entries(join, build, 0, chunk) : 0;
+    }
+    int build_count = (int)build->count;
+    SpillEntry* entries = (SpillEntry*)malloc((build_count > 0 ? build_count : 1) * sizeof(SpillEntry));
+    int32_t* build_keys = (int32_t*)malloc((build_count > 0 ? build_count : 1) * sizeof(int32_t));
+    int32_t* build_rows = (int32_t*)malloc((build_count > 0 ? build_count : 1) * sizeof(int32_t));
+    uint64_t* matched = ndb_join_keeps_right(join->join_type) ?
+                        (uint64_t*)calloc(((size_t)build_count + 63) / 64 + 1, sizeof(uint64_t)) : NULL;
+    HashTable table;
+    int status = entries && build_keys && build_rows && (matched || !ndb_join_keeps_right(join->join_type)) &&
+                 init_hash_table(&table, build_count, join->hash_function) == 0 ? 0 : -1;
+    if (status != 0) {
+        free(entries);
+        free(build_keys);
+        free(build_rows);
+        free(matched);
+        fprintf(stderr, "Error: failed to allocate a partition of %d build rows\n", build_count);
+        return -1;
+    }
+
+    if (read_spill_entries(build, 0, build_count, entries) != 0) {
+        status = -1;
+    } else {
+        for (int i = 0; i < build_count; i++) {
+            build_keys[i] = entries[i].key;
+            build_rows[i] = entries[i].row;
+        }
+        status = ndb_join_is_semi(join->join_type) ?
+                 build_hash_key_set(&table, build_keys, NULL, build_count) :
+                 build_hash_table(&table, build_keys, NULL, NULL, build_count);
+        if (status != 0) {
+            fprintf(stderr, "Error: failed to build hash table for %d rows\n", build_count);
+        }
+    }
+    free(entries);
+    free(build_keys);
+
+    NDBRowPairs pairs;
+    init_ndb_row_pairs(&pairs);
+    for (int64_t first = 0; status == 0 && first < probe->count; first += GRACE_CHUNK_ENTRIES) {
+        int count = (int)(probe->count - first < GRACE_CHUNK_ENTRIES ? probe->count - first : GRACE_CHUNK_ENTRIES);
+        status = read_spill_entries(probe, first, count, chunk);
+        if (status == 0) {
+            status = probe_chunk(join, &table, build_rows, chunk, count, keys, hashes, matched, &pairs);
+        }
+    }
+
+    // Build rows of this partition that no probe row matched
+    if (status == 0 && matched) {
+        pairs.count = 0;
+        status = append_unmatched_ndb_rows(&pairs, matched, build_count, build_rows);
+        if (status == 0) {
+            status = emit_pairs(join, &pairs);
+        }
+    }
+    free_ndb_row_pairs(&pairs);
+    free_hash_table(&table);
+    free(build_rows);
+    free(matched);
+    return status;
+}
+
+// Join a pair of partition files, splitting them again on the next hash
+// bits while the build is over the limit and bits are left
+static int join_partitions(GraceJoin* join, const SpillFile* build, const SpillFile* probe, int used_bits,
+                           SpillEntry* chunk, int32_t* keys, uint64_t* hashes) {
+    int bits;
+    int fanout = choose_fanout(join, build->count, &bits);
+    if (estimate_ndb_build_bytes(build->count) <= join->memory_limit || used_bits + bits > GRACE_MAX_HASH_BITS ||
+        build->count == 0 || probe->count == 0) {
+        return join_partition(join, build, probe, chunk, keys, hashes);
+    }
+
+    int shift = 64 - used_bits - bits;
+    SpillFile* build_parts = open_partitions(join, fanout);
+    SpillFile* probe_parts = build_parts ? open_partitions(join, fanout) : NULL;
+    int status = probe_parts &&
+                 partition_spill_file(join, build, build_parts, fanout, shift, chunk, keys, hashes) == 0 &&
+                 partition_spill_file(join, probe, probe_parts, fanout, shift, chunk, keys, hashes) == 0 ? 0 : -1;
+
+    // The parents' space is not given back until they are closed; their
+    // entries now live in the children
+    for (int p = 0; status == 0 && p < fanout; p++) {
+        free(build_parts[p].buffer);
+        free(probe_parts[p].buffer);
+        build_parts[p].buffer = NULL;
+        probe_parts[p].buffer = NULL;
+    }
+    for (int p = 0; status == 0 && p < fanout; p++) {
+        // Rows that did not split are copies of a few keys: further bits
+        // will not split them either
+        status = build_parts[p].count == build->count ?
+                 join_partition(join, &build_parts[p], &probe_parts[p], chunk, keys, hashes) :
+                 join_partitions(join, &build_parts[p], &probe_parts[p], used_bits + bits, chunk, keys, hashes);
+    }
+    close_partitions(build_parts, fanout);
+    close_partitions(probe_parts, fanout);
+    return status;
+}
+
+static void grace_join_on_keys(GraceJoin* join, const int32_t* left_keys, const int32_t* right_keys,
+                               const uint64_t* left_nulls, const uint64_t* right_nulls) {
+    const NDBTableC* left_table = join->left_table;
+    const NDBTableC* right_table = join->right_table;
+    int bits;
+    int fanout = choose_fanout(join, right_table->num_rows, &bits);
+    int shift = 64 - bits;
+
+    SpillEntry* chunk = (SpillEntry*)malloc(GRACE_CHUNK_ENTRIES * sizeof(SpillEntry));
+    int32_t* keys = (int32_t*)malloc(GRACE_CHUNK_ENTRIES * sizeof(int32_t));
+    uint64_t* hashes = (uint64_t*)malloc(GRACE_CHUNK_ENTRIES * sizeof(uint64_t));
+    SpillFile* build_parts = chunk && keys && hashes ? open_partitions(join, fanout) : NULL;
+    SpillFile* probe_parts = build_parts ? open_partitions(join, fanout) : NULL;
+    int status = probe_parts &&
+                 partition_keys(join, right_keys, right_nulls, right_table->num_rows, build_parts, fanout, shift) == 0 &&
+                 partition_keys(join, left_keys, left_nulls, left_table->num_rows, probe_parts, fanout, shift) == 0
+                 ? 0 : -1;
+    for (int p = 0; status == 0 && p < fanout; p++) {
+        free(build_parts[p].buffer);
+        free(probe_parts[p].buffer);
+        build_parts[p].buffer = NULL;
+        probe_parts[p].buffer = NULL;
+    }
+    for (int p = 0; status == 0 && p < fanout; p++) {
+        status = join_partitions(join, &build_parts[p], &probe_parts[p], bits, chunk, keys, hashes);
+    }
+    close_partitions(build_parts, fanout);
+    close_partitions(probe_parts, fanout);
+
+    // NULL-key rows never match: the sides that keep unmatched rows get
+    // them after all partitions
+    NDBRowPairs null_keys;
+    init_ndb_row_pairs(&null_keys);
+    if (status == 0 &&
+        ((left_nulls && (ndb_join_keeps_left(join->join_type) || join->join_type == LEFT_ANTI_JOIN) &&
+          append_null_key_ndb_rows(&null_keys, left_nulls, left_table->num_rows, 1) != 0) ||
+         (right_nulls && ndb_join_keeps_right(join->join_type) &&
+          append_null_key_ndb_rows(&null_keys, right_nulls, right_table->num_rows, 0) != 0))) {
+        status = -1;
+    }
+    if (status == 0) {
+        status = emit_pairs(join, &null_keys);
+    } else {
+        fprintf(stderr, "Error: grace hash join failed\n");
+    }
+    free_ndb_row_pairs(&null_keys);
+    free(chunk);
+    free(keys);
+    free(hashes);
+}
+
+void grace_ndb_hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+) {
+    NDBJoinOptions defaults;
+    if (!options) {
+        init_ndb_join_options(&defaults);
+        options = &defaults;
+    }
+    *result_row_count = 0;
+
+    const char* directory = options->spill_directory ? options->spill_directory : getenv("TMPDIR");
+    GraceJoin join = {
+        .left_table = left_table,
+        .right_table = right_table,
+        .join_type = join_type,
+        .result_table = result_table,
+        .result_row_count = result_row_count,
+        .match_processor = match_processor,
+        .unmatch_processor = unmatch_processor,
+        .columnar = ndb_join_output_is_columnar(left_table, result_table, join_type,
+                                                match_processor, unmatch_processor),
+        .hash_function = options->hash_function,
+        .memory_limit = options->memory_limit > 0 ? options->memory_limit : GRACE_DEFAULT_LIMIT,
+        .directory = directory && directory[0] ? directory : "/tmp",
+    };
+
+    if (!valid_ndb_join_key_columns(left_table, left_key_columns, right_table, right_key_columns,
+                                    num_key_columns)) {
+        return;
+    }
+
+    uint64_t* left_nulls = NULL;
+    uint64_t* right_nulls = NULL;
+    if (find_ndb_null_keys(left_table, left_key_columns, num_key_columns, &left_nulls) != 0 ||
+        find_ndb_null_keys(right_table, right_key_columns, num_key_columns, &right_nulls) != 0) {
+        fprintf(stderr, "Error: failed to allocate NULL key bitmaps\n");
+        free(left_nulls);
+        return;
+    }
+
+    if (ndb_join_keys_need_codes(left_table, left_key_columns, right_table, right_key_columns,
+                                 num_key_columns)) {
+        NDBKeyCodes codes;
+        if (encode_ndb_join_keys(left_table, left_key_columns, right_table, right_key_columns,
+                                 num_key_columns, &codes) == 0) {
+            grace_join_on_keys(&join, codes.left, codes.right, left_nulls, right_nulls);
+            free_ndb_key_codes(&codes);
+        }
+    } else {
+        grace_join_on_keys(&join, (const int32_t*)left_table->columns[left_key_columns[0]].values,
+                           (const int32_t*)right_table->columns[right_key_columns[0]].values,
+                           left_nulls, right_nulls);
+    }
+    free(left_nulls);
+    free(right_nulls);
+}
@@ -0,0 +1,43 @@
+#include "columnar_hash.h"
+#include "columnar_simd.h"
+#include "xxhash.h"
+
+// =================== Key hashing ===================
+
+static void xxh3_keys(const int32_t* keys, uint64_t* hashes, int count) {
+    for (int i = 0; i < count; i++) {
+        hashes[i] = XXH3_64bits(&keys[i], sizeof(int32_t));
+    }
+}
+
+void ndb_hash_keys(NDBHashFunction function, const int32_t* keys, uint64_t* hashes, int count) {
+    switch (function) {
+    case NDB_HASH_CRC32C:
+        simd_crc32c_keys(keys, hashes, count);
+        break;
+    case NDB_HASH_XXH3:
+        xxh3_keys(keys, hashes, count);
+        break;
+    default:
+        simd_multiply_shift_keys(keys, hashes, count);
+        break;
+    }
+}
+
+uint64_t ndb_hash_key(NDBHashFunction function, int32_t key) {
+    if (function == NDB_HASH_MULTIPLY_SHIFT) {
+        return multiply_shift_hash32(key);
+    }
+    uint64_t hash;
+    ndb_hash_keys(function, &key, &hash, 1);
+    return hash;
+}
+
+const char* ndb_hash_function_name(NDBHashFunction function) {
+    switch (function) {
+    case NDB_HASH_MULTIPLY_SHIFT: return "multiply-shift";
+    case NDB_HASH_CRC32C: return "crc32c";
+    case NDB_HASH_XXH3: return "xxh3";
+    }
+    return "unknown";
+}
@@ -1,105 +1,16 @@
 #include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+#include "columnar_keys.h"
+#include "columnar_types.h"
+#include "columnar_arena.h"
+#include "columnar_threadpool.h"
 #include "memory.h"
-#include "xxhash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
-
-#define TABLE_SIZE 1024
-
-// Hash table entry - using open addressing
-typedef struct Entry {
-    int row_index;              // Row index
-    int key;                    // Key value
-    int is_occupied;            // Whether the slot is occupied
-    int is_deleted;             // Whether the slot is deleted (for deletion operations)
-} Entry;
-
-// Hash table structure
-typedef struct {
-    Entry buckets[TABLE_SIZE];  // Store entry array directly, without using pointers
-    int count;                  // Current number of stored elements
-} HashTable;
-
-unsigned int hash_key(int key) {
-    return (unsigned int)(XXH3_64bits(&key, sizeof(int)) % TABLE_SIZE);
-}
-
-// Linear probing to find the next position
-int linear_probe(HashTable *table, int key, int start_idx) {
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        int idx = (start_idx + i) % TABLE_SIZE;
-        if (!table->buckets[idx].is_occupied || 
-            (table->buckets[idx].is_occupied && table->buckets[idx].key == key)) {
-            return idx;
-        }
-    }
-    return -1; // Table is full
-}
-
-// Insert row index into hash table
-void insert_hash(HashTable *table, int key, int row_index) {
-    if (table->count >= TABLE_SIZE * 0.7) {
-        printf("Warning: Hash table is getting full\n");
-        return;
-    }
-    
-    unsigned int start_idx = hash_key(key);
-    int idx = linear_probe(table, key, start_idx);
-    
-    if (idx != -1) {
-        table->buckets[idx].key = key;
-        table->buckets[idx].row_index = row_index;
-        table->buckets[idx].is_occupied = 1;
-        table->buckets[idx].is_deleted = 0;
-        table->count++;
-    }
-}
-
-// Search hash table - return matching entry index, -1 means not found
-int lookup_hash(HashTable *table, int key) {
-    unsigned int start_idx = hash_key(key);
-    
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        int idx = (start_idx + i) % TABLE_SIZE;
-        
-        if (!table->buckets[idx].is_occupied && !table->buckets[idx].is_deleted) {
-            return -1;
-        }
-        
-        if (table->buckets[idx].is_occupied && 
-            !table->buckets[idx].is_deleted && 
-            table->buckets[idx].key == key) {
-            return idx;
-        }
-    }
-    
-    return -1;
-}
-
-// Initialize hash table
-void init_hash_table(HashTable *table) {
-    table->count = 0;
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        table->buckets[i].is_occupied = 0;
-        table->buckets[i].is_deleted = 0;
-        table->buckets[i].key = 0;
-        table->buckets[i].row_index = 0;
-    }
-}
-
-// Free hash table memory (clear all entries)
-void free_hash_table(HashTable *table) {
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        table->buckets[i].is_occupied = 0;
-        table->buckets[i].is_deleted = 0;
-        table->buckets[i].key = 0;
-        table->buckets[i].row_index = 0;
-    }
-    table->count = 0;
-}
+#include <stdatomic.h>
 
 int is_ndb_value_null(const NDBTableC* table, int column_idx, int row_idx) {
     if (column_idx < 0 || column_idx >= table->num_columns || 
@@ -118,21 +29,29 @@ int is_ndb_value_null(const NDBTableC* table, int column_idx, int row_idx) {
 }
 
 void set_ndb_value_null(NDBTableC* table, int column_idx, int row_idx) {
-    if (column_idx < 0 || column_idx >= table->num_columns || 
-        row_idx < 0 || row_idx >= table->num_rows) {
+    if (column_idx < 0 || column_idx >= table->num_columns || row_idx < 0) {
         return;
     }
     
+    // Any reserved row can be marked, also one not yet counted in num_rows
     NDBArrayC* array = &table->columns[column_idx];
+    if (row_idx >= array->length) {
+        return;
+    }
     
-    // Ensure there is a validity bitmap
+    // Ensure there is a validity bitmap covering the column's capacity
     if (!array->validity) {
-        int bitmap_size = (table->num_rows + 7) / 8;
-        array->validity = (uint8_t*)malloc(bitmap_size);
-        memset(array->validity, 0xFF, bitmap_size); // Set all to valid
+        if (ensure_ndb_validity(table, column_idx) != 0) {
+            return;
+        }
         array->null_count = 0;
     }
     
+    // A NULL string is empty: the next row appends where this one starts
+    if (array->type_id == NDB_TYPE_STRING) {
+        array->offsets[row_idx + 1] = array->offsets[row_idx];
+    }
+    
     int byte_idx = row_idx / 8;
     int bit_idx = row_idx % 8;
     
@@ -144,14 +63,6 @@ void set_ndb_value_null(NDBTableC* table, int column_idx, int row_idx) {
     // Set to NULL
     array->validity[byte_idx] &= ~(1 << bit_idx);
     array->null_count++;
-    
-    // For string types, need special handling of offsets
-    if (array->type_id == 1) {
-        // Ensure NULL string offset points to the same position (length 0)
-        if (row_idx < array->length - 1) {
-            array->offsets[row_idx + 1] = array->offsets[row_idx];
-        }
-    }
 }
 
 // Get integer key value from NDB column
@@ -161,12 +72,13 @@ int get_int_key_from_ndb_column(const NDBTableC* table, int column_idx, int row_
     }
     
     NDBArrayC* array = &table->columns[column_idx];
-    if (array->type_id == 0) { // int32
+    const NDBTypeInfo* info = ndb_type_info(array->type_id);
+    if (info && info->int32_key) { // int32, date32, dictionary code
         int32_t* data = (int32_t*)array->values;
         return data[row_idx];
     }
     
-    return 0; // Non-integer types return 0
+    return 0; // Other types join through key codes
 }
 
 // Get NDB column data
@@ -177,10 +89,13 @@ void* get_ndb_column_data(const NDBTableC* table, int column_idx, int row_idx) {
     }
     
     NDBArrayC* array = &table->columns[column_idx];
-    if (array->type_id == 0) { // int32
-        int32_t* data = (int32_t*)array->values;
-        return &data[row_idx];
-    } else if (array->type_id == 1) { // string
+    const NDBTypeInfo* info = ndb_type_info(array->type_id);
+    if (!info) {
+        return NULL;
+    }
+    if (info->key_type != NDB_TYPE_STRING) { // fixed width
+        return (char*)array->values + (size_t)row_idx * info->width;
+    } else { // string, dictionary codes decoded
         // For strings, need to return pointer to string data
         static char* str_ptr;
         static int str_len;
@@ -198,11 +113,15 @@ void add_ndb_column_data(NDBTableC* table, int column_idx, void* data, int row_i
         return;
     }
     
+    if (reserve_ndb_table_rows(table, row_idx + 1) != 0) {
+        return;
+    }
+    
     NDBArrayC* array = &table->columns[column_idx];
-    if (array->type_id == 0) { // int32
-        int32_t* column_data = (int32_t*)array->values;
-        column_data[row_idx] = *(int32_t*)data;
-    } else if (array->type_id == 1) { // string
+    int width = ndb_type_width(array->type_id);
+    if (width > 0) { // fixed width, a dictionary column takes its code
+        memcpy((char*)array->values + (size_t)row_idx * width, data, width);
+    } else if (array->type_id == NDB_TYPE_STRING) {
         // For strings, need special handling
         char* str = (char*)data;
         int len = strlen(str);
@@ -225,7 +144,12 @@ void get_ndb_string_value(const NDBTableC* table, int column_idx, int row_idx,
     }
     
     NDBArrayC* array = &table->columns[column_idx];
-    if (array->type_id != 1) { // Not string type
+    if (ndb_type_decoded(array->type_id) && array->dictionary) {
+        // Decode: the code (or view row) is the dictionary row
+        get_ndb_string_value(array->dictionary, 0, ((int32_t*)array->values)[row_idx], str_ptr, str_len);
+        return;
+    }
+    if (array->type_id != NDB_TYPE_STRING) { // Not string type
         *str_ptr = NULL;
         *str_len = 0;
         return;
@@ -245,25 +169,18 @@ void set_ndb_string_value(NDBTableC* table, int column_idx, int row_idx,
         return;
     }
     
-    NDBArrayC* array = &table->columns[column_idx];
-    if (array->type_id != 1) { // Not string type
-        return;
+    // Appends after the previous row's characters, growing the buffer
+    NDBStringBuilder builder;
+    if (init_ndb_string_builder(&builder, table, column_idx, row_idx) == 0) {
+        append_ndb_string(&builder, str, str_len);
     }
-    
-    // Simplified implementation: assume values buffer is large enough
-    // In actual implementation, dynamic expansion is needed
-    char* values_buf = (char*)array->values;
-    int current_offset = array->offsets[row_idx];
-    
-    // Copy string data
-    memcpy(values_buf + current_offset, str, str_len);
-    
-    // Update offsets
-    array->offsets[row_idx + 1] = current_offset + str_len;
 }
 
 void copy_ndb_value(const NDBTableC* src_table, int src_col, int src_row,
                       NDBTableC* dst_table, int dst_col, int dst_row) {
+    if (reserve_ndb_table_rows(dst_table, dst_row + 1) != 0) {
+        return;
+    }
     if (is_ndb_value_null(src_table, src_col, src_row)) {
         set_ndb_value_null(dst_table, dst_col, dst_row);
         return;
@@ -275,54 +192,91 @@ void copy_ndb_value(const NDBTableC* src_table, int src_col, int src_row,
     if (src_array->type_id != dst_array->type_id) {
         return; // Type mismatch
     }
+    // Codes and view rows only mean the same strings on the same dictionary
+    if (ndb_type_decoded(src_array->type_id)) {
+        if (!dst_array->dictionary) {
+            dst_array->dictionary = src_array->dictionary;
+        } else if (dst_array->dictionary != src_array->dictionary) {
+            return;
+        }
+    }
     
-    if (src_array->type_id == 0) { // int32
-        int32_t* src_data = (int32_t*)src_array->values;
-        int32_t* dst_data = (int32_t*)dst_array->values;
-        dst_data[dst_row] = src_data[src_row];
-    } else if (src_array->type_id == 1) { // string
+    int width = ndb_type_width(src_array->type_id);
+    if (width > 0) { // fixed width
+        memcpy((char*)dst_array->values + (size_t)dst_row * width,
+               (const char*)src_array->values + (size_t)src_row * width, width);
+    } else if (src_array->type_id == NDB_TYPE_STRING) {
         // Get source string
         char* str_ptr;
         int str_len;
         get_ndb_string_value(src_table, src_col, src_row, &str_ptr, &str_len);
         
-        if (str_ptr && str_len > 0) {
-            // Improved string copy logic
-            char* dst_values = (char*)dst_array->values;
-            int32_t* dst_offsets = dst_array->offsets;
-            
-            // Calculate where the current string should be stored
-            int32_t current_offset = 0;
-            
-            // Traverse previous rows to accumulate offset
-            for (int i = 0; i < dst_row; i++) {
-                int32_t row_len = dst_offsets[i + 1] - dst_offsets[i];
-                current_offset += row_len;
-            }
-            
-            // Copy string data
-            memcpy(dst_values + current_offset, str_ptr, str_len);
-            
-            // Update offsets
-            dst_offsets[dst_row] = current_offset;
-            dst_offsets[dst_row + 1] = current_offset + str_len;
-        } else {
-            // Handle empty string
-            int32_t* dst_offsets = dst_array->offsets;
-            int32_t current_offset = (dst_row > 0) ? dst_offsets[dst_row] : 0;
-            dst_offsets[dst_row] = current_offset;
-            dst_offsets[dst_row + 1] = current_offset; // Length 0
+        // O(1) append at the tail left by the previous row
+        NDBStringBuilder builder;
+        if (init_ndb_string_builder(&builder, dst_table, dst_col, dst_row) == 0) {
+            append_ndb_string(&builder, str_ptr, str_ptr ? str_len : 0);
         }
     }
 }
 
-// Create NDB table
+// Bytes per row reserved up front for string characters
+#define NDB_STRING_INITIAL_BYTES 16
+#define NDB_MIN_ROW_CAPACITY 16
+
+static size_t validity_bytes(int rows) {
+    return ((size_t)rows + 7) / 8;
+}
+
+static size_t value_bytes(int type_id, int rows) {
+    if (type_id == NDB_TYPE_STRING) return (size_t)rows * NDB_STRING_INITIAL_BYTES;
+    return (size_t)rows * ndb_type_width(type_id);
+}
+
+// Bytes a buffer takes from the arena's shared chunks, alignment included
+static size_t shared_arena_bytes(size_t size) {
+    return size < NDB_ARENA_BLOCK_BYTES ? size + 64 : 0;
+}
+
+// Resize a buffer of the table, from its arena when it has one
+static void* resize_table_buffer(NDBTableC* table, void* ptr, size_t old_size, size_t new_size) {
+    if (table->arena) {
+        return ndb_arena_realloc(table->arena, ptr, old_size, new_size);
+    }
+    return realloc(ptr, new_size);
+}
+
+// Create NDB table. max_rows is only the initial capacity: every buffer
+// lives in one arena, grows on demand and is left uninitialized.
 NDBTableC* create_ndb_table(int max_rows, int column_count, NDBFieldC* schema) {
-    NDBTableC* table = (NDBTableC*)malloc(sizeof(NDBTableC));
+    if (max_rows < 1) max_rows = 1;
+
+    // Size the first chunk to hold the table with its initial buffers,
+    // except large ones, which get chunks of their own
+    size_t bytes = sizeof(NDBTableC) + column_count * (sizeof(NDBFieldC) + sizeof(NDBArrayC)) + 256;
+    for (int i = 0; i < column_count; i++) {
+        bytes += shared_arena_bytes(validity_bytes(max_rows)) +
+                 shared_arena_bytes(value_bytes(schema[i].type_id, max_rows)) +
+                 shared_arena_bytes(((size_t)max_rows + 1) * sizeof(int32_t));
+    }
+    NDBArena* arena = ndb_arena_create(bytes);
+    if (!arena) {
+        return NULL;
+    }
+
+    NDBTableC* table = (NDBTableC*)ndb_arena_alloc(arena, sizeof(NDBTableC));
+    NDBFieldC* fields = (NDBFieldC*)ndb_arena_alloc(arena, column_count * sizeof(NDBFieldC));
+    NDBArrayC* columns = (NDBArrayC*)ndb_arena_alloc(arena, column_count * sizeof(NDBArrayC));
+    if (!table || !fields || !columns) {
+        ndb_arena_destroy(arena);
+        return NULL;
+    }
+    table->arena = arena;
+    table->release = NULL;
+    table->private_data = NULL;
     table->num_rows = 0;
     table->num_columns = column_count;
-    table->fields = (NDBFieldC*)malloc(column_count * sizeof(NDBFieldC));
-    table->columns = (NDBArrayC*)malloc(column_count * sizeof(NDBArrayC));
+    table->fields = fields;
+    table->columns = columns;
     
     // Copy schema
     memcpy(table->fields, schema, column_count * sizeof(NDBFieldC));
@@ -333,38 +287,93 @@ NDBTableC* create_ndb_table(int max_rows, int column_count, NDBFieldC* schema) {
         array->type_id = schema[i].type_id;
         array->length = max_rows;
         array->null_count = 0;
+        array->validity = NULL;
+        array->offsets = NULL;
+        array->values = NULL;
+        array->value_capacity = 0;
+        array->dictionary = NULL;
         
-        if (schema[i].nullable) {
-            int bitmap_size = (max_rows + 7) / 8;
-            array->validity = (uint8_t*)malloc(bitmap_size);
-            memset(array->validity, 0xFF, bitmap_size); // Set all to valid
-        } else {
-            array->validity = NULL;
+        if (schema[i].nullable && ensure_ndb_validity(table, i) != 0) {
+            free_ndb_table(table);
+            return NULL;
         }
         
-        if (array->type_id == 0) { // int32
-            array->values = malloc(max_rows * sizeof(int32_t));
-            memset(array->values, 0, max_rows * sizeof(int32_t)); // Initialize to 0
-            array->offsets = NULL;
-        } else if (array->type_id == 1) { // string
-            array->values = malloc(max_rows * 256); // Assume max 256 bytes per string
-            memset(array->values, 0, max_rows * 256); // Initialize to 0
-            array->offsets = (int32_t*)malloc((max_rows + 1) * sizeof(int32_t));
-            
-            // Important: initialize all offsets to 0
-            for (int j = 0; j <= max_rows; j++) {
-                array->offsets[j] = 0;
+        size_t size = value_bytes(array->type_id, max_rows);
+        if (size > 0) {
+            array->values = ndb_arena_alloc(arena, size);
+        }
+        if (array->type_id == NDB_TYPE_STRING) {
+            array->value_capacity = (int32_t)size;
+            array->offsets = (int32_t*)ndb_arena_alloc(arena, ((size_t)max_rows + 1) * sizeof(int32_t));
+            if (array->offsets) {
+                array->offsets[0] = 0;
             }
         }
+        if ((size > 0 && !array->values) || (array->type_id == NDB_TYPE_STRING && !array->offsets)) {
+            free_ndb_table(table);
+            return NULL;
+        }
     }
     
     return table;
 }
 
+NDBTableC* wrap_ndb_table(int num_rows, int column_count, const NDBFieldC* schema) {
+    size_t bytes = sizeof(NDBTableC) + column_count * (sizeof(NDBFieldC) + sizeof(NDBArrayC)) + 256;
+    for (int i = 0; i < column_count; i++) {
+        bytes += strlen(schema[i].name) + 1;
+    }
+    NDBArena* arena = ndb_arena_create(bytes);
+    if (!arena) {
+        return NULL;
+    }
+    NDBTableC* table = (NDBTableC*)ndb_arena_alloc(arena, sizeof(NDBTableC));
+    NDBFieldC* fields = (NDBFieldC*)ndb_arena_alloc(arena, column_count * sizeof(NDBFieldC) + 1);
+    NDBArrayC* columns = (NDBArrayC*)ndb_arena_alloc(arena, column_count * sizeof(NDBArrayC) + 1);
+    if (!table || !fields || !columns) {
+        ndb_arena_destroy(arena);
+        return NULL;
+    }
+    memset(table, 0, sizeof(*table));
+    memset(columns, 0, column_count * sizeof(NDBArrayC));
+    table->arena = arena;
+    table->fields = fields;
+    table->columns = columns;
+    table->num_columns = column_count;
+    table->num_rows = num_rows;
+    
+    // Names are copied: the source schema need not outlive the table
+    for (int i = 0; i < column_count; i++) {
+        size_t len = strlen(schema[i].name) + 1;
+        char* name = (char*)ndb_arena_alloc(arena, len);
+        if (!name) {
+            ndb_arena_destroy(arena);
+            return NULL;
+        }
+        memcpy(name, schema[i].name, len);
+        fields[i] = schema[i];
+        fields[i].name = name;
+        columns[i].type_id = schema[i].type_id;
+        columns[i].length = num_rows;
+    }
+    return table;
+}
+
 // Free NDB table
 void free_ndb_table(NDBTableC* table) {
     if (!table) return;
     
+    // Foreign buffers go back to their owner first
+    if (table->release) {
+        table->release(table);
+    }
+    
+    // The table itself is allocated from its arena
+    if (table->arena) {
+        ndb_arena_destroy(table->arena);
+        return;
+    }
+    
     for (int i = 0; i < table->num_columns; i++) {
         NDBArrayC* array = &table->columns[i];
         if (array->validity) free(array->validity);
@@ -377,76 +386,99 @@ void free_ndb_table(NDBTableC* table) {
     free(table);
 }
 
-// =================== Vectorization functions ===================
-
-// NDB vectorized key retrieval
-void vectorized_get_ndb_keys(const NDBTableC* table, int key_column, int* keys, int start_row, int count) {
-    if (!table || !keys || key_column < 0 || key_column >= table->num_columns || 
-        start_row < 0 || count <= 0 || start_row + count > table->num_rows) {
-        return;
+int reserve_ndb_table_rows(NDBTableC* table, int num_rows) {
+    for (int i = 0; i < table->num_columns; i++) {
+        NDBArrayC* array = &table->columns[i];
+        if (array->length >= num_rows) {
+            continue;
+        }
+        
+        // Double so that appending row by row stays amortized O(1)
+        int64_t grown = (int64_t)array->length * 2;
+        if (grown < NDB_MIN_ROW_CAPACITY) grown = NDB_MIN_ROW_CAPACITY;
+        if (grown < num_rows) grown = num_rows;
+        if (grown > INT32_MAX - 1) grown = INT32_MAX - 1;
+        int capacity = (int)grown;
+        
+        if (array->validity) {
+            size_t old_size = validity_bytes(array->length);
+            size_t new_size = validity_bytes(capacity);
+            uint8_t* validity = (uint8_t*)resize_table_buffer(table, array->validity, old_size, new_size);
+            if (!validity) return -1;
+            memset(validity + old_size, 0xFF, new_size - old_size); // New rows start valid
+            array->validity = validity;
+        }
+        if (array->type_id != NDB_TYPE_STRING) { // fixed width
+            void* values = resize_table_buffer(table, array->values, value_bytes(array->type_id, array->length),
+                                               value_bytes(array->type_id, capacity));
+            if (!values) return -1;
+            array->values = values;
+        } else {
+            int32_t* offsets = (int32_t*)resize_table_buffer(table, array->offsets,
+                                                             ((size_t)array->length + 1) * sizeof(int32_t),
+                                                             ((size_t)capacity + 1) * sizeof(int32_t));
+            if (!offsets) return -1;
+            array->offsets = offsets;
+        }
+        array->length = capacity;
     }
-    
-    NDBArrayC* array = &table->columns[key_column];
-    if (array->type_id != 0) { // Only support int32
-        return;
+    return 0;
+}
+
+int reserve_ndb_string_bytes(NDBTableC* table, int column_idx, int64_t num_bytes) {
+    NDBArrayC* array = &table->columns[column_idx];
+    if (array->type_id != NDB_TYPE_STRING || num_bytes > INT32_MAX) {
+        return -1;
     }
-    
-    int32_t* column_data = (int32_t*)array->values;
-    
-    // Loop unrolling optimization
-    int full_blocks = count / 4;
-    int remainder = count % 4;
-    
-    for (int i = 0; i < full_blocks; i++) {
-        int base_idx = i * 4;
-        int src_base = start_row + base_idx;
-        keys[base_idx] = column_data[src_base];
-        keys[base_idx + 1] = column_data[src_base + 1];
-        keys[base_idx + 2] = column_data[src_base + 2];
-        keys[base_idx + 3] = column_data[src_base + 3];
+    if (array->value_capacity >= num_bytes) {
+        return 0;
     }
     
-    int base = full_blocks * 4;
-    for (int i = 0; i < remainder; i++) {
-        keys[base + i] = column_data[start_row + base + i];
+    int64_t grown = (int64_t)array->value_capacity * 2;
+    if (grown < num_bytes) grown = num_bytes;
+    if (grown > INT32_MAX) grown = INT32_MAX;
+    void* values = resize_table_buffer(table, array->values, array->value_capacity, (size_t)grown);
+    if (!values) {
+        return -1;
     }
+    array->values = values;
+    array->value_capacity = (int32_t)grown;
+    return 0;
 }
 
-// =================== Hash functions ===================
-
-void simple_hash_keys(int* keys, unsigned int* hashes, int count) {
-    if (!keys || !hashes || count <= 0) return;
-    
-    for (int i = 0; i < count; i++) {
-        hashes[i] = hash_key(keys[i]);
+int ensure_ndb_validity(NDBTableC* table, int column_idx) {
+    NDBArrayC* array = &table->columns[column_idx];
+    if (array->validity) {
+        return 0;
     }
+    size_t size = validity_bytes(array->length);
+    array->validity = (uint8_t*)resize_table_buffer(table, NULL, 0, size > 0 ? size : 1);
+    if (!array->validity) {
+        return -1;
+    }
+    memset(array->validity, 0xFF, size); // Set all to valid
+    return 0;
 }
 
-void aligned_hash_keys(int* keys, unsigned int* hashes, int count) {
-    if (!keys || !hashes || count <= 0) {
+// =================== Vectorization functions ===================
+
+// NDB vectorized key retrieval
+void vectorized_get_ndb_keys(const NDBTableC* table, int key_column, int* keys, int start_row, int count) {
+    if (!table || !keys || key_column < 0 || key_column >= table->num_columns || 
+        start_row < 0 || count <= 0 || start_row + count > table->num_rows) {
         return;
     }
     
-    uintptr_t key_addr = (uintptr_t)keys;
-    bool is_aligned = (key_addr % 16 == 0);
-    
-    if (is_aligned && count >= 32) {
-        // For aligned data, use single batch hash
-        XXH64_hash_t master_hash = XXH3_64bits(keys, count * sizeof(int));
-        
-        for (int i = 0; i < count; i++) {
-            XXH64_hash_t unique_hash = master_hash ^ 
-                                     ((XXH64_hash_t)keys[i] << 16) ^ 
-                                     ((XXH64_hash_t)i << 8);
-            hashes[i] = (unsigned int)(unique_hash % TABLE_SIZE);
-        }
-    } else {
-        // For non-aligned data, fall back to simple method
-        simple_hash_keys(keys, hashes, count);
+    NDBArrayC* array = &table->columns[key_column];
+    const NDBTypeInfo* info = ndb_type_info(array->type_id);
+    if (!info || !info->int32_key) { // Only int32 values
+        return;
     }
+    
+    // Keys are stored contiguously, so a batch is a single copy
+    memcpy(keys, (const int32_t*)array->values + start_row, count * sizeof(int32_t));
 }
 
-
 // =================== Callback functions ===================
 
 void standard_ndb_match_processor(
@@ -455,6 +487,15 @@ void standard_ndb_match_processor(
     NDBTableC* result_table, int* result_row_count
 ) {
     int result_row = *result_row_count;
+    if (reserve_ndb_table_rows(result_table, result_row + 1) != 0) {
+        fprintf(stderr, "Error: out of memory growing result table\n");
+        return;
+    }
+    
+    // Update result table row count first, so NULLs can be marked in the new row
+    if (result_table->num_rows <= result_row) {
+        result_table->num_rows = result_row + 1;
+    }
     
     // Copy left table data
     for (int col = 0; col < left_table->num_columns; col++) {
@@ -469,11 +510,6 @@ void standard_ndb_match_processor(
     }
     
     (*result_row_count)++;
-    
-    // Update result table row count
-    if (result_table->num_rows <= result_row) {
-        result_table->num_rows = result_row + 1;
-    }
 }
 
 void standard_ndb_unmatch_processor(
@@ -482,50 +518,48 @@ void standard_ndb_unmatch_processor(
     int is_left
 ) {
     int result_row = *result_row_count;
+    if (reserve_ndb_table_rows(result_table, result_row + 1) != 0) {
+        fprintf(stderr, "Error: out of memory growing result table\n");
+        return;
+    }
     
-    if (is_left) {
-        // Copy left table data
-        for (int col = 0; col < table->num_columns; col++) {
-            copy_ndb_value(table, col, row_idx, 
-                            result_table, col, result_row);
-        }
+    // Update result table row count first, so NULLs can be marked in the new row
+    if (result_table->num_rows <= result_row) {
+        result_table->num_rows = result_row + 1;
+    }
+    
+    // The row's own columns, then NULL for the other input's columns
+    int own_start = is_left ? 0 : result_table->num_columns - table->num_columns;
+    int null_start = is_left ? table->num_columns : 0;
+    int null_count = result_table->num_columns - table->num_columns;
+    for (int col = 0; col < table->num_columns; col++) {
+        copy_ndb_value(table, col, row_idx,
+                        result_table, own_start + col, result_row);
+    }
+    for (int col = 0; col < null_count; col++) {
+        int target_col = null_start + col;
         
-        // Set right table part to NULL
-        int right_start = table->num_columns;
-        int right_count = result_table->num_columns - table->num_columns;
-        for (int col = 0; col < right_count; col++) {
-            int target_col = right_start + col;
-            
-            // For integer type, set a default value (although it will be overridden by NULL mark)
-            if (result_table->columns[target_col].type_id == 0) {
-                int32_t* data = (int32_t*)result_table->columns[target_col].values;
-                data[result_row] = 0; // Set default value
-            }
-            // For string type, ensure offsets are correct
-            else if (result_table->columns[target_col].type_id == 1) {
-                NDBArrayC* array = &result_table->columns[target_col];
-                if (array->offsets) {
-                    // Ensure string length is 0
-                    int32_t current_offset = (result_row > 0) ? array->offsets[result_row] : 0;
-                    array->offsets[result_row] = current_offset;
-                    array->offsets[result_row + 1] = current_offset; // Length 0
-                }
+        // For fixed-width types, set a default value (although it will be overridden by NULL mark)
+        int width = ndb_type_width(result_table->columns[target_col].type_id);
+        if (width > 0) {
+            memset((char*)result_table->columns[target_col].values + (size_t)result_row * width, 0, width);
+        }
+        // For string type, ensure offsets are correct
+        else if (result_table->columns[target_col].type_id == NDB_TYPE_STRING) {
+            NDBArrayC* array = &result_table->columns[target_col];
+            if (array->offsets) {
+                // Ensure string length is 0
+                int32_t current_offset = (result_row > 0) ? array->offsets[result_row] : 0;
+                array->offsets[result_row] = current_offset;
+                array->offsets[result_row + 1] = current_offset; // Length 0
             }
-            
-            // Set to NULL
-            set_ndb_value_null(result_table, target_col, result_row);
         }
-    } else {
-        // Right table unmatch (RIGHT JOIN, not implemented yet)
-        printf("Right table unmatch not implemented\n");
+        
+        // Set to NULL
+        set_ndb_value_null(result_table, target_col, result_row);
     }
     
     (*result_row_count)++;
-    
-    // Update result table row count
-    if (result_table->num_rows <= result_row) {
-        result_table->num_rows = result_row + 1;
-    }
 }
 
 void selective_ndb_match_processor(
@@ -534,6 +568,15 @@ void selective_ndb_match_processor(
     NDBTableC* result_table, int* result_row_count
 ) {
     int result_row = *result_row_count;
+    if (reserve_ndb_table_rows(result_table, result_row + 1) != 0) {
+        fprintf(stderr, "Error: out of memory growing result table\n");
+        return;
+    }
+    
+    // Update result table row count first, so NULLs can be marked in the new row
+    if (result_table->num_rows <= result_row) {
+        result_table->num_rows = result_row + 1;
+    }
     
     // Only copy the first column (assumed to be key column)
     copy_ndb_value(left_table, 0, left_row_idx, 
@@ -545,15 +588,251 @@ void selective_ndb_match_processor(
     }
     
     (*result_row_count)++;
-    
-    // Important: also update result table row count
-    if (result_table->num_rows <= result_row) {
-        result_table->num_rows = result_row + 1;
+}
+
+// =================== Join row pairs ===================
+
+void init_ndb_row_pairs(NDBRowPairs* pairs) {
+    pairs->left_rows = NULL;
+    pairs->right_rows = NULL;
+    pairs->count = 0;
+    pairs->capacity = 0;
+}
+
+void free_ndb_row_pairs(NDBRowPairs* pairs) {
+    free(pairs->left_rows);
+    free(pairs->right_rows);
+    init_ndb_row_pairs(pairs);
+}
+
+int reserve_ndb_row_pairs(NDBRowPairs* pairs, int64_t extra) {
+    if (pairs->count + extra <= pairs->capacity) {
+        return 0;
+    }
+    int64_t capacity = pairs->capacity ? pairs->capacity : 256;
+    while (capacity < pairs->count + extra) {
+        capacity *= 2;
+    }
+    int32_t* left = (int32_t*)realloc(pairs->left_rows, capacity * sizeof(int32_t));
+    if (!left) return -1;
+    pairs->left_rows = left;
+    int32_t* right = (int32_t*)realloc(pairs->right_rows, capacity * sizeof(int32_t));
+    if (!right) return -1;
+    pairs->right_rows = right;
+    pairs->capacity = capacity;
+    return 0;
+}
+
+int append_ndb_row_pair(NDBRowPairs* pairs, int32_t left_row, int32_t right_row) {
+    if (pairs->count == pairs->capacity && reserve_ndb_row_pairs(pairs, 1) != 0) {
+        return -1;
+    }
+    pairs->left_rows[pairs->count] = left_row;
+    pairs->right_rows[pairs->count] = right_row;
+    pairs->count++;
+    return 0;
+}
+
+int append_ndb_row_pair_range(NDBRowPairs* pairs, const NDBRowPairs* src, int64_t start, int64_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    if (reserve_ndb_row_pairs(pairs, count) != 0) {
+        return -1;
+    }
+    memcpy(pairs->left_rows + pairs->count, src->left_rows + start, count * sizeof(int32_t));
+    memcpy(pairs->right_rows + pairs->count, src->right_rows + start, count * sizeof(int32_t));
+    pairs->count += count;
+    return 0;
+}
+
+void mark_ndb_matched_rows(uint64_t* matched, const int32_t* right_rows, int64_t count) {
+    for (int64_t i = 0; i < count; i++) {
+        int32_t row = right_rows[i];
+        if (row < 0) {
+            continue;
+        }
+        uint64_t* word = &matched[row >> 6];
+        uint64_t bit = 1ULL << (row & 63);
+        // Rows matched before skip the locked read-modify-write
+        if (!(__atomic_load_n(word, __ATOMIC_RELAXED) & bit)) {
+            __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int append_unmatched_ndb_rows(NDBRowPairs* pairs, const uint64_t* matched, int count, const int32_t* rows) {
+    for (int base = 0; base < count; base += 64) {
+        // Word at a time: fully matched words cost one compare
+        uint64_t unmatched = ~matched[base >> 6];
+        if (count - base < 64) {
+            unmatched &= (1ULL << (count - base)) - 1;
+        }
+        while (unmatched) {
+            int p = base + __builtin_ctzll(unmatched);
+            unmatched &= unmatched - 1;
+            if (append_ndb_row_pair(pairs, -1, rows ? rows[p] : p) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int append_null_key_ndb_rows(NDBRowPairs* pairs, const uint64_t* nulls, int num_rows, int is_left) {
+    for (int base = 0; base < num_rows; base += 64) {
+        for (uint64_t word = nulls[base >> 6]; word; word &= word - 1) {
+            int row = base + __builtin_ctzll(word);
+            if (append_ndb_row_pair(pairs, is_left ? row : -1, is_left ? -1 : row) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int ndb_join_output_is_columnar(const NDBTableC* left_table, const NDBTableC* result_table, JoinType join_type,
+                                ProcessNDBMatchFunc match_processor, ProcessNDBUnmatchedFunc unmatch_processor) {
+    if (ndb_join_is_semi(join_type)) {
+        return unmatch_processor == standard_ndb_unmatch_processor &&
+               result_table->num_columns == left_table->num_columns;
+    }
+    return match_processor == standard_ndb_match_processor &&
+           (join_type == INNER_JOIN || unmatch_processor == standard_ndb_unmatch_processor);
+}
+
+void emit_ndb_row_pairs(
+    const NDBRowPairs* pairs, int64_t start, int64_t count,
+    const NDBTableC* left_table, const NDBTableC* right_table,
+    NDBTableC* result_table, int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor
+) {
+    for (int64_t i = start; i < start + count; i++) {
+        if (pairs->right_rows[i] >= 0 && pairs->left_rows[i] >= 0) {
+            if (match_processor) {
+                match_processor(left_table, pairs->left_rows[i],
+                                right_table, pairs->right_rows[i],
+                                result_table, result_row_count);
+            }
+        } else if (unmatch_processor) {
+            if (pairs->right_rows[i] < 0) {
+                unmatch_processor(left_table, pairs->left_rows[i],
+                                  result_table, result_row_count, 1);
+            } else {
+                unmatch_processor(right_table, pairs->right_rows[i],
+                                  result_table, result_row_count, 0);
+            }
+        }
     }
 }
 
 // =================== Main hash join function ===================
 
+#define PROBE_BATCH_SIZE 64
+#define PROBE_MORSEL_ROWS (256 * PROBE_BATCH_SIZE)
+
+typedef struct {
+    const int32_t* left_keys;       // Key of every left row
+    const uint64_t* left_nulls;     // Left rows with a NULL key, or NULL
+    int32_t absent_key;             // Probed in place of a NULL key
+    const HashTable* table;
+    JoinType join_type;
+    uint64_t* matched;              // Build rows that found a partner (RIGHT/FULL), else NULL
+    NDBRowPairs* worker_pairs;      // Thread-local output buffer of each worker
+    int* morsel_worker;             // Worker that ran each morsel
+    int64_t* morsel_first_pair;     // First pair of each morsel in that worker's buffer
+    int64_t* morsel_pair_count;     // Pairs produced by each morsel
+    atomic_int failed;
+} ProbeJob;
+
+// Probe left rows [start, end) into the worker's own pair buffer
+static void probe_morsel(void* context, int64_t start, int64_t end, int worker_id) {
+    ProbeJob* job = (ProbeJob*)context;
+    NDBRowPairs* out = &job->worker_pairs[worker_id];
+    int64_t morsel = start / PROBE_MORSEL_ROWS;
+    job->morsel_worker[morsel] = worker_id;
+    job->morsel_first_pair[morsel] = out->count;
+
+    uint64_t hash_batch[PROBE_BATCH_SIZE];
+    int32_t null_batch[PROBE_BATCH_SIZE];
+    int emit_unmatched = ndb_join_keeps_left(job->join_type);
+    int semi = ndb_join_is_semi(job->join_type);
+
+    // Semi/anti joins emit at most one pair per left row: reserve once
+    if (semi && reserve_ndb_row_pairs(out, end - start) != 0) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+
+    for (int batch_start = (int)start; batch_start < end; batch_start += PROBE_BATCH_SIZE) {
+        int batch_size = (batch_start + PROBE_BATCH_SIZE <= end) ? 
+                        PROBE_BATCH_SIZE : (int)(end - batch_start);
+        
+        const int32_t* key_batch = job->left_keys + batch_start;
+        
+        // Morsels and batches are 64-row aligned: one word of the bitmap
+        // tells whether the batch has NULL keys to replace
+        if (job->left_nulls && job->left_nulls[batch_start >> 6]) {
+            memcpy(null_batch, key_batch, batch_size * sizeof(int32_t));
+            mask_ndb_null_keys(null_batch, job->left_nulls, batch_start, batch_size, job->absent_key);
+            key_batch = null_batch;
+        }
+        
+        // Hash the batch once with the table's function; the probe reuses it
+        ndb_hash_keys(job->table->hash_function, key_batch, hash_batch, batch_size);
+        
+        if (semi) {
+            int64_t first = out->count;
+            out->count += probe_hash_key_set(job->table, key_batch, hash_batch, batch_size, batch_start,
+                                             job->join_type == LEFT_ANTI_JOIN, out->left_rows + first);
+            for (int64_t k = first; k < out->count; k++) {
+                out->right_rows[k] = -1;
+            }
+            continue;
+        }
+        
+        // Probe the whole batch straight into the worker's pair arrays,
+        // growing them whenever a large fan-out fills the free space
+        HashProbeCursor cursor;
+        init_hash_probe_cursor(&cursor);
+        while (cursor.key_idx < batch_size) {
+            if (reserve_ndb_row_pairs(out, PROBE_BATCH_SIZE) != 0) {
+                atomic_store(&job->failed, 1);
+                return;
+            }
+            int64_t first = out->count;
+            out->count += probe_hash_batch(job->table, key_batch, hash_batch, batch_size, batch_start,
+                                           emit_unmatched, &cursor,
+                                           out->left_rows + first, out->right_rows + first,
+                                           (int)(out->capacity - first));
+            if (job->matched) {
+                mark_ndb_matched_rows(job->matched, out->right_rows + first, out->count - first);
+            }
+        }
+    }
+    
+    job->morsel_pair_count[morsel] = out->count - job->morsel_first_pair[morsel];
+}
+
+// Probe keys sampled across the left table to estimate the match rate
+#define BLOOM_SAMPLE_ROWS 1024
+// An automatic filter is only built when at most this fraction of the
+// sampled keys match: the hits pay for the filter test on top of the lookup
+#define BLOOM_MAX_MATCH_RATE 0.5
+
+// Fraction of sampled left keys found in the table
+static double sample_match_rate(const HashTable* table, const int32_t* left_keys, int left_rows) {
+    int64_t step = left_rows / BLOOM_SAMPLE_ROWS + 1;
+    int sampled = 0;
+    int matched = 0;
+    for (int64_t row = 0; row < left_rows; row += step) {
+        matched += lookup_hash(table, left_keys[row]) >= 0;
+        sampled++;
+    }
+    return sampled > 0 ? (double)matched / sampled : 0.0;
+}
+
 void flexible_ndb_hash_join(
     const NDBTableC* left_table,
     const NDBTableC* right_table,
@@ -565,68 +844,290 @@ void flexible_ndb_hash_join(
     ProcessNDBMatchFunc match_processor,
     ProcessNDBUnmatchedFunc unmatch_processor
 ) {
-    HashTable table = {0};
-    init_hash_table(&table);
-    *result_row_count = 0;
+    flexible_ndb_hash_join_with_options(left_table, right_table, left_key_column, right_key_column,
+                                        join_type, result_table, result_row_count,
+                                        match_processor, unmatch_processor, NULL);
+}
+
+void flexible_ndb_hash_join_with_options(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+) {
+    flexible_ndb_hash_join_multi(left_table, right_table, &left_key_column, &right_key_column, 1,
+                                 join_type, result_table, result_row_count,
+                                 match_processor, unmatch_processor, options);
+}
+
+// The join proper, on one int32 key per row of either side. Rows set in
+// left_nulls / right_nulls (either may be NULL) have a NULL key. With
+// pairs_out the pairs are appended there instead of materialized or
+// handed to the processors. Returns 0, or -1 on failure.
+static int flexible_join_on_keys(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int32_t* left_keys,
+    const int32_t* right_keys,
+    const uint64_t* left_nulls,
+    const uint64_t* right_nulls,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options,
+    NDBRowPairs* pairs_out
+) {
+    HashTable table;
+    if (init_hash_table(&table, right_table->num_rows, options->hash_function) != 0) {
+        fprintf(stderr, "Error: failed to allocate hash table for %d rows\n", right_table->num_rows);
+        return -1;
+    }
     
-    // Build right table hash table
-    for (int i = 0; i < right_table->num_rows; i++) {
-        int key = get_int_key_from_ndb_column(right_table, right_key_column, i);
-        insert_hash(&table, key, i);
+    // Build right table hash table. NULL-key rows stay out of it, so they
+    // never match and RIGHT/FULL emit them as unmatched build rows.
+    int build_count = right_table->num_rows;
+    int32_t* build_keys = NULL;
+    int32_t* build_rows = NULL;
+    if (right_nulls) {
+        build_keys = malloc((build_count > 0 ? build_count : 1) * sizeof(int32_t));
+        build_rows = malloc((build_count > 0 ? build_count : 1) * sizeof(int32_t));
+        if (build_keys && build_rows) {
+            build_count = compact_ndb_non_null_keys(right_keys, right_nulls, build_count, build_keys, build_rows);
+            right_keys = build_keys;
+        }
+    }
+    int build_status = right_nulls && (!build_keys || !build_rows) ? -1 :
+                       ndb_join_is_semi(join_type) ?
+                       build_hash_key_set(&table, right_keys, NULL, build_count) :
+                       build_hash_table(&table, right_keys, NULL, build_rows, build_count);
+    free(build_keys);
+    free(build_rows);
+    if (build_status != 0) {
+        fprintf(stderr, "Error: failed to build hash table for %d rows\n", right_table->num_rows);
+        free_hash_table(&table);
+        return -1;
     }
     
-    // Batch process left table
-    const int BATCH_SIZE = 64;
-    int* key_batch = malloc(BATCH_SIZE * sizeof(int));
-    unsigned int* hash_batch = malloc(BATCH_SIZE * sizeof(unsigned int));
+    // Few distinct build keys against many probe rows: most probes are
+    // likely misses, which the filter drops before they touch a bucket.
+    // Without the filter the join still works, so failure is not fatal.
+    int use_bloom = options->bloom_filter > 0 ||
+                    (options->bloom_filter == 0 &&
+                     table.count * NDB_BLOOM_AUTO_RATIO <= (int64_t)left_table->num_rows &&
+                     sample_match_rate(&table, left_keys, left_table->num_rows) <= BLOOM_MAX_MATCH_RATE);
+    if (use_bloom && build_hash_table_bloom(&table) != 0) {
+        free_ndb_bloom_filter(&table.bloom);
+    }
     
-    for (int batch_start = 0; batch_start < left_table->num_rows; batch_start += BATCH_SIZE) {
-        int batch_size = (batch_start + BATCH_SIZE <= left_table->num_rows) ? 
-                        BATCH_SIZE : (left_table->num_rows - batch_start);
-        
-        // Batch get key values
-        vectorized_get_ndb_keys(left_table, left_key_column, key_batch, batch_start, batch_size);
-        
-        // Batch calculate hash values
-        aligned_hash_keys(key_batch, hash_batch, batch_size);
-        
-        // Process this batch of joins
-        for (int i = 0; i < batch_size; i++) {
-            int left_row = batch_start + i;
-            int key = key_batch[i];
-            
-            int found_match = 0;
-            
-            // Find matches
-            int hash_idx = lookup_hash(&table, key);
-            while (hash_idx != -1) {
-                found_match = 1;
-                
-                // Call match processor
-                if (match_processor) {
-                    match_processor(left_table, left_row, 
-                                  right_table, table.buckets[hash_idx].row_index,
-                                  result_table, result_row_count);
+    // Probe left table in morsels; a single morsel, or every morsel when
+    // no worker pool could be started, is probed inline
+    int64_t num_morsels = ((int64_t)left_table->num_rows + PROBE_MORSEL_ROWS - 1) / PROBE_MORSEL_ROWS;
+    ThreadPool* owned_pool = num_morsels > 1 && options->num_threads > 0 ?
+                             create_thread_pool(options->num_threads) : NULL;
+    ThreadPool* pool = owned_pool ? owned_pool :
+                       num_morsels > 1 ? get_default_thread_pool() : NULL;
+    int num_workers = pool ? thread_pool_size(pool) : 1;
+    
+    // Build side matched bitmap; the probe sets bits with relaxed atomics
+    uint64_t* matched = ndb_join_keeps_right(join_type) ?
+                        calloc(((size_t)right_table->num_rows + 63) / 64 + 1, sizeof(uint64_t)) : NULL;
+    NDBRowPairs unmatched_right;
+    init_ndb_row_pairs(&unmatched_right);
+    
+    ProbeJob job = {
+        .left_keys = left_keys,
+        .left_nulls = left_nulls,
+        .absent_key = left_nulls ? absent_hash_key(&table) : 0,
+        .table = &table,
+        .join_type = join_type,
+        .matched = matched,
+        .worker_pairs = calloc(num_workers, sizeof(NDBRowPairs)),
+        .morsel_worker = malloc((num_morsels > 0 ? num_morsels : 1) * sizeof(int)),
+        .morsel_first_pair = malloc((num_morsels > 0 ? num_morsels : 1) * sizeof(int64_t)),
+        .morsel_pair_count = malloc((num_morsels > 0 ? num_morsels : 1) * sizeof(int64_t)),
+    };
+    atomic_init(&job.failed, 0);
+    
+    if (!job.worker_pairs || !job.morsel_worker || !job.morsel_first_pair || !job.morsel_pair_count ||
+        (ndb_join_keeps_right(join_type) && !matched)) {
+        atomic_store(&job.failed, 1);
+    } else if (pool) {
+        thread_pool_parallel_for(pool, 0, left_table->num_rows, PROBE_MORSEL_ROWS, probe_morsel, &job);
+    } else {
+        for (int64_t start = 0; start < left_table->num_rows && !atomic_load(&job.failed);
+             start += PROBE_MORSEL_ROWS) {
+            int64_t end = start + PROBE_MORSEL_ROWS < left_table->num_rows ? start + PROBE_MORSEL_ROWS
+                                                                            : left_table->num_rows;
+            probe_morsel(&job, start, end, 0);
+        }
+    }
+    
+    // Build rows no probe row matched come after all probe rows
+    if (matched && !atomic_load(&job.failed) &&
+        append_unmatched_ndb_rows(&unmatched_right, matched, right_table->num_rows, NULL) != 0) {
+        atomic_store(&job.failed, 1);
+    }
+    
+    // Merge the worker buffers into result_table in morsel (= left row) order
+    int status = atomic_load(&job.failed) ? -1 : 0;
+    if (status != 0) {
+        fprintf(stderr, "Error: out of memory buffering join results\n");
+    } else {
+        // The standard processors are replaced by one gather per column
+        int semi = ndb_join_is_semi(join_type);
+        int columnar = !pairs_out && ndb_join_output_is_columnar(left_table, result_table, join_type,
+                                                                 match_processor, unmatch_processor);
+        for (int64_t m = 0; m <= num_morsels; m++) {
+            // The unmatched build rows go last, as one extra chunk
+            NDBRowPairs* pairs = m < num_morsels ? &job.worker_pairs[job.morsel_worker[m]] : &unmatched_right;
+            int64_t first = m < num_morsels ? job.morsel_first_pair[m] : 0;
+            int64_t count = m < num_morsels ? job.morsel_pair_count[m] : unmatched_right.count;
+            if (pairs_out) {
+                if (append_ndb_row_pair_range(pairs_out, pairs, first, count) != 0) {
+                    fprintf(stderr, "Error: out of memory buffering join results\n");
+                    status = -1;
+                    break;
                 }
-                
-                // Find next match (handle duplicate keys)
-                // Simplified: assume no duplicate keys, actual implementation needs to continue searching
-                hash_idx = -1;
-            }
-            
-            // Handle unmatched rows
-            if (!found_match && join_type == LEFT_JOIN) {
-                if (unmatch_processor) {
-                    unmatch_processor(left_table, left_row, 
-                                    result_table, result_row_count, 1);
+            } else if (columnar) {
+                if (materialize_ndb_row_pairs(pairs, first, count, left_table, semi ? NULL : right_table,
+                                              result_table, result_row_count) != 0) {
+                    fprintf(stderr, "Error: failed to materialize join output\n");
+                    status = -1;
+                    break;
                 }
+            } else {
+                emit_ndb_row_pairs(pairs, first, count, left_table, right_table,
+                                   result_table, result_row_count, match_processor, unmatch_processor);
             }
         }
     }
     
-    free(key_batch);
-    free(hash_batch);
+    for (int w = 0; job.worker_pairs && w < num_workers; w++) {
+        free_ndb_row_pairs(&job.worker_pairs[w]);
+    }
+    free(job.worker_pairs);
+    free_ndb_row_pairs(&unmatched_right);
+    free(matched);
+    free(job.morsel_worker);
+    free(job.morsel_first_pair);
+    free(job.morsel_pair_count);
+    free_thread_pool(owned_pool);
     free_hash_table(&table);
+    return status;
+}
+
+// flexible_ndb_hash_join_multi, or into pairs_out when it is not NULL
+static int hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options,
+    NDBRowPairs* pairs_out
+) {
+    if (!valid_ndb_join_key_columns(left_table, left_key_columns, right_table, right_key_columns,
+                                    num_key_columns)) {
+        return -1;
+    }
+
+    // A NULL key matches nothing, not even another NULL
+    uint64_t* left_nulls = NULL;
+    uint64_t* right_nulls = NULL;
+    if (find_ndb_null_keys(left_table, left_key_columns, num_key_columns, &left_nulls) != 0 ||
+        find_ndb_null_keys(right_table, right_key_columns, num_key_columns, &right_nulls) != 0) {
+        fprintf(stderr, "Error: failed to allocate NULL key bitmaps\n");
+        free(left_nulls);
+        return -1;
+    }
+
+    int status = -1;
+    // Composite and non-int32 keys join on codes of their normalized keys
+    if (ndb_join_keys_need_codes(left_table, left_key_columns, right_table, right_key_columns,
+                                 num_key_columns)) {
+        NDBKeyCodes codes;
+        if (encode_ndb_join_keys(left_table, left_key_columns, right_table, right_key_columns,
+                                 num_key_columns, &codes) == 0) {
+            status = flexible_join_on_keys(left_table, right_table, codes.left, codes.right,
+                                           left_nulls, right_nulls, join_type, result_table, result_row_count,
+                                           match_processor, unmatch_processor, options, pairs_out);
+            free_ndb_key_codes(&codes);
+        }
+    } else {
+        // One int32 column: both sides read the values in place
+        status = flexible_join_on_keys(left_table, right_table,
+                                       (const int32_t*)left_table->columns[left_key_columns[0]].values,
+                                       (const int32_t*)right_table->columns[right_key_columns[0]].values,
+                                       left_nulls, right_nulls, join_type, result_table, result_row_count,
+                                       match_processor, unmatch_processor, options, pairs_out);
+    }
+    free(left_nulls);
+    free(right_nulls);
+    return status;
+}
+
+void flexible_ndb_hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+) {
+    NDBJoinOptions defaults;
+    if (!options) {
+        init_ndb_join_options(&defaults);
+        options = &defaults;
+    }
+    *result_row_count = 0;
+
+    // A build beyond the memory budget spills to disk
+    if (options->memory_limit > 0 && estimate_ndb_build_bytes(right_table->num_rows) > options->memory_limit) {
+        grace_ndb_hash_join_multi(left_table, right_table, left_key_columns, right_key_columns, num_key_columns,
+                                  join_type, result_table, result_row_count,
+                                  match_processor, unmatch_processor, options);
+        return;
+    }
+    hash_join_multi(left_table, right_table, left_key_columns, right_key_columns, num_key_columns,
+                    join_type, result_table, result_row_count, match_processor, unmatch_processor,
+                    options, NULL);
+}
+
+int flexible_ndb_hash_join_pairs(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBRowPairs* pairs,
+    const NDBJoinOptions* options
+) {
+    NDBJoinOptions defaults;
+    if (!options) {
+        init_ndb_join_options(&defaults);
+        options = &defaults;
+    }
+    return hash_join_multi(left_table, right_table, left_key_columns, right_key_columns, num_key_columns,
+                           join_type, NULL, NULL, NULL, NULL, options, pairs);
 }
 
 // Other missing callback functions
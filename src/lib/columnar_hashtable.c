@@ -0,0 +1,617 @@
+#include "columnar_hashtable.h"
+#include "columnar_simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(sizeof(HashBucket) == 64, "HashBucket must fill one cache line");
+
+#define HASH_BUCKET_ALIGNMENT 64
+
+// Keep at most 7/8 of the slots occupied before growing
+#define HASH_MAX_LOAD_NUM 7
+#define HASH_MAX_LOAD_DEN 8
+
+// Keys hashed / tag-matched together by the batch kernels (at most 64,
+// the Bloom filter test returns one bit per key in a single word)
+#define HASH_KERNEL_BATCH 64
+
+// Tag mask of a key without candidates whose home bucket has a free slot
+#define TAG_MASK_ABSENT 0x80
+
+static uint64_t buckets_for_rows(int64_t rows) {
+    // Size for ~75% load so that the table never grows during a build
+    uint64_t wanted = (uint64_t)((rows * 4 / 3 + HASH_BUCKET_SLOTS - 1) / HASH_BUCKET_SLOTS);
+    uint64_t buckets = 1;
+    while (buckets < wanted) {
+        buckets <<= 1;
+    }
+    return buckets;
+}
+
+static HashBucket* alloc_buckets(uint64_t num_buckets) {
+    size_t bytes = num_buckets * sizeof(HashBucket);
+    HashBucket* buckets = (HashBucket*)aligned_alloc(HASH_BUCKET_ALIGNMENT, bytes);
+    if (buckets) {
+        memset(buckets, 0, bytes);
+    }
+    return buckets;
+}
+
+int init_hash_table(HashTable* table, int64_t expected_rows, NDBHashFunction hash_function) {
+    uint64_t num_buckets = buckets_for_rows(expected_rows > 0 ? expected_rows : 1);
+    table->buckets = alloc_buckets(num_buckets);
+    table->bucket_mask = num_buckets - 1;
+    table->count = 0;
+    table->group_offsets = NULL;
+    table->group_ends = NULL;
+    table->row_ids = NULL;
+    table->num_rows = 0;
+    table->hash_function = hash_function;
+    table->bloom.blocks = NULL;
+    table->bloom.block_mask = 0;
+    table->used_slots = 0;
+    table->tombstones = 0;
+    table->next_buckets = NULL;
+    table->next_mask = 0;
+    table->next_tombstones = 0;
+    table->rehashed = 0;
+    return table->buckets ? 0 : -1;
+}
+
+void free_hash_table(HashTable* table) {
+    free(table->buckets);
+    free(table->next_buckets);
+    free(table->group_offsets);
+    free(table->group_ends);
+    free(table->row_ids);
+    free_ndb_bloom_filter(&table->bloom);
+    table->buckets = NULL;
+    table->next_buckets = NULL;
+    table->group_offsets = NULL;
+    table->group_ends = NULL;
+    table->row_ids = NULL;
+    table->bucket_mask = 0;
+    table->count = 0;
+    table->num_rows = 0;
+}
+
+// Place an entry known not to be present yet
+static void place_entry(HashBucket* buckets, uint64_t mask, uint64_t hash,
+                        int key, int group_id) {
+    uint8_t tag = hash_tag(hash);
+    for (uint64_t idx = hash_bucket_index(hash, mask);; idx = (idx + 1) & mask) {
+        HashBucket* bucket = &buckets[idx];
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] == HASH_TAG_EMPTY) {
+                bucket->tags[s] = tag;
+                bucket->keys[s] = key;
+                bucket->group_ids[s] = group_id;
+                return;
+            }
+        }
+    }
+}
+
+// Double the bucket array and re-place every entry
+static int grow_hash_table(HashTable* table) {
+    uint64_t old_buckets = table->bucket_mask + 1;
+    uint64_t new_mask = old_buckets * 2 - 1;
+    HashBucket* buckets = alloc_buckets(old_buckets * 2);
+    if (!buckets) {
+        return -1;
+    }
+
+    // Rehash a whole bucket at once with the bulk kernel
+    for (uint64_t b = 0; b < old_buckets; b++) {
+        HashBucket* bucket = &table->buckets[b];
+        uint64_t hashes[HASH_BUCKET_SLOTS];
+        ndb_hash_keys(table->hash_function, bucket->keys, hashes, HASH_BUCKET_SLOTS);
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] & HASH_TAG_OCCUPIED) {
+                place_entry(buckets, new_mask, hashes[s],
+                            bucket->keys[s], bucket->group_ids[s]);
+            }
+        }
+    }
+
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_mask = new_mask;
+    table->used_slots -= table->tombstones;
+    table->tombstones = 0;
+    return 0;
+}
+
+// Return the group of key, creating a new group when the key is new
+static int find_or_add_group(HashTable* table, int key, uint64_t hash) {
+    uint64_t capacity = (table->bucket_mask + 1) * HASH_BUCKET_SLOTS;
+    if ((uint64_t)(table->count + 1) * HASH_MAX_LOAD_DEN > capacity * HASH_MAX_LOAD_NUM) {
+        if (grow_hash_table(table) != 0) {
+            return -1;
+        }
+    }
+
+    uint8_t tag = hash_tag(hash);
+    uint64_t mask = table->bucket_mask;
+
+    for (uint64_t idx = hash_bucket_index(hash, mask);; idx = (idx + 1) & mask) {
+        HashBucket* bucket = &table->buckets[idx];
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] == HASH_TAG_EMPTY) {
+                bucket->tags[s] = tag;
+                bucket->keys[s] = key;
+                bucket->group_ids[s] = (int32_t)table->count;
+                table->used_slots++;
+                return (int)table->count++;
+            }
+            if (bucket->tags[s] == tag && bucket->keys[s] == key) {
+                return bucket->group_ids[s];
+            }
+        }
+    }
+}
+
+int build_hash_table(HashTable* table, const int32_t* keys, const uint64_t* hashes,
+                     const int32_t* rows, int count) {
+    // group_offsets is sized for the worst case of all-distinct keys
+    int32_t* row_group = (int32_t*)malloc((size_t)(count > 0 ? count : 1) * sizeof(int32_t));
+    int32_t* offsets = (int32_t*)calloc((size_t)count + 1, sizeof(int32_t));
+    int32_t* row_ids = (int32_t*)malloc((size_t)(count > 0 ? count : 1) * sizeof(int32_t));
+    if (!row_group || !offsets || !row_ids) {
+        free(row_group);
+        free(offsets);
+        free(row_ids);
+        return -1;
+    }
+
+    // Pass 1: assign each row to its key group and count group sizes,
+    // hashing the keys a batch at a time unless the caller already did
+    uint64_t batch_hashes[HASH_KERNEL_BATCH];
+    for (int base = 0; base < count; base += HASH_KERNEL_BATCH) {
+        int n = count - base < HASH_KERNEL_BATCH ? count - base : HASH_KERNEL_BATCH;
+        const uint64_t* batch = hashes ? hashes + base : batch_hashes;
+        if (!hashes) {
+            ndb_hash_keys(table->hash_function, keys + base, batch_hashes, n);
+        }
+        for (int j = 0; j < n; j++) {
+            int group = find_or_add_group(table, keys[base + j], batch[j]);
+            if (group < 0) {
+                free(row_group);
+                free(offsets);
+                free(row_ids);
+                return -1;
+            }
+            row_group[base + j] = group;
+            offsets[group + 1]++;
+        }
+    }
+
+    // Pass 2: prefix sum, offsets[g] becomes the first slot of group g
+    int num_groups = (int)table->count;
+    for (int g = 0; g < num_groups; g++) {
+        offsets[g + 1] += offsets[g];
+    }
+
+    // Pass 3: scatter row ids in build order; offsets[g] serves as the write
+    // cursor of group g and is shifted back into place afterwards
+    for (int i = 0; i < count; i++) {
+        row_ids[offsets[row_group[i]]++] = rows ? rows[i] : i;
+    }
+    for (int g = num_groups; g > 0; g--) {
+        offsets[g] = offsets[g - 1];
+    }
+    offsets[0] = 0;
+
+    free(row_group);
+    table->group_offsets = offsets;
+    table->row_ids = row_ids;
+    table->num_rows = count;
+    return 0;
+}
+
+int build_hash_key_set(HashTable* table, const int32_t* keys, const uint64_t* hashes, int count) {
+    uint64_t batch_hashes[HASH_KERNEL_BATCH];
+    for (int base = 0; base < count; base += HASH_KERNEL_BATCH) {
+        int n = count - base < HASH_KERNEL_BATCH ? count - base : HASH_KERNEL_BATCH;
+        const uint64_t* batch = hashes ? hashes + base : batch_hashes;
+        if (!hashes) {
+            ndb_hash_keys(table->hash_function, keys + base, batch_hashes, n);
+        }
+        for (int j = 0; j < n; j++) {
+            if (find_or_add_group(table, keys[base + j], batch[j]) < 0) {
+                return -1;
+            }
+        }
+    }
+    table->num_rows = count;
+    return 0;
+}
+
+int build_hash_table_bloom(HashTable* table) {
+    free_ndb_bloom_filter(&table->bloom);
+    if (init_ndb_bloom_filter(&table->bloom, table->count) != 0) {
+        return -1;
+    }
+    // Rehash a whole bucket at once, as when growing; tombstones may sit
+    // between the keys of a changed table
+    for (uint64_t b = 0; b <= table->bucket_mask; b++) {
+        const HashBucket* bucket = &table->buckets[b];
+        int32_t keys[HASH_BUCKET_SLOTS];
+        uint64_t hashes[HASH_BUCKET_SLOTS];
+        int n = 0;
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] & HASH_TAG_OCCUPIED) {
+                keys[n++] = bucket->keys[s];
+            }
+        }
+        ndb_hash_keys(table->hash_function, keys, hashes, n);
+        add_ndb_bloom_hashes(&table->bloom, hashes, n);
+    }
+    return 0;
+}
+
+// Continue a lookup past the home bucket (only reached when it is full)
+static int lookup_overflow(const HashTable* table, int key, uint64_t hash) {
+    uint8_t tag = hash_tag(hash);
+    uint64_t mask = table->bucket_mask;
+
+    for (uint64_t idx = (hash_bucket_index(hash, mask) + 1) & mask;; idx = (idx + 1) & mask) {
+        const HashBucket* bucket = &table->buckets[idx];
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] == HASH_TAG_EMPTY) {
+                return -1;
+            }
+            if (bucket->tags[s] == tag && bucket->keys[s] == key) {
+                return bucket->group_ids[s];
+            }
+        }
+    }
+}
+
+// Resolve a lookup from the tag-match mask of its home bucket
+static inline int lookup_with_tags(const HashTable* table, int key, uint64_t hash, uint8_t tag_mask) {
+    const HashBucket* home = &table->buckets[hash_bucket_index(hash, table->bucket_mask)];
+    unsigned candidates = tag_mask & 0x7F;
+    while (candidates) {
+        int s = __builtin_ctz(candidates);
+        if (home->keys[s] == key) {
+            return home->group_ids[s];
+        }
+        candidates &= candidates - 1;
+    }
+    // Slots fill in order, so a home bucket with a free slot ends the chain
+    if (tag_mask & 0x80) {
+        return -1;
+    }
+    return lookup_overflow(table, key, hash);
+}
+
+int32_t absent_hash_key(const HashTable* table) {
+    // At most table->count candidates are taken
+    int32_t key = INT32_MIN;
+    while (lookup_hash(table, key) >= 0) {
+        key++;
+    }
+    return key;
+}
+
+// Tag masks of a kernel batch. With a Bloom filter only the keys that pass
+// gather their bucket's tags; the others get a mask that means "absent".
+static void match_batch_tags(const HashTable* table, const uint64_t* hashes, uint8_t* tag_masks, int n) {
+    if (!table->bloom.blocks) {
+        simd_match_bucket_tags(table->buckets, table->bucket_mask, hashes, tag_masks, n);
+        return;
+    }
+    uint64_t pass;
+    uint64_t passed_hashes[HASH_KERNEL_BATCH];
+    uint8_t passed_masks[HASH_KERNEL_BATCH];
+    simd_test_bloom_blocks(table->bloom.blocks, table->bloom.block_mask, hashes, n, &pass);
+    int m = 0;
+    for (uint64_t bits = pass; bits; bits &= bits - 1) {
+        passed_hashes[m++] = hashes[__builtin_ctzll(bits)];
+    }
+    simd_match_bucket_tags(table->buckets, table->bucket_mask, passed_hashes, passed_masks, m);
+    memset(tag_masks, TAG_MASK_ABSENT, n);
+    m = 0;
+    for (uint64_t bits = pass; bits; bits &= bits - 1) {
+        tag_masks[__builtin_ctzll(bits)] = passed_masks[m++];
+    }
+}
+
+int lookup_hash(const HashTable* table, int key) {
+    uint64_t hash = ndb_hash_key(table->hash_function, key);
+    uint8_t tag = hash_tag(hash);
+    uint64_t mask = table->bucket_mask;
+
+    for (uint64_t idx = hash_bucket_index(hash, mask);; idx = (idx + 1) & mask) {
+        const HashBucket* bucket = &table->buckets[idx];
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] == HASH_TAG_EMPTY) {
+                return -1;
+            }
+            if (bucket->tags[s] == tag && bucket->keys[s] == key) {
+                return bucket->group_ids[s];
+            }
+        }
+    }
+}
+
+int probe_hash_batch(const HashTable* table, const int32_t* keys, const uint64_t* hashes, int count,
+                     int left_row_base, int emit_unmatched, HashProbeCursor* cursor,
+                     int32_t* left_rows, int32_t* right_rows, int capacity) {
+    int out = 0;
+
+    // Finish a group that overflowed the previous call
+    if (cursor->group >= 0) {
+        int left_row = left_row_base + cursor->key_idx;
+        int end = hash_group_end(table, cursor->group);
+        int pos = table->group_offsets[cursor->group] + cursor->group_pos;
+        while (pos < end && out < capacity) {
+            left_rows[out] = left_row;
+            right_rows[out] = table->row_ids[pos++];
+            out++;
+        }
+        if (pos < end) {
+            cursor->group_pos = pos - table->group_offsets[cursor->group];
+            return out;
+        }
+        cursor->group = -1;
+        cursor->key_idx++;
+    }
+
+    // Tag-match the keys a kernel batch at a time (hashing them first when
+    // the caller passed no hashes), then resolve each key from its
+    // home-bucket candidates
+    uint64_t batch_hashes[HASH_KERNEL_BATCH];
+    uint8_t tag_masks[HASH_KERNEL_BATCH];
+    while (cursor->key_idx < count && out < capacity) {
+        int base = cursor->key_idx;
+        int n = count - base < HASH_KERNEL_BATCH ? count - base : HASH_KERNEL_BATCH;
+        const uint64_t* batch = hashes ? hashes + base : batch_hashes;
+        if (!hashes) {
+            ndb_hash_keys(table->hash_function, keys + base, batch_hashes, n);
+        }
+        match_batch_tags(table, batch, tag_masks, n);
+
+        for (int j = 0; j < n && out < capacity; j++) {
+            int i = base + j;
+            int group = lookup_with_tags(table, keys[i], batch[j], tag_masks[j]);
+            if (group < 0) {
+                if (emit_unmatched) {
+                    left_rows[out] = left_row_base + i;
+                    right_rows[out] = -1;
+                    out++;
+                }
+                cursor->key_idx++;
+                continue;
+            }
+
+            int pos = table->group_offsets[group];
+            int end = hash_group_end(table, group);
+            while (pos < end && out < capacity) {
+                left_rows[out] = left_row_base + i;
+                right_rows[out] = table->row_ids[pos++];
+                out++;
+            }
+            if (pos < end) {
+                cursor->group = group;
+                cursor->group_pos = pos - table->group_offsets[group];
+                return out;
+            }
+            cursor->key_idx++;
+        }
+    }
+    return out;
+}
+
+int probe_hash_key_set(const HashTable* table, const int32_t* keys, const uint64_t* hashes, int count,
+                       int left_row_base, int anti, int32_t* left_rows) {
+    int out = 0;
+    uint64_t batch_hashes[HASH_KERNEL_BATCH];
+    uint8_t tag_masks[HASH_KERNEL_BATCH];
+    for (int base = 0; base < count; base += HASH_KERNEL_BATCH) {
+        int n = count - base < HASH_KERNEL_BATCH ? count - base : HASH_KERNEL_BATCH;
+        const uint64_t* batch = hashes ? hashes + base : batch_hashes;
+        if (!hashes) {
+            ndb_hash_keys(table->hash_function, keys + base, batch_hashes, n);
+        }
+        match_batch_tags(table, batch, tag_masks, n);
+
+        // Keys are distinct in the table, so the first hit decides; the
+        // write is unconditional and only the cursor depends on the result
+        for (int j = 0; j < n; j++) {
+            int found = lookup_with_tags(table, keys[base + j], batch[j], tag_masks[j]) >= 0;
+            left_rows[out] = left_row_base + base + j;
+            out += found ^ anti;
+        }
+    }
+    return out;
+}
+
+// =================== Maintenance ===================
+
+// Start rehashing once keys and tombstones fill 5/8 of the slots; the
+// rehash is done long before inserts reach HASH_MAX_LOAD
+#define HASH_REHASH_LOAD_NUM 5
+#define HASH_REHASH_LOAD_DEN 8
+
+// Put key in the first empty or tombstone slot of its chain; returns the
+// bucket, *reused = 1 when the slot held a tombstone
+static uint64_t put_key(HashBucket* buckets, uint64_t mask, uint64_t hash, int32_t key, int32_t group,
+                        int* reused) {
+    uint8_t tag = hash_tag(hash);
+    for (uint64_t idx = hash_bucket_index(hash, mask);; idx = (idx + 1) & mask) {
+        HashBucket* bucket = &buckets[idx];
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (!(bucket->tags[s] & HASH_TAG_OCCUPIED)) {
+                *reused = bucket->tags[s] == HASH_TAG_TOMBSTONE;
+                bucket->tags[s] = tag;
+                bucket->keys[s] = key;
+                bucket->group_ids[s] = group;
+                return idx;
+            }
+        }
+    }
+}
+
+// Replace key by a tombstone; returns its group, -1 when absent.
+// *bucket_out = the bucket it was in.
+static int remove_key(HashBucket* buckets, uint64_t mask, uint64_t hash, int32_t key, uint64_t* bucket_out) {
+    uint8_t tag = hash_tag(hash);
+    for (uint64_t idx = hash_bucket_index(hash, mask);; idx = (idx + 1) & mask) {
+        HashBucket* bucket = &buckets[idx];
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] == HASH_TAG_EMPTY) {
+                return -1;
+            }
+            if (bucket->tags[s] == tag && bucket->keys[s] == key) {
+                bucket->tags[s] = HASH_TAG_TOMBSTONE;
+                *bucket_out = idx;
+                return bucket->group_ids[s];
+            }
+        }
+    }
+}
+
+// Move up to count more buckets into next_buckets; the last one switches
+// the table over
+static void rehash_step(HashTable* table, uint64_t count) {
+    uint64_t num_buckets = table->bucket_mask + 1;
+    for (; count > 0 && table->rehashed < num_buckets; count--) {
+        const HashBucket* bucket = &table->buckets[table->rehashed++];
+        uint64_t hashes[HASH_BUCKET_SLOTS];
+        ndb_hash_keys(table->hash_function, bucket->keys, hashes, HASH_BUCKET_SLOTS);
+        for (int s = 0; s < HASH_BUCKET_SLOTS; s++) {
+            if (bucket->tags[s] & HASH_TAG_OCCUPIED) {
+                int reused;
+                put_key(table->next_buckets, table->next_mask, hashes[s], bucket->keys[s], bucket->group_ids[s],
+                        &reused);
+                table->next_tombstones -= reused;
+            }
+        }
+    }
+    if (table->rehashed < num_buckets) {
+        return;
+    }
+    free(table->buckets);
+    table->buckets = table->next_buckets;
+    table->bucket_mask = table->next_mask;
+    table->used_slots -= table->tombstones - table->next_tombstones;
+    table->tombstones = table->next_tombstones;
+    table->next_buckets = NULL;
+    table->next_tombstones = 0;
+    table->rehashed = 0;
+}
+
+// Start a rehash when the slots fill up: to twice the buckets, or the
+// same number when tombstones take most of the room
+static int start_rehash(HashTable* table) {
+    uint64_t capacity = (table->bucket_mask + 1) * HASH_BUCKET_SLOTS;
+    if (table->next_buckets ||
+        (uint64_t)(table->used_slots + 1) * HASH_REHASH_LOAD_DEN <= capacity * HASH_REHASH_LOAD_NUM) {
+        return 0;
+    }
+    uint64_t num_buckets = buckets_for_rows((table->used_slots - table->tombstones + 1) * 2);
+    num_buckets = num_buckets > table->bucket_mask + 1 ? num_buckets : table->bucket_mask + 1;
+    table->next_buckets = alloc_buckets(num_buckets);
+    if (!table->next_buckets) {
+        return -1;
+    }
+    table->next_mask = num_buckets - 1;
+    table->next_tombstones = 0;
+    table->rehashed = 0;
+    return 0;
+}
+
+int insert_hash_key(HashTable* table, int32_t key, uint64_t hash, int32_t group) {
+    if (start_rehash(table) != 0) {
+        return -1;
+    }
+    // A rehash that falls behind is finished here rather than let the
+    // old buckets fill up
+    uint64_t capacity = (table->bucket_mask + 1) * HASH_BUCKET_SLOTS;
+    if (table->next_buckets) {
+        int full = (uint64_t)(table->used_slots + 1) * HASH_MAX_LOAD_DEN > capacity * HASH_MAX_LOAD_NUM;
+        rehash_step(table, full ? table->bucket_mask + 1 : HASH_REHASH_STEP);
+    }
+
+    int reused;
+    uint64_t bucket = put_key(table->buckets, table->bucket_mask, hash, key, group, &reused);
+    table->used_slots += !reused;
+    table->tombstones -= reused;
+    // Keys in buckets already moved must be in the new array too
+    if (table->next_buckets && bucket < table->rehashed) {
+        put_key(table->next_buckets, table->next_mask, hash, key, group, &reused);
+        table->next_tombstones -= reused;
+    }
+    if (table->bloom.blocks) {
+        add_ndb_bloom_hashes(&table->bloom, &hash, 1);
+    }
+    return 0;
+}
+
+int delete_hash_key(HashTable* table, int32_t key, uint64_t hash) {
+    uint64_t bucket;
+    int group = remove_key(table->buckets, table->bucket_mask, hash, key, &bucket);
+    if (group < 0) {
+        return -1;
+    }
+    table->tombstones++;
+    if (table->next_buckets && bucket < table->rehashed) {
+        uint64_t next_bucket;
+        remove_key(table->next_buckets, table->next_mask, hash, key, &next_bucket);
+        table->next_tombstones++;
+    }
+    if (table->next_buckets) {
+        rehash_step(table, HASH_REHASH_STEP);
+    }
+    return group;
+}
+
+static void* copy_array(const void* data, size_t bytes) {
+    void* copy = malloc(bytes > 0 ? bytes : 1);
+    if (copy && bytes > 0) {
+        memcpy(copy, data, bytes);
+    }
+    return copy;
+}
+
+int copy_hash_table(const HashTable* table, HashTable* copy) {
+    if (init_hash_table(copy, 0, table->hash_function) != 0) {
+        return -1;
+    }
+    free(copy->buckets);
+    uint64_t num_buckets = table->bucket_mask + 1;
+    copy->buckets = alloc_buckets(num_buckets);
+    copy->bucket_mask = table->bucket_mask;
+    copy->count = table->count;
+    copy->num_rows = table->num_rows;
+    copy->used_slots = table->used_slots;
+    copy->tombstones = table->tombstones;
+    int keys_only = table->group_offsets == NULL;
+    if (!keys_only) {
+        copy->group_offsets = (int32_t*)copy_array(table->group_offsets, ((size_t)table->count + 1) * sizeof(int32_t));
+        copy->row_ids = (int32_t*)copy_array(table->row_ids, (size_t)table->num_rows * sizeof(int32_t));
+    }
+    if (table->group_ends) {
+        copy->group_ends = (int32_t*)copy_array(table->group_ends, (size_t)table->count * sizeof(int32_t));
+    }
+    if (table->bloom.blocks) {
+        copy->bloom.block_mask = table->bloom.block_mask;
+        size_t bytes = (table->bloom.block_mask + 1) * sizeof(uint64_t);
+        // Aligned as init_ndb_bloom_filter allocates them
+        copy->bloom.blocks = (uint64_t*)aligned_alloc(HASH_BUCKET_ALIGNMENT,
+                                                      bytes > HASH_BUCKET_ALIGNMENT ? bytes : HASH_BUCKET_ALIGNMENT);
+        if (copy->bloom.blocks) {
+            memcpy(copy->bloom.blocks, table->bloom.blocks, bytes);
+        }
+    }
+    if (!copy->buckets || (!keys_only && (!copy->group_offsets || !copy->row_ids)) ||
+        (table->group_ends && !copy->group_ends) || (table->bloom.blocks && !copy->bloom.blocks)) {
+        free_hash_table(copy);
+        return -1;
+    }
+    memcpy(copy->buckets, table->buckets, num_buckets * sizeof(HashBucket));
+    return 0;
+}
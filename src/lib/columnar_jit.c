@@ -0,0 +1,607 @@
+#include "columnar_jit.h"
+#include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+#include "columnar_keys.h"
+#include "memory.h"
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Probe keys per batch and match pairs handed to the kernel at a time;
+// both stay cache resident between probe and kernel
+#define JIT_PROBE_BATCH 1024
+#define JIT_PAIR_CAPACITY 4096
+
+// Argument block of a compiled kernel: write the fixed-width columns of
+// result rows dst_row .. dst_row + count - 1 from the match pairs (rows
+// already reserved, validity bitmaps of nullable outputs present)
+typedef struct {
+    const int32_t* left_rows;
+    const int32_t* right_rows;      // -1 = no match (LEFT JOIN)
+    int64_t count;
+    const NDBArrayC* left_columns;
+    const NDBArrayC* right_columns;
+    NDBArrayC* result_columns;
+    int64_t dst_row;
+} JitBatch;
+
+typedef void (*JitKernel)(const JitBatch* batch);
+
+// One output column of a plan
+typedef struct {
+    int side;
+    int column;
+    int type_id;
+    int src_nullable;       // Source column has a validity bitmap
+    int maybe_null;         // Output can be NULL (nullable source or LEFT JOIN right side)
+} JitColumn;
+
+typedef struct {
+    JoinType join_type;
+    int left_key_column;
+    int right_key_column;
+    int num_columns;
+    JitColumn* columns;
+} JitPlan;
+
+typedef struct {
+    char* signature;
+    JitKernel kernel;
+} JitCacheEntry;
+
+static pthread_once_t jit_once = PTHREAD_ONCE_INIT;
+static LLVMOrcLLJITRef jit = NULL;
+static LLVMTargetMachineRef target_machine = NULL;
+
+// Guards the kernel cache and compilation
+static pthread_mutex_t jit_lock = PTHREAD_MUTEX_INITIALIZER;
+static JitCacheEntry* jit_cache = NULL;
+static int jit_cache_count = 0;
+static int jit_cache_capacity = 0;
+static NDBJitStats jit_stats = {0, 0};
+
+// =================== LLVM setup ===================
+
+static int report_llvm_error(LLVMErrorRef error, const char* what) {
+    if (!error) {
+        return 0;
+    }
+    char* message = LLVMGetErrorMessage(error);
+    fprintf(stderr, "Error: %s: %s\n", what, message);
+    LLVMDisposeErrorMessage(message);
+    return -1;
+}
+
+static void init_jit(void) {
+    if (LLVMInitializeNativeTarget() || LLVMInitializeNativeAsmPrinter()) {
+        fprintf(stderr, "Error: LLVM has no native target, JIT disabled\n");
+        return;
+    }
+
+    // Machine for the IR optimization pipeline, tuned to the host like the
+    // LLJIT default code generator
+    char* triple = LLVMGetDefaultTargetTriple();
+    char* cpu = LLVMGetHostCPUName();
+    char* features = LLVMGetHostCPUFeatures();
+    LLVMTargetRef target;
+    char* message = NULL;
+    if (LLVMGetTargetFromTriple(triple, &target, &message) == 0) {
+        target_machine = LLVMCreateTargetMachine(target, triple, cpu, features,
+                                                 LLVMCodeGenLevelAggressive, LLVMRelocDefault,
+                                                 LLVMCodeModelJITDefault);
+    } else {
+        fprintf(stderr, "Error: LLVM target lookup failed: %s\n", message);
+        LLVMDisposeMessage(message);
+    }
+    LLVMDisposeMessage(triple);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+    if (!target_machine) {
+        return;
+    }
+
+    if (report_llvm_error(LLVMOrcCreateLLJIT(&jit, NULL), "failed to create LLJIT") != 0) {
+        jit = NULL;
+    }
+}
+
+int ndb_jit_available(void) {
+    pthread_once(&jit_once, init_jit);
+    return jit != NULL;
+}
+
+// =================== Kernel code generation ===================
+
+typedef struct {
+    LLVMContextRef ctx;
+    LLVMBuilderRef b;
+    LLVMValueRef fn;
+    LLVMTypeRef i8, i32, i64, i8p, i32p;
+} IrGen;
+
+static LLVMValueRef const_i64(IrGen* g, int64_t v) {
+    return LLVMConstInt(g->i64, (unsigned long long)v, 1);
+}
+
+static LLVMValueRef const_i32(IrGen* g, int32_t v) {
+    return LLVMConstInt(g->i32, (unsigned long long)(int64_t)v, 1);
+}
+
+// Pointer to a field of type `type` at byte offset of base (an i8*)
+static LLVMValueRef field_ptr(IrGen* g, LLVMValueRef base, size_t offset, LLVMTypeRef type) {
+    LLVMValueRef idx = const_i64(g, (int64_t)offset);
+    LLVMValueRef p = LLVMBuildGEP2(g->b, g->i8, base, &idx, 1, "");
+    return LLVMBuildBitCast(g->b, p, LLVMPointerType(type, 0), "");
+}
+
+static LLVMValueRef load_field(IrGen* g, LLVMValueRef base, size_t offset, LLVMTypeRef type) {
+    return LLVMBuildLoad2(g->b, type, field_ptr(g, base, offset, type), "");
+}
+
+static LLVMValueRef element_ptr(IrGen* g, LLVMTypeRef type, LLVMValueRef base, LLVMValueRef idx) {
+    return LLVMBuildGEP2(g->b, type, base, &idx, 1, "");
+}
+
+static LLVMBasicBlockRef new_block(IrGen* g, const char* name) {
+    return LLVMAppendBasicBlockInContext(g->ctx, g->fn, name);
+}
+
+// bit idx of bitmap (i8*), as i1
+static LLVMValueRef bitmap_bit(IrGen* g, LLVMValueRef bitmap, LLVMValueRef idx) {
+    LLVMValueRef byte_idx = LLVMBuildAShr(g->b, idx, const_i64(g, 3), "");
+    LLVMValueRef byte = LLVMBuildLoad2(g->b, g->i8, element_ptr(g, g->i8, bitmap, byte_idx), "");
+    LLVMValueRef shift = LLVMBuildTrunc(g->b, LLVMBuildAnd(g->b, idx, const_i64(g, 7), ""), g->i8, "");
+    LLVMValueRef bit = LLVMBuildAnd(g->b, LLVMBuildLShr(g->b, byte, shift, ""), LLVMConstInt(g->i8, 1, 0), "");
+    return LLVMBuildICmp(g->b, LLVMIntNE, bit, LLVMConstInt(g->i8, 0, 0), "");
+}
+
+// Copy one int32 value, with NULL checks only where the plan needs them
+static void emit_int_column(IrGen* g, const JitPlan* plan, const JitColumn* col,
+                            LLVMValueRef src_array, LLVMValueRef dst_array,
+                            LLVMValueRef row, LLVMValueRef dst) {
+    LLVMValueRef src_values = load_field(g, src_array, offsetof(NDBArrayC, values), g->i32p);
+    LLVMValueRef dst_values = load_field(g, dst_array, offsetof(NDBArrayC, values), g->i32p);
+    LLVMValueRef dst_slot = element_ptr(g, g->i32, dst_values, dst);
+
+    if (!col->maybe_null) {
+        LLVMValueRef v = LLVMBuildLoad2(g->b, g->i32, element_ptr(g, g->i32, src_values, row), "");
+        LLVMBuildStore(g->b, v, dst_slot);
+        return;
+    }
+
+    LLVMBasicBlockRef valid_bb = new_block(g, "valid");
+    LLVMBasicBlockRef null_bb = new_block(g, "null");
+    LLVMBasicBlockRef merge_bb = new_block(g, "merge");
+
+    int check_row = col->side == 1 && plan->join_type == LEFT_JOIN;
+    if (check_row) {
+        LLVMValueRef has_row = LLVMBuildICmp(g->b, LLVMIntSGE, row, const_i64(g, 0), "");
+        if (col->src_nullable) {
+            LLVMBasicBlockRef bit_bb = new_block(g, "check_bit");
+            LLVMBuildCondBr(g->b, has_row, bit_bb, null_bb);
+            LLVMPositionBuilderAtEnd(g->b, bit_bb);
+        } else {
+            LLVMBuildCondBr(g->b, has_row, valid_bb, null_bb);
+        }
+    }
+    if (col->src_nullable) {
+        LLVMValueRef src_validity = load_field(g, src_array, offsetof(NDBArrayC, validity), g->i8p);
+        LLVMBuildCondBr(g->b, bitmap_bit(g, src_validity, row), valid_bb, null_bb);
+    }
+
+    LLVMPositionBuilderAtEnd(g->b, valid_bb);
+    LLVMValueRef v = LLVMBuildLoad2(g->b, g->i32, element_ptr(g, g->i32, src_values, row), "");
+    LLVMBuildStore(g->b, v, dst_slot);
+    LLVMBuildBr(g->b, merge_bb);
+
+    // Result rows start valid; a NULL clears its bit and counts itself
+    LLVMPositionBuilderAtEnd(g->b, null_bb);
+    LLVMBuildStore(g->b, const_i32(g, 0), dst_slot);
+    LLVMValueRef dst_validity = load_field(g, dst_array, offsetof(NDBArrayC, validity), g->i8p);
+    LLVMValueRef byte_ptr = element_ptr(g, g->i8, dst_validity, LLVMBuildAShr(g->b, dst, const_i64(g, 3), ""));
+    LLVMValueRef shift = LLVMBuildTrunc(g->b, LLVMBuildAnd(g->b, dst, const_i64(g, 7), ""), g->i8, "");
+    LLVMValueRef clear = LLVMBuildNot(g->b, LLVMBuildShl(g->b, LLVMConstInt(g->i8, 1, 0), shift, ""), "");
+    LLVMBuildStore(g->b, LLVMBuildAnd(g->b, LLVMBuildLoad2(g->b, g->i8, byte_ptr, ""), clear, ""), byte_ptr);
+    LLVMValueRef null_count = field_ptr(g, dst_array, offsetof(NDBArrayC, null_count), g->i32);
+    LLVMBuildStore(g->b, LLVMBuildAdd(g->b, LLVMBuildLoad2(g->b, g->i32, null_count, ""), const_i32(g, 1), ""),
+                   null_count);
+    LLVMBuildBr(g->b, merge_bb);
+
+    LLVMPositionBuilderAtEnd(g->b, merge_bb);
+}
+
+// void kernel(const JitBatch* batch): one loop over the pairs writing
+// every fixed-width column of a row before moving to the next. String
+// columns are left to the batch gather, which copies runs of rows at once.
+static void emit_kernel(LLVMContextRef ctx, LLVMModuleRef module, const char* name, const JitPlan* plan) {
+    IrGen g;
+    g.ctx = ctx;
+    g.b = LLVMCreateBuilderInContext(ctx);
+    g.i8 = LLVMInt8TypeInContext(ctx);
+    g.i32 = LLVMInt32TypeInContext(ctx);
+    g.i64 = LLVMInt64TypeInContext(ctx);
+    g.i8p = LLVMPointerType(g.i8, 0);
+    g.i32p = LLVMPointerType(g.i32, 0);
+
+    LLVMTypeRef fn_type = LLVMFunctionType(LLVMVoidTypeInContext(ctx), &g.i8p, 1, 0);
+    g.fn = LLVMAddFunction(module, name, fn_type);
+    LLVMValueRef batch = LLVMGetParam(g.fn, 0);
+
+    LLVMBasicBlockRef entry = new_block(&g, "entry");
+    LLVMBasicBlockRef header = new_block(&g, "header");
+    LLVMBasicBlockRef body = new_block(&g, "body");
+    LLVMBasicBlockRef exit = new_block(&g, "exit");
+
+    // Everything invariant is loaded once; mem2reg turns the slots into registers
+    LLVMPositionBuilderAtEnd(g.b, entry);
+    LLVMValueRef k_slot = LLVMBuildAlloca(g.b, g.i64, "k");
+    LLVMBuildStore(g.b, const_i64(&g, 0), k_slot);
+    LLVMValueRef left_rows = load_field(&g, batch, offsetof(JitBatch, left_rows), g.i32p);
+    LLVMValueRef right_rows = load_field(&g, batch, offsetof(JitBatch, right_rows), g.i32p);
+    LLVMValueRef count = load_field(&g, batch, offsetof(JitBatch, count), g.i64);
+    LLVMValueRef left_columns = load_field(&g, batch, offsetof(JitBatch, left_columns), g.i8p);
+    LLVMValueRef right_columns = load_field(&g, batch, offsetof(JitBatch, right_columns), g.i8p);
+    LLVMValueRef result_columns = load_field(&g, batch, offsetof(JitBatch, result_columns), g.i8p);
+    LLVMValueRef dst_row = load_field(&g, batch, offsetof(JitBatch, dst_row), g.i64);
+    LLVMBuildBr(g.b, header);
+
+    LLVMPositionBuilderAtEnd(g.b, header);
+    LLVMValueRef k = LLVMBuildLoad2(g.b, g.i64, k_slot, "");
+    LLVMBuildCondBr(g.b, LLVMBuildICmp(g.b, LLVMIntSLT, k, count, ""), body, exit);
+
+    LLVMPositionBuilderAtEnd(g.b, body);
+    LLVMValueRef dst = LLVMBuildAdd(g.b, dst_row, k, "dst");
+    LLVMValueRef left_row = LLVMBuildSExt(g.b, LLVMBuildLoad2(g.b, g.i32, element_ptr(&g, g.i32, left_rows, k), ""),
+                                          g.i64, "left_row");
+    LLVMValueRef right_row = LLVMBuildSExt(g.b, LLVMBuildLoad2(g.b, g.i32, element_ptr(&g, g.i32, right_rows, k), ""),
+                                           g.i64, "right_row");
+
+    for (int j = 0; j < plan->num_columns; j++) {
+        const JitColumn* col = &plan->columns[j];
+        if (col->type_id != 0) {
+            continue;
+        }
+        LLVMValueRef src_array = field_ptr(&g, col->side ? right_columns : left_columns,
+                                           (size_t)col->column * sizeof(NDBArrayC), g.i8);
+        LLVMValueRef dst_array = field_ptr(&g, result_columns, (size_t)j * sizeof(NDBArrayC), g.i8);
+        emit_int_column(&g, plan, col, src_array, dst_array, col->side ? right_row : left_row, dst);
+    }
+    LLVMBuildStore(g.b, LLVMBuildAdd(g.b, k, const_i64(&g, 1), ""), k_slot);
+    LLVMBuildBr(g.b, header);
+
+    LLVMPositionBuilderAtEnd(g.b, exit);
+    LLVMBuildRetVoid(g.b);
+    LLVMDisposeBuilder(g.b);
+}
+
+static JitKernel compile_kernel(const JitPlan* plan, int kernel_id) {
+    char name[64];
+    snprintf(name, sizeof(name), "ndb_join_kernel_%d", kernel_id);
+
+    LLVMOrcThreadSafeContextRef ts_context = LLVMOrcCreateNewThreadSafeContext();
+    LLVMContextRef ctx = LLVMOrcThreadSafeContextGetContext(ts_context);
+    LLVMModuleRef module = LLVMModuleCreateWithNameInContext(name, ctx);
+    LLVMSetTarget(module, LLVMOrcLLJITGetTripleString(jit));
+    LLVMSetDataLayout(module, LLVMOrcLLJITGetDataLayoutStr(jit));
+
+    emit_kernel(ctx, module, name, plan);
+
+    char* message = NULL;
+    if (LLVMVerifyModule(module, LLVMReturnStatusAction, &message)) {
+        fprintf(stderr, "Error: invalid JIT kernel IR: %s\n", message);
+        LLVMDisposeMessage(message);
+        LLVMDisposeModule(module);
+        LLVMOrcDisposeThreadSafeContext(ts_context);
+        return NULL;
+    }
+    LLVMDisposeMessage(message);
+
+    LLVMPassBuilderOptionsRef pass_options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(module, "default<O3>", target_machine, pass_options);
+    LLVMDisposePassBuilderOptions(pass_options);
+    if (report_llvm_error(error, "JIT kernel optimization failed") != 0) {
+        LLVMDisposeModule(module);
+        LLVMOrcDisposeThreadSafeContext(ts_context);
+        return NULL;
+    }
+
+    // The thread-safe module takes over the module and keeps the context alive
+    LLVMOrcThreadSafeModuleRef ts_module = LLVMOrcCreateNewThreadSafeModule(module, ts_context);
+    LLVMOrcDisposeThreadSafeContext(ts_context);
+    error = LLVMOrcLLJITAddLLVMIRModule(jit, LLVMOrcLLJITGetMainJITDylib(jit), ts_module);
+    if (report_llvm_error(error, "failed to add JIT kernel") != 0) {
+        LLVMOrcDisposeThreadSafeModule(ts_module);
+        return NULL;
+    }
+
+    LLVMOrcExecutorAddress address = 0;
+    if (report_llvm_error(LLVMOrcLLJITLookup(jit, &address, name), "JIT kernel lookup failed") != 0) {
+        return NULL;
+    }
+    return (JitKernel)(uintptr_t)address;
+}
+
+// =================== Plan cache ===================
+
+// Everything the generated code depends on, as a string; string columns
+// are gathered outside the kernel and only their position matters
+static char* plan_signature(const JitPlan* plan) {
+    size_t size = 64 + (size_t)plan->num_columns * 32;
+    char* signature = (char*)malloc(size);
+    if (!signature) {
+        return NULL;
+    }
+    int len = snprintf(signature, size, "j%d k%d,%d p", (int)plan->join_type,
+                       plan->left_key_column, plan->right_key_column);
+    for (int j = 0; j < plan->num_columns; j++) {
+        const JitColumn* col = &plan->columns[j];
+        if (col->type_id != 0) {
+            len += snprintf(signature + len, size - len, " s");
+            continue;
+        }
+        len += snprintf(signature + len, size - len, " %c%d:t%d%s%s", col->side ? 'R' : 'L', col->column,
+                        col->type_id, col->src_nullable ? "n" : "", col->maybe_null ? "?" : "");
+    }
+    return signature;
+}
+
+static JitKernel get_kernel(const JitPlan* plan) {
+    char* signature = plan_signature(plan);
+    if (!signature) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&jit_lock);
+    JitKernel kernel = NULL;
+    for (int i = 0; i < jit_cache_count; i++) {
+        if (strcmp(jit_cache[i].signature, signature) == 0) {
+            kernel = jit_cache[i].kernel;
+            jit_stats.cache_hits++;
+            break;
+        }
+    }
+
+    if (!kernel) {
+        if (jit_cache_count == jit_cache_capacity) {
+            int capacity = jit_cache_capacity ? jit_cache_capacity * 2 : 16;
+            JitCacheEntry* entries = (JitCacheEntry*)realloc(jit_cache, capacity * sizeof(JitCacheEntry));
+            if (entries) {
+                jit_cache = entries;
+                jit_cache_capacity = capacity;
+            }
+        }
+        if (jit_cache_count < jit_cache_capacity) {
+            kernel = compile_kernel(plan, jit_cache_count);
+        }
+        if (kernel) {
+            jit_cache[jit_cache_count].signature = signature;
+            jit_cache[jit_cache_count].kernel = kernel;
+            jit_cache_count++;
+            jit_stats.compiled++;
+            signature = NULL;
+        }
+    }
+    pthread_mutex_unlock(&jit_lock);
+
+    free(signature);
+    return kernel;
+}
+
+void get_ndb_jit_stats(NDBJitStats* stats) {
+    pthread_mutex_lock(&jit_lock);
+    *stats = jit_stats;
+    pthread_mutex_unlock(&jit_lock);
+}
+
+// =================== JIT hash join ===================
+
+static int make_plan(const NDBTableC* left_table, const NDBTableC* right_table,
+                     int left_key_column, int right_key_column, JoinType join_type,
+                     const NDBJitProjection* projections, int num_projections,
+                     const NDBTableC* result_table, JitPlan* plan) {
+    if ((join_type != INNER_JOIN && join_type != LEFT_JOIN) ||
+        left_key_column < 0 || left_key_column >= left_table->num_columns ||
+        right_key_column < 0 || right_key_column >= right_table->num_columns ||
+        left_table->columns[left_key_column].type_id != 0 ||
+        right_table->columns[right_key_column].type_id != 0) {
+        return -1;
+    }
+    if (!projections) {
+        num_projections = left_table->num_columns + right_table->num_columns;
+    }
+    if (num_projections <= 0 || num_projections > result_table->num_columns) {
+        return -1;
+    }
+
+    plan->join_type = join_type;
+    plan->left_key_column = left_key_column;
+    plan->right_key_column = right_key_column;
+    plan->num_columns = num_projections;
+    plan->columns = (JitColumn*)malloc(num_projections * sizeof(JitColumn));
+    if (!plan->columns) {
+        return -1;
+    }
+
+    for (int j = 0; j < num_projections; j++) {
+        JitColumn* col = &plan->columns[j];
+        if (projections) {
+            col->side = projections[j].side;
+            col->column = projections[j].column;
+        } else {
+            col->side = j >= left_table->num_columns;
+            col->column = col->side ? j - left_table->num_columns : j;
+        }
+        const NDBTableC* src = col->side ? right_table : left_table;
+        if (col->side < 0 || col->side > 1 || col->column < 0 || col->column >= src->num_columns) {
+            free(plan->columns);
+            return -1;
+        }
+        col->type_id = src->columns[col->column].type_id;
+        col->src_nullable = src->columns[col->column].validity != NULL;
+        col->maybe_null = col->src_nullable || (col->side == 1 && join_type == LEFT_JOIN);
+        if ((col->type_id != 0 && col->type_id != 1) ||
+            result_table->columns[j].type_id != col->type_id) {
+            free(plan->columns);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int jit_ndb_hash_join(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    JoinType join_type,
+    const NDBJitProjection* projections,
+    int num_projections,
+    NDBTableC* result_table,
+    int* result_row_count,
+    const NDBJoinOptions* options
+) {
+    *result_row_count = 0;
+    if (!ndb_jit_available()) {
+        return -1;
+    }
+
+    JitPlan plan;
+    if (make_plan(left_table, right_table, left_key_column, right_key_column, join_type,
+                  projections, num_projections, result_table, &plan) != 0) {
+        return -1;
+    }
+    JitKernel kernel = get_kernel(&plan);
+
+    // The kernel clears validity bits in place, so bitmaps must exist
+    int status = kernel ? 0 : -1;
+    for (int j = 0; j < plan.num_columns && status == 0; j++) {
+        if (plan.columns[j].type_id == 0 && plan.columns[j].maybe_null &&
+            ensure_ndb_validity(result_table, j) != 0) {
+            status = -1;
+        }
+    }
+
+    // NULL keys match nothing: NULL-key build rows stay out of the table
+    // and NULL-key probe rows look up a key it does not hold
+    uint64_t* left_nulls = NULL;
+    uint64_t* right_nulls = NULL;
+    if (status == 0 &&
+        (find_ndb_null_keys(left_table, &left_key_column, 1, &left_nulls) != 0 ||
+         find_ndb_null_keys(right_table, &right_key_column, 1, &right_nulls) != 0)) {
+        status = -1;
+    }
+
+    // Build right table hash table
+    HashTable table;
+    int32_t* build_keys = NULL;
+    int32_t* build_rows = NULL;
+    int32_t* left_rows = (int32_t*)malloc(JIT_PAIR_CAPACITY * sizeof(int32_t));
+    int32_t* right_rows = (int32_t*)malloc(JIT_PAIR_CAPACITY * sizeof(int32_t));
+    if (status == 0) {
+        build_keys = (int32_t*)malloc((right_table->num_rows > 0 ? right_table->num_rows : 1) * sizeof(int32_t));
+        build_rows = (int32_t*)malloc((right_table->num_rows > 0 ? right_table->num_rows : 1) * sizeof(int32_t));
+        status = build_keys && build_rows && left_rows && right_rows ? 0 : -1;
+    }
+    if (status == 0) {
+        int build_count = right_table->num_rows;
+        if (right_nulls) {
+            build_count = compact_ndb_non_null_keys((const int32_t*)right_table->columns[right_key_column].values,
+                                                    right_nulls, right_table->num_rows, build_keys, build_rows);
+        } else {
+            for (int i = 0; i < right_table->num_rows; i++) {
+                build_keys[i] = get_int_key_from_ndb_column(right_table, right_key_column, i);
+            }
+        }
+        status = init_hash_table(&table, build_count,
+                                 options ? options->hash_function : NDB_HASH_DEFAULT);
+        if (status == 0) {
+            status = build_hash_table(&table, build_keys, NULL, right_nulls ? build_rows : NULL, build_count);
+            if (status != 0) {
+                free_hash_table(&table);
+                fprintf(stderr, "Error: failed to build hash table for %d rows\n", right_table->num_rows);
+            }
+        }
+    }
+    free(build_keys);
+    free(build_rows);
+    free(right_nulls);
+    if (status != 0) {
+        free(plan.columns);
+        free(left_nulls);
+        free(left_rows);
+        free(right_rows);
+        return -1;
+    }
+    int32_t absent_key = left_nulls ? absent_hash_key(&table) : 0;
+
+    // Probe a batch, then write its matches while they are hot: the kernel
+    // does the fixed-width columns, the batch gather the strings
+    JitBatch batch = {
+        .left_rows = left_rows,
+        .right_rows = right_rows,
+        .left_columns = left_table->columns,
+        .right_columns = right_table->columns,
+        .result_columns = result_table->columns,
+    };
+    int key_batch[JIT_PROBE_BATCH];
+    uint64_t hash_batch[JIT_PROBE_BATCH];
+    int64_t dst_row = 0;
+    int emit_unmatched = join_type == LEFT_JOIN;
+
+    for (int start = 0; start < left_table->num_rows && status == 0; start += JIT_PROBE_BATCH) {
+        int n = left_table->num_rows - start < JIT_PROBE_BATCH ? left_table->num_rows - start : JIT_PROBE_BATCH;
+        vectorized_get_ndb_keys(left_table, left_key_column, key_batch, start, n);
+        if (left_nulls) {
+            mask_ndb_null_keys(key_batch, left_nulls, start, n, absent_key);
+        }
+        ndb_hash_keys(table.hash_function, key_batch, hash_batch, n);
+
+        HashProbeCursor cursor;
+        init_hash_probe_cursor(&cursor);
+        while (cursor.key_idx < n && status == 0) {
+            int pairs = probe_hash_batch(&table, key_batch, hash_batch, n, start, emit_unmatched,
+                                         &cursor, left_rows, right_rows, JIT_PAIR_CAPACITY);
+            if (dst_row + pairs > INT32_MAX - 1 ||
+                reserve_ndb_table_rows(result_table, (int)(dst_row + pairs)) != 0) {
+                status = -1;
+                break;
+            }
+            batch.count = pairs;
+            batch.dst_row = dst_row;
+            kernel(&batch);
+            for (int j = 0; j < plan.num_columns && status == 0; j++) {
+                const JitColumn* col = &plan.columns[j];
+                if (col->type_id != 0) {
+                    status = gather_ndb_column(col->side ? right_table : left_table, col->column,
+                                               col->side ? right_rows : left_rows, pairs,
+                                               result_table, j, (int)dst_row);
+                }
+            }
+            dst_row += pairs;
+        }
+    }
+    free_hash_table(&table);
+    free(plan.columns);
+    free(left_nulls);
+    free(left_rows);
+    free(right_rows);
+
+    if (status != 0) {
+        fprintf(stderr, "Error: failed to materialize JIT join output\n");
+    }
+    if (result_table->num_rows < dst_row) {
+        result_table->num_rows = (int32_t)dst_row;
+    }
+    *result_row_count = (int)dst_row;
+    return 0;
+}
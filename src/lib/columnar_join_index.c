@@ -0,0 +1,822 @@
+#include "columnar_join_index.h"
+#include "columnar_hashtable.h"
+#include "columnar_keys.h"
+#include "columnar_types.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+struct NDBJoinIndex {
+    const NDBTableC* table;
+    int* key_columns;
+    int num_key_columns;
+    HashTable hash_table;
+    int direct;                 // One int32 column, read in place
+    int32_t key_type_id;        // Type of that column
+    NDBKeyEncoder* encoder;     // Codes of the keys when not direct
+    int32_t absent_key;         // Probed in place of a NULL key
+    int loaded;                 // hash_table lives in a loaded image
+    int64_t rows;               // Rows indexed
+
+    // Set up by the first change: the groups get room to grow in row_ids
+    // and hash_table->group_ends marks where their rows end
+    int changing;
+    int32_t* group_limits;      // End of the room of each group
+    int64_t group_capacity;     // Entries of the group arrays
+    int64_t row_capacity;       // Entries of row_ids
+    int32_t* free_groups;       // Groups left without rows, reused first
+    int64_t num_free_groups;
+    int64_t unused_rows;        // row_ids entries left behind by groups that moved
+    uint64_t* dropped;          // Rows deleted from the index, NULL = none yet
+    int64_t dropped_words;
+};
+
+// Slots of NDBJoinIndexImage.scalars and .arrays
+enum {
+    IMAGE_TABLE_ROWS,
+    IMAGE_NUM_KEY_COLUMNS,
+    IMAGE_ENCODED,
+    IMAGE_KEY_TYPE,
+    IMAGE_ABSENT_KEY,
+    IMAGE_HASH_FUNCTION,
+    IMAGE_BUCKET_MASK,
+    IMAGE_GROUPS,
+    IMAGE_ROWS,
+    IMAGE_BLOOM_MASK,
+    IMAGE_PACKED,
+    IMAGE_CODES,
+    IMAGE_SLOT_MASK,
+    IMAGE_USED_SLOTS,
+    IMAGE_TOMBSTONES,
+    IMAGE_INDEXED_ROWS
+};
+
+enum {
+    IMAGE_KEY_COLUMNS,
+    IMAGE_BUCKETS,
+    IMAGE_GROUP_OFFSETS,
+    IMAGE_ROW_IDS,
+    IMAGE_BLOOM_BLOCKS,
+    IMAGE_WIDTHS,
+    IMAGE_SLOTS,
+    IMAGE_PACKED_KEYS,
+    IMAGE_KEY_OFFSETS,
+    IMAGE_KEY_BYTES,
+    IMAGE_GROUP_ENDS,
+    IMAGE_DROPPED
+};
+
+static int valid_key_columns(const NDBTableC* table, const int* key_columns, int num_key_columns) {
+    for (int k = 0; k < num_key_columns; k++) {
+        if (key_columns[k] < 0 || key_columns[k] >= table->num_columns) {
+            return 0;
+        }
+    }
+    return num_key_columns > 0;
+}
+
+// One int32 column other than dictionary codes joins on its values;
+// dictionary codes would only compare within one dictionary
+static int direct_key(const NDBTableC* table, const int* key_columns, int num_key_columns) {
+    if (num_key_columns != 1) {
+        return 0;
+    }
+    const NDBTypeInfo* info = ndb_type_info(table->columns[key_columns[0]].type_id);
+    return info && info->int32_key && table->columns[key_columns[0]].type_id != NDB_TYPE_DICT_STRING;
+}
+
+static NDBJoinIndex* new_index(const NDBTableC* table, const int* key_columns, int num_key_columns) {
+    if (!valid_key_columns(table, key_columns, num_key_columns)) {
+        fprintf(stderr, "Error: bad index key columns\n");
+        return NULL;
+    }
+    NDBJoinIndex* index = (NDBJoinIndex*)calloc(1, sizeof(NDBJoinIndex));
+    if (!index) {
+        return NULL;
+    }
+    index->table = table;
+    index->num_key_columns = num_key_columns;
+    index->key_columns = (int*)malloc(num_key_columns * sizeof(int));
+    if (!index->key_columns) {
+        free(index);
+        return NULL;
+    }
+    memcpy(index->key_columns, key_columns, num_key_columns * sizeof(int));
+    index->direct = direct_key(table, key_columns, num_key_columns);
+    index->key_type_id = index->direct ? table->columns[key_columns[0]].type_id : -1;
+    return index;
+}
+
+// Insert the non-NULL keys of rows[0..count) (NULL = every row); keys
+// holds the key of every row of the table
+static int build_index_table(NDBJoinIndex* index, const int32_t* keys, const int32_t* rows, int count) {
+    const NDBTableC* table = index->table;
+    uint64_t* nulls = NULL;
+    if (find_ndb_null_keys(table, index->key_columns, index->num_key_columns, &nulls) != 0) {
+        return -1;
+    }
+    int32_t* build_keys = NULL;
+    int32_t* build_rows = NULL;
+    if (nulls || rows) {
+        build_keys = (int32_t*)malloc((count > 0 ? count : 1) * sizeof(int32_t));
+        build_rows = (int32_t*)malloc((count > 0 ? count : 1) * sizeof(int32_t));
+        if (!build_keys || !build_rows) {
+            free(build_keys);
+            free(build_rows);
+            free(nulls);
+            return -1;
+        }
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            int row = rows ? rows[i] : i;
+            if (!nulls || !((nulls[row >> 6] >> (row & 63)) & 1)) {
+                build_keys[n] = keys[row];
+                build_rows[n++] = row;
+            }
+        }
+        count = n;
+        keys = build_keys;
+    }
+    int status = build_hash_table(&index->hash_table, keys, NULL, build_rows, count);
+    index->rows = count;
+    free(build_keys);
+    free(build_rows);
+    free(nulls);
+    return status;
+}
+
+// Hash rows[0..count) of the table (NULL = every row) into the empty index
+static int build_index(NDBJoinIndex* index, const int32_t* rows, int count, NDBHashFunction hash_function,
+                       int bloom_filter) {
+    const NDBTableC* table = index->table;
+    if (init_hash_table(&index->hash_table, rows ? count : table->num_rows, hash_function) != 0) {
+        fprintf(stderr, "Error: failed to allocate hash table for %d rows\n", table->num_rows);
+        return -1;
+    }
+    int status;
+    if (index->direct) {
+        status = build_index_table(index, (const int32_t*)table->columns[index->key_columns[0]].values,
+                                   rows, rows ? count : table->num_rows);
+    } else {
+        // Composite and non-int32 keys: the encoder keeps the codes
+        int32_t* codes = (int32_t*)malloc((table->num_rows > 0 ? table->num_rows : 1) * sizeof(int32_t));
+        index->encoder = codes ? create_ndb_key_encoder(table, index->key_columns, index->num_key_columns, codes)
+                               : NULL;
+        status = index->encoder ? build_index_table(index, codes, rows, rows ? count : table->num_rows) : -1;
+        free(codes);
+    }
+    if (status == 0 && bloom_filter) {
+        status = build_hash_table_bloom(&index->hash_table);
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error: failed to build hash table for %d rows\n", table->num_rows);
+        return -1;
+    }
+    index->absent_key = absent_hash_key(&index->hash_table);
+    return 0;
+}
+
+NDBJoinIndex* create_ndb_join_index(const NDBTableC* table, const int* key_columns, int num_key_columns,
+                                    const NDBJoinOptions* options) {
+    NDBJoinOptions defaults;
+    if (!options) {
+        init_ndb_join_options(&defaults);
+        options = &defaults;
+    }
+    NDBJoinIndex* index = new_index(table, key_columns, num_key_columns);
+    if (index && build_index(index, NULL, 0, options->hash_function, options->bloom_filter > 0) != 0) {
+        free_ndb_join_index(index);
+        return NULL;
+    }
+    return index;
+}
+
+// Free what the index holds, leaving the key columns
+static void free_index_contents(NDBJoinIndex* index) {
+    if (!index->loaded) {
+        free_hash_table(&index->hash_table);
+    }
+    free_ndb_key_encoder(index->encoder);
+    if (!index->loaded) {
+        free(index->dropped);
+    }
+    free(index->group_limits);
+    free(index->free_groups);
+    index->dropped = NULL;
+    index->encoder = NULL;
+    index->group_limits = NULL;
+    index->free_groups = NULL;
+}
+
+void free_ndb_join_index(NDBJoinIndex* index) {
+    if (!index) {
+        return;
+    }
+    free_index_contents(index);
+    free(index->key_columns);
+    free(index);
+}
+
+const NDBTableC* ndb_join_index_table(const NDBJoinIndex* index) {
+    return index->table;
+}
+
+int ndb_join_index_key_columns(const NDBJoinIndex* index, const int** key_columns) {
+    *key_columns = index->key_columns;
+    return index->num_key_columns;
+}
+
+const HashTable* ndb_join_index_hash_table(const NDBJoinIndex* index) {
+    return &index->hash_table;
+}
+
+const uint64_t* ndb_join_index_dropped_rows(const NDBJoinIndex* index, int64_t* num_words) {
+    *num_words = index->dropped_words;
+    return index->dropped;
+}
+
+int ndb_join_index_probe_keys(const NDBJoinIndex* index, const NDBTableC* batch, const int* key_columns,
+                              int32_t* buffer, const int32_t** keys) {
+    if (!valid_key_columns(batch, key_columns, index->num_key_columns) ||
+        (index->direct && batch->columns[key_columns[0]].type_id != index->key_type_id)) {
+        fprintf(stderr, "Error: probe key columns do not pair with the index keys\n");
+        return -1;
+    }
+    uint64_t* nulls = NULL;
+    if (find_ndb_null_keys(batch, key_columns, index->num_key_columns, &nulls) != 0) {
+        return -1;
+    }
+    *keys = (const int32_t*)batch->columns[key_columns[0]].values;
+    if (index->encoder) {
+        if (encode_ndb_left_keys(index->encoder, batch, key_columns, buffer) != 0) {
+            free(nulls);
+            return -1;
+        }
+        *keys = buffer;
+    } else if (nulls) {
+        memcpy(buffer, *keys, (size_t)batch->num_rows * sizeof(int32_t));
+        *keys = buffer;
+    }
+    if (nulls) {
+        mask_ndb_null_keys(buffer, nulls, 0, batch->num_rows, index->absent_key);
+    }
+    free(nulls);
+    return 0;
+}
+
+// =================== Maintenance ===================
+
+// Start tracking group ends and room, in memory of the index's own
+static int begin_changes(NDBJoinIndex* index) {
+    if (index->changing) {
+        return 0;
+    }
+    HashTable* table = &index->hash_table;
+    if (index->loaded) {
+        HashTable copy;
+        size_t dropped_bytes = (size_t)index->dropped_words * sizeof(uint64_t);
+        uint64_t* dropped = dropped_bytes ? (uint64_t*)malloc(dropped_bytes) : NULL;
+        if ((dropped_bytes && !dropped) || copy_hash_table(table, &copy) != 0) {
+            free(dropped);
+            return -1;
+        }
+        if (index->encoder && own_ndb_key_encoder(index->encoder) != 0) {
+            free(dropped);
+            free_hash_table(&copy);
+            return -1;
+        }
+        if (dropped) {
+            memcpy(dropped, index->dropped, dropped_bytes);
+        }
+        *table = copy;
+        index->dropped = dropped;
+        index->loaded = 0;
+    }
+
+    int64_t groups = table->count;
+    int64_t group_capacity = groups > 16 ? groups : 16;
+    int64_t row_capacity = table->num_rows > 16 ? table->num_rows : 16;
+    int32_t* offsets = (int32_t*)realloc(table->group_offsets, (group_capacity + 1) * sizeof(int32_t));
+    if (offsets) {
+        table->group_offsets = offsets;
+    }
+    int32_t* row_ids = (int32_t*)realloc(table->row_ids, row_capacity * sizeof(int32_t));
+    if (row_ids) {
+        table->row_ids = row_ids;
+    }
+    int32_t* ends = (int32_t*)malloc(group_capacity * sizeof(int32_t));
+    int32_t* limits = (int32_t*)malloc(group_capacity * sizeof(int32_t));
+    int32_t* free_groups = (int32_t*)malloc(group_capacity * sizeof(int32_t));
+    if (!offsets || !row_ids || !ends || !limits || !free_groups) {
+        free(ends);
+        free(limits);
+        free(free_groups);
+        return -1;
+    }
+    // A loaded index may already have ends, and groups without rows
+    index->num_free_groups = 0;
+    for (int64_t g = 0; g < groups; g++) {
+        ends[g] = hash_group_end(table, (int)g);
+        limits[g] = ends[g];
+        if (ends[g] == offsets[g]) {
+            free_groups[index->num_free_groups++] = (int32_t)g;
+        }
+    }
+    free(table->group_ends);
+    table->group_ends = ends;
+    index->group_limits = limits;
+    index->free_groups = free_groups;
+    index->group_capacity = group_capacity;
+    index->row_capacity = row_capacity;
+    index->unused_rows = 0;
+    index->changing = 1;
+    return 0;
+}
+
+// Group for a new key: a group left without rows, or a new one
+static int new_group(NDBJoinIndex* index) {
+    HashTable* table = &index->hash_table;
+    if (index->num_free_groups > 0) {
+        return index->free_groups[--index->num_free_groups];
+    }
+    if (table->count == index->group_capacity) {
+        int64_t capacity = index->group_capacity * 2;
+        if (capacity > INT32_MAX) {
+            return -1;
+        }
+        int32_t* offsets = (int32_t*)realloc(table->group_offsets, (capacity + 1) * sizeof(int32_t));
+        if (offsets) {
+            table->group_offsets = offsets;
+        }
+        int32_t* ends = (int32_t*)realloc(table->group_ends, capacity * sizeof(int32_t));
+        if (ends) {
+            table->group_ends = ends;
+        }
+        int32_t* limits = (int32_t*)realloc(index->group_limits, capacity * sizeof(int32_t));
+        if (limits) {
+            index->group_limits = limits;
+        }
+        int32_t* free_groups = (int32_t*)realloc(index->free_groups, capacity * sizeof(int32_t));
+        if (free_groups) {
+            index->free_groups = free_groups;
+        }
+        if (!offsets || !ends || !limits || !free_groups) {
+            return -1;
+        }
+        index->group_capacity = capacity;
+    }
+    int group = (int)table->count++;
+    table->group_offsets[group] = table->num_rows;
+    table->group_ends[group] = table->num_rows;
+    index->group_limits[group] = table->num_rows;
+    table->group_offsets[table->count] = table->num_rows;
+    return group;
+}
+
+// Append row to its group, moving the group to the end of row_ids with
+// twice the room when it is full
+static int append_group_row(NDBJoinIndex* index, int group, int32_t row) {
+    HashTable* table = &index->hash_table;
+    int32_t* ends = table->group_ends;
+    int32_t* limits = index->group_limits;
+    if (ends[group] == limits[group]) {
+        int32_t start = table->group_offsets[group];
+        int32_t size = ends[group] - start;
+        int32_t room = size > 2 ? size * 2 : 4;
+        // The last group grows where it is
+        int at_end = limits[group] == table->num_rows;
+        int64_t needed = (int64_t)table->num_rows + (at_end ? room - (limits[group] - start) : room);
+        if (needed > index->row_capacity) {
+            int64_t capacity = index->row_capacity * 2 > needed ? index->row_capacity * 2 : needed;
+            int32_t* row_ids = capacity <= INT32_MAX ? (int32_t*)realloc(table->row_ids, capacity * sizeof(int32_t))
+                                                     : NULL;
+            if (!row_ids) {
+                return -1;
+            }
+            table->row_ids = row_ids;
+            index->row_capacity = capacity;
+        }
+        if (!at_end) {
+            memcpy(table->row_ids + table->num_rows, table->row_ids + start, size * sizeof(int32_t));
+            index->unused_rows += limits[group] - start;
+            table->group_offsets[group] = table->num_rows;
+            ends[group] = table->num_rows + size;
+        }
+        limits[group] = table->group_offsets[group] + room;
+        table->num_rows = (int32_t)needed;
+        table->group_offsets[table->count] = table->num_rows;
+    }
+    table->row_ids[ends[group]++] = row;
+    return 0;
+}
+
+// Remove row from its group, keeping the others in order; returns 1 when
+// the group has no rows left, -1 when row is not in it
+static int remove_group_row(NDBJoinIndex* index, int group, int32_t row) {
+    HashTable* table = &index->hash_table;
+    int32_t* rows = table->row_ids;
+    int32_t end = table->group_ends[group];
+    for (int32_t pos = table->group_offsets[group]; pos < end; pos++) {
+        if (rows[pos] == row) {
+            memmove(rows + pos, rows + pos + 1, (end - pos - 1) * sizeof(int32_t));
+            table->group_ends[group] = end - 1;
+            return end - 1 == table->group_offsets[group];
+        }
+    }
+    return -1;
+}
+
+static int compare_rows(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Build the index anew over the rows it holds plus extra_rows
+static int rebuild_index(NDBJoinIndex* index, const int32_t* extra_rows, int num_extra) {
+    const HashTable* table = &index->hash_table;
+    int32_t* rows = (int32_t*)malloc(((size_t)table->num_rows + num_extra + 1) * sizeof(int32_t));
+    if (!rows) {
+        return -1;
+    }
+    int64_t count = 0;
+    for (int64_t g = 0; g < table->count; g++) {
+        int32_t end = hash_group_end(table, (int)g);
+        for (int32_t pos = table->group_offsets[g]; pos < end; pos++) {
+            rows[count++] = table->row_ids[pos];
+        }
+    }
+    if (num_extra > 0) {
+        memcpy(rows + count, extra_rows, num_extra * sizeof(int32_t));
+        count += num_extra;
+    }
+    // Rows in table order, as a build from scratch has them
+    qsort(rows, count, sizeof(int32_t), compare_rows);
+
+    NDBJoinIndex fresh = *index;
+    fresh.encoder = NULL;
+    fresh.loaded = 0;
+    fresh.changing = 0;
+    fresh.group_limits = NULL;
+    fresh.free_groups = NULL;
+    fresh.num_free_groups = 0;
+    fresh.unused_rows = 0;
+    int status = build_index(&fresh, rows, (int)count, table->hash_function, table->bloom.blocks != NULL);
+    free(rows);
+    // The rows dropped stay dropped
+    if (status != 0) {
+        fresh.dropped = NULL;
+        free_index_contents(&fresh);
+        return -1;
+    }
+    index->dropped = NULL;
+    free_index_contents(index);
+    *index = fresh;
+    return 0;
+}
+
+// Keys of rows[0..count) as the hash table holds them, -1 in *null for
+// rows with a NULL key. Returns 1 when the encoder cannot take the keys.
+static int row_keys(NDBJoinIndex* index, const int32_t* rows, int count, int add, int32_t* keys, uint8_t* null) {
+    const NDBTableC* table = index->table;
+    for (int i = 0; i < count; i++) {
+        null[i] = 0;
+        for (int k = 0; k < index->num_key_columns && !null[i]; k++) {
+            null[i] = (uint8_t)is_ndb_value_null(table, index->key_columns[k], rows[i]);
+        }
+    }
+    if (index->encoder) {
+        return encode_ndb_right_rows(index->encoder, rows, count, add, keys);
+    }
+    const int32_t* values = (const int32_t*)table->columns[index->key_columns[0]].values;
+    for (int i = 0; i < count; i++) {
+        keys[i] = values[rows[i]];
+    }
+    return 0;
+}
+
+static int valid_rows(const NDBJoinIndex* index, const int32_t* rows, int count) {
+    for (int i = 0; i < count; i++) {
+        if (rows[i] < 0 || rows[i] >= index->table->num_rows) {
+            fprintf(stderr, "Error: row %d is not a row of the indexed table\n", rows[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Key buffers of a change of count rows
+static int change_buffers(int count, int32_t** keys, uint8_t** null) {
+    *keys = (int32_t*)malloc((count > 0 ? count : 1) * sizeof(int32_t));
+    *null = (uint8_t*)malloc(count > 0 ? count : 1);
+    if (!*keys || !*null) {
+        free(*keys);
+        free(*null);
+        return -1;
+    }
+    return 0;
+}
+
+// Mark rows as deleted from the index (drop = 1) or back in it
+static int mark_dropped_rows(NDBJoinIndex* index, const int32_t* rows, int count, int drop) {
+    int64_t words = ((int64_t)index->table->num_rows + 63) / 64;
+    if (drop && words > index->dropped_words) {
+        uint64_t* dropped = (uint64_t*)realloc(index->dropped, words * sizeof(uint64_t));
+        if (!dropped) {
+            return -1;
+        }
+        memset(dropped + index->dropped_words, 0, (words - index->dropped_words) * sizeof(uint64_t));
+        index->dropped = dropped;
+        index->dropped_words = words;
+    }
+    for (int i = 0; i < count; i++) {
+        int row = rows[i];
+        if ((row >> 6) < index->dropped_words) {
+            uint64_t bit = 1ULL << (row & 63);
+            index->dropped[row >> 6] = drop ? index->dropped[row >> 6] | bit : index->dropped[row >> 6] & ~bit;
+        }
+    }
+    return 0;
+}
+
+// Compact row_ids once moved groups left more behind than is in use
+#define INDEX_COMPACT_MIN_ROWS 4096
+
+int insert_ndb_join_index_rows(NDBJoinIndex* index, const int32_t* rows, int count) {
+    int32_t* keys;
+    uint8_t* null;
+    if (!valid_rows(index, rows, count) || begin_changes(index) != 0 || change_buffers(count, &keys, &null) != 0) {
+        return -1;
+    }
+    int status = mark_dropped_rows(index, rows, count, 0);
+    status = status == 0 ? row_keys(index, rows, count, 1, keys, null) : -1;
+    if (status == 1) {
+        // A key longer than the packed layout allows: code everything anew
+        free(keys);
+        free(null);
+        return rebuild_index(index, rows, count);
+    }
+    HashTable* table = &index->hash_table;
+    for (int i = 0; i < count && status == 0; i++) {
+        if (null[i]) {
+            continue;
+        }
+        int group = lookup_hash(table, keys[i]);
+        if (group < 0) {
+            group = new_group(index);
+            status = group < 0 ? -1 : insert_hash_key(table, keys[i], ndb_hash_key(table->hash_function, keys[i]),
+                                                      group);
+        }
+        if (status == 0) {
+            status = append_group_row(index, group, rows[i]);
+            index->rows += status == 0;
+        }
+    }
+    free(keys);
+    free(null);
+    if (status != 0) {
+        fprintf(stderr, "Error: out of memory inserting into a join index\n");
+        return -1;
+    }
+    if (lookup_hash(table, index->absent_key) >= 0) {
+        index->absent_key = absent_hash_key(table);
+    }
+    if (index->unused_rows > INDEX_COMPACT_MIN_ROWS && index->unused_rows > index->rows) {
+        return compact_ndb_join_index(index);
+    }
+    return 0;
+}
+
+int delete_ndb_join_index_rows(NDBJoinIndex* index, const int32_t* rows, int count) {
+    int32_t* keys;
+    uint8_t* null;
+    if (!valid_rows(index, rows, count) || begin_changes(index) != 0 || change_buffers(count, &keys, &null) != 0) {
+        return -1;
+    }
+    int status = mark_dropped_rows(index, rows, count, 1) == 0 && row_keys(index, rows, count, 0, keys, null) == 0
+                 ? 0 : -1;
+    HashTable* table = &index->hash_table;
+    for (int i = 0; i < count && status == 0; i++) {
+        int group = null[i] ? -1 : lookup_hash(table, keys[i]);
+        int emptied = group >= 0 ? remove_group_row(index, group, rows[i]) : -1;
+        index->rows -= emptied >= 0;
+        if (emptied == 1) {
+            delete_hash_key(table, keys[i], ndb_hash_key(table->hash_function, keys[i]));
+            index->free_groups[index->num_free_groups++] = group;
+        }
+    }
+    free(keys);
+    free(null);
+    return status;
+}
+
+// Pairs apply in order: a run of them is one delete and one insert, cut
+// before a pair whose old row a pair of the run created
+int update_ndb_join_index_rows(NDBJoinIndex* index, const int32_t* old_rows, const int32_t* new_rows, int count) {
+    if (!valid_rows(index, old_rows, count) || !valid_rows(index, new_rows, count)) {
+        return -1;
+    }
+    uint64_t* created = count > 1 ? (uint64_t*)calloc(((size_t)index->table->num_rows + 63) / 64, sizeof(uint64_t))
+                                  : NULL;
+    if (count > 1 && !created) {
+        fprintf(stderr, "Error: out of memory updating a join index\n");
+        return -1;
+    }
+    int status = 0;
+    int start = 0;
+    for (int i = 0; i <= count && status == 0; i++) {
+        int chained = i < count && created && (created[old_rows[i] >> 6] >> (old_rows[i] & 63) & 1);
+        if ((i == count || chained) && i > start) {
+            status = delete_ndb_join_index_rows(index, old_rows + start, i - start) == 0 &&
+                     insert_ndb_join_index_rows(index, new_rows + start, i - start) == 0 ? 0 : -1;
+            for (int j = start; created && j < i; j++) {
+                created[new_rows[j] >> 6] &= ~(1ULL << (new_rows[j] & 63));
+            }
+            start = i;
+        }
+        if (i < count && created) {
+            created[new_rows[i] >> 6] |= 1ULL << (new_rows[i] & 63);
+        }
+    }
+    free(created);
+    return status;
+}
+
+int compact_ndb_join_index(NDBJoinIndex* index) {
+    if (begin_changes(index) != 0) {
+        return -1;
+    }
+    return rebuild_index(index, NULL, 0);
+}
+
+void get_ndb_join_index_stats(const NDBJoinIndex* index, NDBJoinIndexStats* stats) {
+    const HashTable* table = &index->hash_table;
+    stats->keys = table->used_slots - table->tombstones;
+    stats->rows = index->rows;
+    stats->tombstones = table->tombstones;
+    stats->unused_rows = index->changing ? index->unused_rows : 0;
+    stats->rehashing = table->next_buckets != NULL;
+}
+
+// =================== Storage ===================
+
+static void set_image_array(NDBJoinIndexImage* image, int slot, const void* data, uint64_t bytes) {
+    image->arrays[slot] = bytes ? data : NULL;
+    image->bytes[slot] = bytes;
+}
+
+void get_ndb_join_index_image(const NDBJoinIndex* index, NDBJoinIndexImage* image) {
+    const HashTable* table = &index->hash_table;
+    memset(image, 0, sizeof(*image));
+    image->scalars[IMAGE_TABLE_ROWS] = index->table->num_rows;
+    image->scalars[IMAGE_NUM_KEY_COLUMNS] = index->num_key_columns;
+    image->scalars[IMAGE_ENCODED] = index->encoder != NULL;
+    image->scalars[IMAGE_KEY_TYPE] = index->key_type_id;
+    image->scalars[IMAGE_ABSENT_KEY] = index->absent_key;
+    image->scalars[IMAGE_HASH_FUNCTION] = table->hash_function;
+    image->scalars[IMAGE_BUCKET_MASK] = (int64_t)table->bucket_mask;
+    image->scalars[IMAGE_GROUPS] = table->count;
+    image->scalars[IMAGE_ROWS] = table->num_rows;
+    image->scalars[IMAGE_BLOOM_MASK] = (int64_t)table->bloom.block_mask;
+    image->scalars[IMAGE_USED_SLOTS] = table->used_slots;
+    image->scalars[IMAGE_TOMBSTONES] = table->tombstones;
+    image->scalars[IMAGE_INDEXED_ROWS] = index->rows;
+    set_image_array(image, IMAGE_KEY_COLUMNS, index->key_columns, index->num_key_columns * sizeof(int));
+    set_image_array(image, IMAGE_BUCKETS, table->buckets, (table->bucket_mask + 1) * sizeof(HashBucket));
+    set_image_array(image, IMAGE_GROUP_OFFSETS, table->group_offsets, ((uint64_t)table->count + 1) * sizeof(int32_t));
+    set_image_array(image, IMAGE_ROW_IDS, table->row_ids, (uint64_t)table->num_rows * sizeof(int32_t));
+    // A changed index keeps its room; a rehash under way is dropped, the
+    // old buckets still hold every key
+    if (table->group_ends) {
+        set_image_array(image, IMAGE_GROUP_ENDS, table->group_ends, (uint64_t)table->count * sizeof(int32_t));
+    }
+    if (index->dropped) {
+        set_image_array(image, IMAGE_DROPPED, index->dropped, (uint64_t)index->dropped_words * sizeof(uint64_t));
+    }
+    if (table->bloom.blocks) {
+        set_image_array(image, IMAGE_BLOOM_BLOCKS, table->bloom.blocks,
+                        (table->bloom.block_mask + 1) * sizeof(uint64_t));
+    }
+    if (index->encoder) {
+        NDBKeyEncoderImage keys;
+        get_ndb_key_encoder_image(index->encoder, &keys);
+        image->scalars[IMAGE_PACKED] = keys.packed;
+        image->scalars[IMAGE_CODES] = keys.count;
+        image->scalars[IMAGE_SLOT_MASK] = (int64_t)keys.slot_mask;
+        set_image_array(image, IMAGE_WIDTHS, keys.widths, index->num_key_columns * sizeof(int));
+        set_image_array(image, IMAGE_SLOTS, keys.slots, keys.slot_bytes);
+        if (keys.packed) {
+            set_image_array(image, IMAGE_PACKED_KEYS, keys.packed_keys, (uint64_t)keys.count * sizeof(uint64_t));
+        } else {
+            set_image_array(image, IMAGE_KEY_OFFSETS, keys.key_offsets, ((uint64_t)keys.count + 1) * sizeof(int64_t));
+            set_image_array(image, IMAGE_KEY_BYTES, keys.bytes, keys.key_bytes);
+        }
+    }
+}
+
+// Is the hash table of an image whole? Its arrays must have the sizes
+// the scalars give; bucket and row contents are trusted. A changed index
+// may hold room (rows past the table's) and groups without rows.
+static int image_table_ok(const NDBJoinIndexImage* image, const NDBTableC* table) {
+    const int64_t* s = image->scalars;
+    uint64_t buckets = (uint64_t)s[IMAGE_BUCKET_MASK] + 1;
+    uint64_t blocks = (uint64_t)s[IMAGE_BLOOM_MASK] + 1;
+    if (s[IMAGE_TABLE_ROWS] != table->num_rows || s[IMAGE_ROWS] < 0 || s[IMAGE_ROWS] > INT32_MAX ||
+        s[IMAGE_INDEXED_ROWS] < 0 || s[IMAGE_INDEXED_ROWS] > s[IMAGE_ROWS] ||
+        s[IMAGE_INDEXED_ROWS] > table->num_rows || s[IMAGE_GROUPS] < 0 || s[IMAGE_GROUPS] > INT32_MAX ||
+        s[IMAGE_BUCKET_MASK] < 0 || (buckets & (buckets - 1)) != 0 ||
+        s[IMAGE_TOMBSTONES] < 0 || s[IMAGE_USED_SLOTS] < s[IMAGE_TOMBSTONES] ||
+        s[IMAGE_USED_SLOTS] - s[IMAGE_TOMBSTONES] > s[IMAGE_GROUPS] ||
+        (uint64_t)s[IMAGE_USED_SLOTS] > buckets * HASH_BUCKET_SLOTS ||
+        s[IMAGE_HASH_FUNCTION] < NDB_HASH_MULTIPLY_SHIFT || s[IMAGE_HASH_FUNCTION] > NDB_HASH_XXH3 ||
+        image->bytes[IMAGE_BUCKETS] != buckets * sizeof(HashBucket) ||
+        image->bytes[IMAGE_GROUP_OFFSETS] != ((uint64_t)s[IMAGE_GROUPS] + 1) * sizeof(int32_t) ||
+        image->bytes[IMAGE_ROW_IDS] != (uint64_t)s[IMAGE_ROWS] * sizeof(int32_t) ||
+        (image->bytes[IMAGE_GROUP_ENDS] != 0 &&
+         image->bytes[IMAGE_GROUP_ENDS] != (uint64_t)s[IMAGE_GROUPS] * sizeof(int32_t))) {
+        return 0;
+    }
+    const int32_t* group_offsets = (const int32_t*)image->arrays[IMAGE_GROUP_OFFSETS];
+    // Groups that moved leave the first rows to others
+    if ((!image->bytes[IMAGE_GROUP_ENDS] && group_offsets[0] != 0) ||
+        group_offsets[s[IMAGE_GROUPS]] != s[IMAGE_ROWS]) {
+        return 0;
+    }
+    if (image->bytes[IMAGE_DROPPED] % sizeof(uint64_t) != 0 ||
+        image->bytes[IMAGE_DROPPED] > ((uint64_t)table->num_rows + 63) / 64 * sizeof(uint64_t)) {
+        return 0;
+    }
+    return image->bytes[IMAGE_BLOOM_BLOCKS] == 0 ||
+           (s[IMAGE_BLOOM_MASK] >= 0 && (blocks & (blocks - 1)) == 0 &&
+            image->bytes[IMAGE_BLOOM_BLOCKS] == blocks * sizeof(uint64_t));
+}
+
+NDBJoinIndex* load_ndb_join_index_image(const NDBTableC* table, const NDBJoinIndexImage* image) {
+    const int64_t* s = image->scalars;
+    int num_key_columns = (int)s[IMAGE_NUM_KEY_COLUMNS];
+    if (s[IMAGE_NUM_KEY_COLUMNS] <= 0 || s[IMAGE_NUM_KEY_COLUMNS] > table->num_columns ||
+        image->bytes[IMAGE_KEY_COLUMNS] != (uint64_t)num_key_columns * sizeof(int) ||
+        !image_table_ok(image, table)) {
+        fprintf(stderr, "Error: join index does not fit its table\n");
+        return NULL;
+    }
+    const int* key_columns = (const int*)image->arrays[IMAGE_KEY_COLUMNS];
+    NDBJoinIndex* index = new_index(table, key_columns, num_key_columns);
+    if (!index) {
+        return NULL;
+    }
+    // The key handling must be the one create_ndb_join_index picks
+    int encoded = !index->direct;
+    if (s[IMAGE_ENCODED] != encoded || (!encoded && s[IMAGE_KEY_TYPE] != index->key_type_id)) {
+        fprintf(stderr, "Error: join index does not fit its table\n");
+        free_ndb_join_index(index);
+        return NULL;
+    }
+    if (encoded) {
+        NDBKeyEncoderImage keys = {
+            .packed = (int32_t)s[IMAGE_PACKED],
+            .count = (int32_t)s[IMAGE_CODES],
+            .slot_mask = (uint64_t)s[IMAGE_SLOT_MASK],
+            .slots = image->arrays[IMAGE_SLOTS],
+            .widths = (const int*)image->arrays[IMAGE_WIDTHS],
+            .packed_keys = (const uint64_t*)image->arrays[IMAGE_PACKED_KEYS],
+            .key_offsets = (const int64_t*)image->arrays[IMAGE_KEY_OFFSETS],
+            .bytes = (const uint8_t*)image->arrays[IMAGE_KEY_BYTES],
+            .slot_bytes = image->bytes[IMAGE_SLOTS],
+            .key_bytes = image->bytes[IMAGE_KEY_BYTES],
+        };
+        int sizes_ok = image->bytes[IMAGE_WIDTHS] == (uint64_t)num_key_columns * sizeof(int) &&
+                       s[IMAGE_CODES] >= 0 && s[IMAGE_CODES] <= table->num_rows &&
+                       (keys.packed ? image->bytes[IMAGE_PACKED_KEYS] == (uint64_t)keys.count * sizeof(uint64_t) :
+                        image->bytes[IMAGE_KEY_OFFSETS] == ((uint64_t)keys.count + 1) * sizeof(int64_t));
+        index->encoder = sizes_ok ? load_ndb_key_encoder_image(table, key_columns, num_key_columns, &keys) : NULL;
+        if (!index->encoder) {
+            fprintf(stderr, "Error: join index does not fit its table\n");
+            free_ndb_join_index(index);
+            return NULL;
+        }
+    }
+
+    // Only read through the loaded pointers, never written or freed
+    HashTable* hash_table = &index->hash_table;
+    index->loaded = 1;
+    hash_table->buckets = (HashBucket*)image->arrays[IMAGE_BUCKETS];
+    hash_table->bucket_mask = (uint64_t)s[IMAGE_BUCKET_MASK];
+    hash_table->count = s[IMAGE_GROUPS];
+    hash_table->group_offsets = (int32_t*)image->arrays[IMAGE_GROUP_OFFSETS];
+    hash_table->row_ids = (int32_t*)image->arrays[IMAGE_ROW_IDS];
+    hash_table->group_ends = (int32_t*)image->arrays[IMAGE_GROUP_ENDS];
+    hash_table->num_rows = (int32_t)s[IMAGE_ROWS];
+    hash_table->used_slots = s[IMAGE_USED_SLOTS];
+    hash_table->tombstones = s[IMAGE_TOMBSTONES];
+    hash_table->hash_function = (NDBHashFunction)s[IMAGE_HASH_FUNCTION];
+    hash_table->bloom.blocks = (uint64_t*)image->arrays[IMAGE_BLOOM_BLOCKS];
+    hash_table->bloom.block_mask = hash_table->bloom.blocks ? (uint64_t)s[IMAGE_BLOOM_MASK] : 0;
+    index->absent_key = (int32_t)s[IMAGE_ABSENT_KEY];
+    index->rows = s[IMAGE_INDEXED_ROWS];
+    index->dropped = (uint64_t*)image->arrays[IMAGE_DROPPED];
+    index->dropped_words = (int64_t)(image->bytes[IMAGE_DROPPED] / sizeof(uint64_t));
+    return index;
+}
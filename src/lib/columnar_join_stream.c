@@ -0,0 +1,184 @@
+#include "columnar_join_stream.h"
+#include "columnar_join_index.h"
+#include "columnar_hashtable.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Probe keys hashed and probed together
+#define STREAM_PROBE_BATCH 64
+
+struct NDBJoinStream {
+    const NDBJoinIndex* index;
+    NDBJoinIndex* owned_index;  // Built by open_ndb_join_stream, else NULL
+    const HashTable* table;     // The index's
+    JoinType join_type;
+    uint64_t* matched;          // Build rows that found a partner (RIGHT/FULL), else NULL
+
+    // Current batch
+    const int32_t* keys;        // Key of every batch row
+    int32_t* key_buffer;        // Behind keys when encoded or masked
+    int key_capacity;
+    int num_rows;
+    int window_start;           // First row of the keys being probed
+    int window_rows;            // 0 = next window not hashed yet
+    uint64_t hashes[STREAM_PROBE_BATCH];
+    HashProbeCursor cursor;
+
+    int finished;               // The probe side has ended
+    int next_unmatched;         // Next build row to check after finish
+};
+
+NDBJoinStream* open_ndb_join_index_stream(const NDBJoinIndex* index, JoinType join_type) {
+    NDBJoinStream* stream = (NDBJoinStream*)calloc(1, sizeof(NDBJoinStream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->index = index;
+    stream->table = ndb_join_index_hash_table(index);
+    stream->join_type = join_type;
+    if (ndb_join_keeps_right(join_type)) {
+        int num_rows = ndb_join_index_table(index)->num_rows;
+        stream->matched = (uint64_t*)calloc(((size_t)num_rows + 63) / 64 + 1, sizeof(uint64_t));
+        if (!stream->matched) {
+            free(stream);
+            return NULL;
+        }
+        // Rows deleted from the index count as matched, so none is emitted
+        int64_t dropped_words;
+        const uint64_t* dropped = ndb_join_index_dropped_rows(index, &dropped_words);
+        if (dropped) {
+            int64_t words = ((int64_t)num_rows + 63) / 64;
+            memcpy(stream->matched, dropped, (size_t)(dropped_words < words ? dropped_words : words) * sizeof(uint64_t));
+        }
+    }
+    return stream;
+}
+
+NDBJoinStream* open_ndb_join_stream(const NDBTableC* right_table, const int* right_key_columns,
+                                    int num_key_columns, JoinType join_type, const NDBJoinOptions* options) {
+    NDBJoinIndex* index = create_ndb_join_index(right_table, right_key_columns, num_key_columns, options);
+    NDBJoinStream* stream = index ? open_ndb_join_index_stream(index, join_type) : NULL;
+    if (!stream) {
+        free_ndb_join_index(index);
+        return NULL;
+    }
+    stream->owned_index = index;
+    return stream;
+}
+
+int probe_ndb_join_stream(NDBJoinStream* stream, const NDBTableC* left_batch, const int* left_key_columns) {
+    stream->keys = NULL;
+    stream->num_rows = 0;
+    stream->window_start = 0;
+    stream->window_rows = 0;
+    if (stream->key_capacity < left_batch->num_rows || !stream->key_buffer) {
+        free(stream->key_buffer);
+        stream->key_capacity = left_batch->num_rows > 0 ? left_batch->num_rows : 1;
+        stream->key_buffer = (int32_t*)malloc((size_t)stream->key_capacity * sizeof(int32_t));
+        if (!stream->key_buffer) {
+            stream->key_capacity = 0;
+            return -1;
+        }
+    }
+    const int32_t* keys;
+    if (ndb_join_index_probe_keys(stream->index, left_batch, left_key_columns, stream->key_buffer, &keys) != 0) {
+        return -1;
+    }
+    stream->keys = keys;
+    stream->num_rows = left_batch->num_rows;
+    return 0;
+}
+
+void finish_ndb_join_stream(NDBJoinStream* stream) {
+    stream->keys = NULL;
+    stream->num_rows = 0;
+    stream->window_start = 0;
+    stream->window_rows = 0;
+    stream->finished = 1;
+    stream->next_unmatched = 0;
+}
+
+// Build rows without a partner, from next_unmatched on
+static int64_t next_unmatched_rows(NDBJoinStream* stream, NDBRowPairs* pairs, int64_t max_pairs) {
+    int num_rows = ndb_join_index_table(stream->index)->num_rows;
+    while (stream->matched && stream->next_unmatched < num_rows && pairs->count < max_pairs) {
+        int row = stream->next_unmatched++;
+        if (!((stream->matched[row >> 6] >> (row & 63)) & 1)) {
+            pairs->left_rows[pairs->count] = -1;
+            pairs->right_rows[pairs->count++] = row;
+        }
+    }
+    return pairs->count;
+}
+
+int64_t next_ndb_join_pairs(NDBJoinStream* stream, NDBRowPairs* pairs, int64_t max_pairs) {
+    pairs->count = 0;
+    if (max_pairs < 1 || reserve_ndb_row_pairs(pairs, max_pairs) != 0) {
+        return -1;
+    }
+    if (stream->finished) {
+        return next_unmatched_rows(stream, pairs, max_pairs);
+    }
+
+    // Semi/anti: a key yields at most one row, so windows never overflow
+    if (ndb_join_is_semi(stream->join_type)) {
+        while (stream->window_start < stream->num_rows && pairs->count < max_pairs) {
+            int rest = stream->num_rows - stream->window_start;
+            int64_t room = max_pairs - pairs->count;
+            int count = rest < STREAM_PROBE_BATCH ? rest : STREAM_PROBE_BATCH;
+            count = room < count ? (int)room : count;
+            const int32_t* keys = stream->keys + stream->window_start;
+            ndb_hash_keys(stream->table->hash_function, keys, stream->hashes, count);
+            int64_t first = pairs->count;
+            pairs->count += probe_hash_key_set(stream->table, keys, stream->hashes, count, stream->window_start,
+                                               stream->join_type == LEFT_ANTI_JOIN, pairs->left_rows + first);
+            for (int64_t k = first; k < pairs->count; k++) {
+                pairs->right_rows[k] = -1;
+            }
+            stream->window_start += count;
+        }
+        return pairs->count;
+    }
+
+    // Windows resume mid-key through the cursor when the output fills up
+    int emit_unmatched = ndb_join_keeps_left(stream->join_type);
+    while (pairs->count < max_pairs) {
+        if (stream->window_rows == 0) {
+            int rest = stream->num_rows - stream->window_start;
+            if (rest <= 0) {
+                break;
+            }
+            stream->window_rows = rest < STREAM_PROBE_BATCH ? rest : STREAM_PROBE_BATCH;
+            ndb_hash_keys(stream->table->hash_function, stream->keys + stream->window_start,
+                          stream->hashes, stream->window_rows);
+            init_hash_probe_cursor(&stream->cursor);
+        }
+        int64_t first = pairs->count;
+        pairs->count += probe_hash_batch(stream->table, stream->keys + stream->window_start, stream->hashes,
+                                         stream->window_rows, stream->window_start, emit_unmatched,
+                                         &stream->cursor, pairs->left_rows + first, pairs->right_rows + first,
+                                         (int)(max_pairs - first < INT32_MAX ? max_pairs - first : INT32_MAX));
+        if (stream->matched) {
+            mark_ndb_matched_rows(stream->matched, pairs->right_rows + first, pairs->count - first);
+        }
+        if (stream->cursor.key_idx < stream->window_rows) {
+            break;
+        }
+        stream->window_start += stream->window_rows;
+        stream->window_rows = 0;
+    }
+    return pairs->count;
+}
+
+void close_ndb_join_stream(NDBJoinStream* stream) {
+    if (!stream) {
+        return;
+    }
+    free_ndb_join_index(stream->owned_index);
+    free(stream->matched);
+    free(stream->key_buffer);
+    free(stream);
+}
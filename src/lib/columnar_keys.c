@@ -0,0 +1,764 @@
+#include "columnar_keys.h"
+#include "columnar_hashjoin.h"
+#include "columnar_types.h"
+#include "xxhash.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKED_KEY_BYTES 8
+#define EMPTY_SLOT -1
+
+// Bytes of a string key's length prefix when packed (strings up to 255)
+#define PACKED_LENGTH_BYTES 1
+#define TOO_LONG_STRING 0xFF
+
+typedef struct {
+    const NDBTableC* table;
+    const int* columns;
+    int num_columns;
+} KeyColumns;
+
+typedef struct {
+    uint64_t hash;
+    int32_t code;               // EMPTY_SLOT when unused
+} KeySlot;
+
+// Distinct right keys: open addressing on the key hash, the keys
+// themselves stored by code (packed) or back to back (variable width)
+typedef struct {
+    KeySlot* slots;
+    uint64_t mask;
+    int32_t count;
+    int32_t capacity;           // Codes the key arrays have room for
+    int packed;
+    uint64_t* packed_keys;      // Packed key of each code
+    int64_t* key_offsets;       // Variable keys: code c is bytes[key_offsets[c] .. key_offsets[c + 1])
+    uint8_t* bytes;
+    int64_t byte_capacity;
+} KeyDictionary;
+
+// =================== Normalization ===================
+
+// Type keys of column `column` compare as (NDBTypeInfo.key_type)
+static int key_type(const NDBTableC* table, int column) {
+    return ndb_type_info(table->columns[column].type_id)->key_type;
+}
+
+static int valid_key_columns(const KeyColumns* left, const KeyColumns* right) {
+    for (int k = 0; k < left->num_columns; k++) {
+        int lc = left->columns[k];
+        int rc = right->columns[k];
+        if (lc < 0 || lc >= left->table->num_columns || rc < 0 || rc >= right->table->num_columns ||
+            !ndb_type_info(left->table->columns[lc].type_id) ||
+            !ndb_type_info(right->table->columns[rc].type_id) ||
+            key_type(left->table, lc) != key_type(right->table, rc)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int max_string_length(const NDBTableC* table, int column) {
+    // Dictionary codes and view rows stand for its strings, the longest
+    // bounds them all
+    if (ndb_type_decoded(table->columns[column].type_id)) {
+        return table->columns[column].dictionary ? max_string_length(table->columns[column].dictionary, 0) : 0;
+    }
+    const int32_t* offsets = table->columns[column].offsets;
+    int longest = 0;
+    for (int i = 0; i < table->num_rows; i++) {
+        int len = offsets[i + 1] - offsets[i];
+        longest = len > longest ? len : longest;
+    }
+    return longest;
+}
+
+// Packed bytes of each key column, 0 when the keys do not fit in a uint64
+static int packed_widths(const KeyColumns* left, const KeyColumns* right, int* widths) {
+    int total = 0;
+    for (int k = 0; k < left->num_columns && total <= PACKED_KEY_BYTES; k++) {
+        widths[k] = ndb_type_width(key_type(left->table, left->columns[k]));
+        if (widths[k] == 0) {
+            int l = max_string_length(left->table, left->columns[k]);
+            int r = max_string_length(right->table, right->columns[k]);
+            widths[k] = PACKED_LENGTH_BYTES + (l > r ? l : r);
+        }
+        total += widths[k];
+    }
+    return total <= PACKED_KEY_BYTES;
+}
+
+static void key_string(const NDBTableC* table, int column, int row, const char** str, int* len) {
+    char* chars;
+    get_ndb_string_value(table, column, row, &chars, len);
+    *str = chars ? chars : "";
+}
+
+// Fixed-width key value as bytes. Equal doubles must give equal bytes:
+// -0.0 becomes 0.0 and every NaN the same NaN.
+static inline void fixed_key_bytes(const NDBArrayC* array, int width, int row, uint8_t* out) {
+    if (array->type_id == NDB_TYPE_FLOAT64) {
+        double value = ((const double*)array->values)[row];
+        value = value == 0.0 ? 0.0 : value != value ? NAN : value;
+        memcpy(out, &value, sizeof(value));
+        return;
+    }
+    memcpy(out, (const uint8_t*)array->values + (size_t)row * width, width);
+}
+
+// Packed keys of rows [start, start + count), a column at a time: fixed
+// slots of widths[k] bytes, strings as length byte + characters
+// zero-padded to the slot. Each column's loop knows its width and type.
+// A string too long for its slot (possible when the slots were sized
+// from the other input only) gets the length byte TOO_LONG_STRING, which
+// no key that fits has, so it matches nothing.
+static void pack_keys(const KeyColumns* keys, const int* widths, int start, int count, uint64_t* packed) {
+    memset(packed, 0, count * sizeof(uint64_t));
+    int pos = 0;
+    for (int k = 0; k < keys->num_columns; k++) {
+        int column = keys->columns[k];
+        const NDBArrayC* array = &keys->table->columns[column];
+        int width = ndb_type_width(key_type(keys->table, column));
+        if (width == sizeof(int32_t)) {
+            const int32_t* values = (const int32_t*)array->values + start;
+            for (int i = 0; i < count; i++) {
+                memcpy((uint8_t*)&packed[i] + pos, &values[i], sizeof(int32_t));
+            }
+        } else if (width == sizeof(int64_t) && array->type_id != NDB_TYPE_FLOAT64) {
+            // A lone int64 key is its own packed key
+            memcpy(packed, (const int64_t*)array->values + start, count * sizeof(int64_t));
+        } else if (width > 0) {
+            for (int i = 0; i < count; i++) {
+                fixed_key_bytes(array, width, start + i, (uint8_t*)&packed[i] + pos);
+            }
+        } else {
+            for (int i = 0; i < count; i++) {
+                const char* str;
+                int len;
+                key_string(keys->table, column, start + i, &str, &len);
+                uint8_t* slot = (uint8_t*)&packed[i] + pos;
+                if (len > widths[k] - PACKED_LENGTH_BYTES) {
+                    slot[0] = TOO_LONG_STRING;
+                    continue;
+                }
+                slot[0] = (uint8_t)len;
+                memcpy(slot + PACKED_LENGTH_BYTES, str, len);
+            }
+        }
+        pos += widths[k];
+    }
+}
+
+// Key columns of a row as bytes: fixed-width values, strings as int32
+// length + characters. Grows *buf as needed; returns the length or -1.
+static int64_t serialize_key(const KeyColumns* keys, int row, uint8_t** buf, int64_t* capacity) {
+    int64_t len = 0;
+    for (int k = 0; k < keys->num_columns; k++) {
+        int column = keys->columns[k];
+        int width = ndb_type_width(key_type(keys->table, column));
+        const char* str = NULL;
+        int32_t str_len = 0;
+        if (width == 0) {
+            key_string(keys->table, column, row, &str, &str_len);
+        }
+        int64_t bytes = width > 0 ? width : (int64_t)sizeof(str_len) + str_len;
+        if (len + bytes > *capacity) {
+            int64_t grown = (*capacity > 0 ? *capacity : 64);
+            while (grown < len + bytes) {
+                grown *= 2;
+            }
+            uint8_t* bigger = (uint8_t*)realloc(*buf, grown);
+            if (!bigger) {
+                return -1;
+            }
+            *buf = bigger;
+            *capacity = grown;
+        }
+        if (width > 0) {
+            fixed_key_bytes(&keys->table->columns[column], width, row, *buf + len);
+        } else {
+            memcpy(*buf + len, &str_len, sizeof(str_len));
+            if (str_len > 0) {
+                memcpy(*buf + len + sizeof(str_len), str, str_len);
+            }
+        }
+        len += bytes;
+    }
+    return len;
+}
+
+// =================== Dictionary ===================
+
+static int init_dictionary(KeyDictionary* dict, int max_keys, int packed) {
+    uint64_t num_slots = 1;
+    while (num_slots < (uint64_t)max_keys * 2) {
+        num_slots <<= 1;
+    }
+    memset(dict, 0, sizeof(*dict));
+    dict->slots = (KeySlot*)malloc(num_slots * sizeof(KeySlot));
+    dict->mask = num_slots - 1;
+    dict->capacity = max_keys > 0 ? max_keys : 1;
+    dict->packed = packed;
+    if (packed) {
+        dict->packed_keys = (uint64_t*)malloc((size_t)(max_keys > 0 ? max_keys : 1) * sizeof(uint64_t));
+    } else {
+        dict->key_offsets = (int64_t*)calloc((size_t)max_keys + 1, sizeof(int64_t));
+    }
+    if (!dict->slots || (packed ? !dict->packed_keys : !dict->key_offsets)) {
+        return -1;
+    }
+    for (uint64_t s = 0; s < num_slots; s++) {
+        dict->slots[s].code = EMPTY_SLOT;
+    }
+    return 0;
+}
+
+static void free_dictionary(KeyDictionary* dict) {
+    free(dict->slots);
+    free(dict->packed_keys);
+    free(dict->key_offsets);
+    free(dict->bytes);
+}
+
+static int same_key(const KeyDictionary* dict, int32_t code, uint64_t packed, const uint8_t* key, int64_t len) {
+    if (dict->packed) {
+        return dict->packed_keys[code] == packed;
+    }
+    int64_t start = dict->key_offsets[code];
+    return dict->key_offsets[code + 1] - start == len && memcmp(dict->bytes + start, key, len) == 0;
+}
+
+// Code of the key, EMPTY_SLOT when absent; *slot_out is where it would go
+static int32_t find_key(const KeyDictionary* dict, uint64_t hash, uint64_t packed,
+                        const uint8_t* key, int64_t len, uint64_t* slot_out) {
+    for (uint64_t s = hash & dict->mask;; s = (s + 1) & dict->mask) {
+        const KeySlot* slot = &dict->slots[s];
+        if (slot->code == EMPTY_SLOT ||
+            (slot->hash == hash && same_key(dict, slot->code, packed, key, len))) {
+            *slot_out = s;
+            return slot->code;
+        }
+    }
+}
+
+static int32_t add_key(KeyDictionary* dict, uint64_t slot, uint64_t hash, uint64_t packed,
+                       const uint8_t* key, int64_t len) {
+    int32_t code = dict->count;
+    if (dict->packed) {
+        dict->packed_keys[code] = packed;
+    } else {
+        int64_t start = dict->key_offsets[code];
+        if (start + len > dict->byte_capacity) {
+            int64_t grown = dict->byte_capacity > 0 ? dict->byte_capacity : 4096;
+            while (grown < start + len) {
+                grown *= 2;
+            }
+            uint8_t* bigger = (uint8_t*)realloc(dict->bytes, grown);
+            if (!bigger) {
+                return -1;
+            }
+            dict->bytes = bigger;
+            dict->byte_capacity = grown;
+        }
+        memcpy(dict->bytes + start, key, len);
+        dict->key_offsets[code + 1] = start + len;
+    }
+    dict->slots[slot].hash = hash;
+    dict->slots[slot].code = code;
+    dict->count++;
+    return code;
+}
+
+// Room for count keys: the key arrays grow by doubling, the slots stay at
+// most half full. Codes keep their keys.
+static int reserve_dictionary(KeyDictionary* dict, int64_t count) {
+    if (count > dict->capacity) {
+        int64_t grown = (int64_t)dict->capacity * 2 > count ? (int64_t)dict->capacity * 2 : count;
+        if (grown > INT32_MAX) {
+            return -1;
+        }
+        if (dict->packed) {
+            uint64_t* keys = (uint64_t*)realloc(dict->packed_keys, grown * sizeof(uint64_t));
+            if (!keys) {
+                return -1;
+            }
+            dict->packed_keys = keys;
+        } else {
+            int64_t* offsets = (int64_t*)realloc(dict->key_offsets, (grown + 1) * sizeof(int64_t));
+            if (!offsets) {
+                return -1;
+            }
+            dict->key_offsets = offsets;
+        }
+        dict->capacity = (int32_t)grown;
+    }
+    if ((uint64_t)count * 2 <= dict->mask + 1) {
+        return 0;
+    }
+    uint64_t num_slots = (dict->mask + 1) * 2;
+    while (num_slots < (uint64_t)count * 2) {
+        num_slots <<= 1;
+    }
+    KeySlot* slots = (KeySlot*)malloc(num_slots * sizeof(KeySlot));
+    if (!slots) {
+        return -1;
+    }
+    for (uint64_t s = 0; s < num_slots; s++) {
+        slots[s].code = EMPTY_SLOT;
+    }
+    for (uint64_t s = 0; s <= dict->mask; s++) {
+        if (dict->slots[s].code == EMPTY_SLOT) {
+            continue;
+        }
+        uint64_t t = dict->slots[s].hash & (num_slots - 1);
+        while (slots[t].code != EMPTY_SLOT) {
+            t = (t + 1) & (num_slots - 1);
+        }
+        slots[t] = dict->slots[s];
+    }
+    free(dict->slots);
+    dict->slots = slots;
+    dict->mask = num_slots - 1;
+    return 0;
+}
+
+// Rows packed per pack_keys call
+#define PACK_BATCH 256
+
+// codes[i] = code of row i; new keys are added when add is set, absent
+// keys get -1 otherwise
+static int encode_rows(KeyDictionary* dict, const KeyColumns* keys, const int* widths,
+                       int add, int32_t* codes) {
+    uint8_t* buf = NULL;
+    int64_t capacity = 0;
+    uint64_t packed[PACK_BATCH];
+    int status = 0;
+    for (int row = 0; row < keys->table->num_rows && status == 0; row++) {
+        int64_t len = PACKED_KEY_BYTES;
+        const uint8_t* key;
+        if (dict->packed) {
+            if (row % PACK_BATCH == 0) {
+                int n = keys->table->num_rows - row < PACK_BATCH ? keys->table->num_rows - row : PACK_BATCH;
+                pack_keys(keys, widths, row, n, packed);
+            }
+            key = (const uint8_t*)&packed[row % PACK_BATCH];
+        } else {
+            len = serialize_key(keys, row, &buf, &capacity);
+            key = buf;
+            if (len < 0) {
+                status = -1;
+                break;
+            }
+        }
+        uint64_t key_packed = dict->packed ? packed[row % PACK_BATCH] : 0;
+        uint64_t hash = XXH3_64bits(key, (size_t)len);
+        uint64_t slot;
+        int32_t code = find_key(dict, hash, key_packed, key, len, &slot);
+        if (code == EMPTY_SLOT && add) {
+            code = add_key(dict, slot, hash, key_packed, key, len);
+            status = code < 0 ? -1 : 0;
+        }
+        codes[row] = code;
+    }
+    free(buf);
+    return status;
+}
+
+// =================== Public API ===================
+
+int ndb_join_keys_need_codes(const NDBTableC* left_table, const int* left_key_columns,
+                             const NDBTableC* right_table, const int* right_key_columns,
+                             int num_key_columns) {
+    if (num_key_columns != 1 ||
+        left_key_columns[0] < 0 || left_key_columns[0] >= left_table->num_columns ||
+        right_key_columns[0] < 0 || right_key_columns[0] >= right_table->num_columns) {
+        return 1;
+    }
+    const NDBArrayC* left = &left_table->columns[left_key_columns[0]];
+    const NDBArrayC* right = &right_table->columns[right_key_columns[0]];
+    const NDBTypeInfo* info = ndb_type_info(left->type_id);
+    // Dictionary codes are only comparable within one dictionary
+    return !info || !info->int32_key || right->type_id != left->type_id ||
+           (left->type_id == NDB_TYPE_DICT_STRING && left->dictionary != right->dictionary);
+}
+
+int encode_ndb_join_keys(const NDBTableC* left_table, const int* left_key_columns,
+                         const NDBTableC* right_table, const int* right_key_columns,
+                         int num_key_columns, NDBKeyCodes* codes) {
+    KeyColumns left = {left_table, left_key_columns, num_key_columns};
+    KeyColumns right = {right_table, right_key_columns, num_key_columns};
+    memset(codes, 0, sizeof(*codes));
+    if (num_key_columns <= 0 || !valid_key_columns(&left, &right)) {
+        fprintf(stderr, "Error: join key columns must have known types that match pairwise\n");
+        return -1;
+    }
+
+    int* widths = (int*)malloc(num_key_columns * sizeof(int));
+    KeyDictionary dict;
+    codes->left = (int32_t*)malloc((size_t)(left_table->num_rows > 0 ? left_table->num_rows : 1) * sizeof(int32_t));
+    codes->right = (int32_t*)malloc((size_t)(right_table->num_rows > 0 ? right_table->num_rows : 1) * sizeof(int32_t));
+    int status = widths && codes->left && codes->right ? 0 : -1;
+    if (status == 0) {
+        codes->packed = packed_widths(&left, &right, widths);
+        status = init_dictionary(&dict, right_table->num_rows, codes->packed);
+        // Right keys define the codes, left keys only look them up
+        if (status == 0) {
+            status = encode_rows(&dict, &right, widths, 1, codes->right);
+        }
+        if (status == 0) {
+            status = encode_rows(&dict, &left, widths, 0, codes->left);
+        }
+        codes->distinct = dict.count;
+        free_dictionary(&dict);
+    }
+    free(widths);
+    if (status != 0) {
+        fprintf(stderr, "Error: out of memory encoding join keys\n");
+        free_ndb_key_codes(codes);
+    }
+    return status;
+}
+
+void free_ndb_key_codes(NDBKeyCodes* codes) {
+    free(codes->left);
+    free(codes->right);
+    codes->left = NULL;
+    codes->right = NULL;
+}
+
+// =================== Key encoder ===================
+
+struct NDBKeyEncoder {
+    KeyDictionary dict;
+    KeyColumns right;
+    int* right_columns;         // Copy of the right key columns
+    int* widths;                // Packed slot widths, from the right keys alone
+    int borrowed;               // dict and widths live in a loaded image
+};
+
+NDBKeyEncoder* create_ndb_key_encoder(const NDBTableC* right_table, const int* right_key_columns,
+                                      int num_key_columns, int32_t* right_codes) {
+    NDBKeyEncoder* encoder = (NDBKeyEncoder*)calloc(1, sizeof(NDBKeyEncoder));
+    if (!encoder) {
+        return NULL;
+    }
+    encoder->right_columns = (int*)malloc((num_key_columns > 0 ? num_key_columns : 1) * sizeof(int));
+    encoder->widths = (int*)malloc((num_key_columns > 0 ? num_key_columns : 1) * sizeof(int));
+    encoder->right = (KeyColumns){right_table, encoder->right_columns, num_key_columns};
+    if (!encoder->right_columns || !encoder->widths) {
+        free_ndb_key_encoder(encoder);
+        return NULL;
+    }
+    memcpy(encoder->right_columns, right_key_columns, num_key_columns * sizeof(int));
+    if (num_key_columns <= 0 || !valid_key_columns(&encoder->right, &encoder->right)) {
+        fprintf(stderr, "Error: join key columns must have known types\n");
+        free_ndb_key_encoder(encoder);
+        return NULL;
+    }
+
+    int packed = packed_widths(&encoder->right, &encoder->right, encoder->widths);
+    int32_t* codes = right_codes ? right_codes :
+                     (int32_t*)malloc((size_t)(right_table->num_rows > 0 ? right_table->num_rows : 1) * sizeof(int32_t));
+    int status = codes && init_dictionary(&encoder->dict, right_table->num_rows, packed) == 0 &&
+                 encode_rows(&encoder->dict, &encoder->right, encoder->widths, 1, codes) == 0 ? 0 : -1;
+    if (codes != right_codes) {
+        free(codes);
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error: out of memory encoding join keys\n");
+        free_ndb_key_encoder(encoder);
+        return NULL;
+    }
+    return encoder;
+}
+
+int32_t ndb_key_encoder_distinct(const NDBKeyEncoder* encoder) {
+    return encoder->dict.count;
+}
+
+int encode_ndb_left_keys(const NDBKeyEncoder* encoder, const NDBTableC* left_table, const int* left_key_columns,
+                         int32_t* codes) {
+    KeyColumns left = {left_table, left_key_columns, encoder->right.num_columns};
+    if (!valid_key_columns(&left, &encoder->right)) {
+        fprintf(stderr, "Error: join key columns must have known types that match pairwise\n");
+        return -1;
+    }
+    // Lookups only: the dictionary is shared with concurrent callers
+    if (encode_rows((KeyDictionary*)&encoder->dict, &left, encoder->widths, 0, codes) != 0) {
+        fprintf(stderr, "Error: out of memory encoding join keys\n");
+        return -1;
+    }
+    return 0;
+}
+
+void free_ndb_key_encoder(NDBKeyEncoder* encoder) {
+    if (!encoder) {
+        return;
+    }
+    if (!encoder->borrowed) {
+        free_dictionary(&encoder->dict);
+        free(encoder->widths);
+    }
+    free(encoder->right_columns);
+    free(encoder);
+}
+
+// Whether the key of row fits the packed slot widths
+static int key_fits(const KeyColumns* keys, const int* widths, int row) {
+    for (int k = 0; k < keys->num_columns; k++) {
+        if (ndb_type_width(key_type(keys->table, keys->columns[k])) == 0) {
+            const char* str;
+            int len;
+            key_string(keys->table, keys->columns[k], row, &str, &len);
+            if (len > widths[k] - PACKED_LENGTH_BYTES) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int encode_ndb_right_rows(NDBKeyEncoder* encoder, const int32_t* rows, int count, int add, int32_t* codes) {
+    KeyDictionary* dict = &encoder->dict;
+    uint8_t* buf = NULL;
+    int64_t capacity = 0;
+    int status = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        int row = rows[i];
+        uint64_t packed = 0;
+        int64_t len = PACKED_KEY_BYTES;
+        const uint8_t* key = (const uint8_t*)&packed;
+        if (dict->packed) {
+            if (add && !key_fits(&encoder->right, encoder->widths, row)) {
+                status = 1;
+                break;
+            }
+            pack_keys(&encoder->right, encoder->widths, row, 1, &packed);
+        } else {
+            len = serialize_key(&encoder->right, row, &buf, &capacity);
+            key = buf;
+            if (len < 0) {
+                status = -1;
+                break;
+            }
+        }
+        if (add && reserve_dictionary(dict, (int64_t)dict->count + 1) != 0) {
+            status = -1;
+            break;
+        }
+        uint64_t hash = XXH3_64bits(key, (size_t)len);
+        uint64_t slot;
+        int32_t code = find_key(dict, hash, packed, key, len, &slot);
+        if (code == EMPTY_SLOT && add) {
+            code = add_key(dict, slot, hash, packed, key, len);
+            status = code < 0 ? -1 : 0;
+        }
+        codes[i] = code;
+    }
+    free(buf);
+    return status;
+}
+
+int own_ndb_key_encoder(NDBKeyEncoder* encoder) {
+    if (!encoder->borrowed) {
+        return 0;
+    }
+    KeyDictionary* dict = &encoder->dict;
+    int num_columns = encoder->right.num_columns;
+    size_t slot_bytes = (dict->mask + 1) * sizeof(KeySlot);
+    size_t key_bytes = dict->packed ? 0 : (size_t)dict->key_offsets[dict->count];
+    KeySlot* slots = (KeySlot*)malloc(slot_bytes);
+    int* widths = (int*)malloc(num_columns * sizeof(int));
+    uint64_t* packed_keys = dict->packed ? (uint64_t*)malloc(((size_t)dict->count + 1) * sizeof(uint64_t)) : NULL;
+    int64_t* key_offsets = dict->packed ? NULL : (int64_t*)malloc(((size_t)dict->count + 1) * sizeof(int64_t));
+    uint8_t* bytes = key_bytes ? (uint8_t*)malloc(key_bytes) : NULL;
+    if (!slots || !widths || (dict->packed ? !packed_keys : !key_offsets) || (key_bytes && !bytes)) {
+        free(slots);
+        free(widths);
+        free(packed_keys);
+        free(key_offsets);
+        free(bytes);
+        return -1;
+    }
+    memcpy(slots, dict->slots, slot_bytes);
+    memcpy(widths, encoder->widths, num_columns * sizeof(int));
+    if (dict->packed) {
+        memcpy(packed_keys, dict->packed_keys, (size_t)dict->count * sizeof(uint64_t));
+    } else {
+        memcpy(key_offsets, dict->key_offsets, ((size_t)dict->count + 1) * sizeof(int64_t));
+        if (key_bytes) {
+            memcpy(bytes, dict->bytes, key_bytes);
+        }
+    }
+    dict->slots = slots;
+    dict->packed_keys = packed_keys;
+    dict->key_offsets = key_offsets;
+    dict->bytes = bytes;
+    dict->byte_capacity = (int64_t)key_bytes;
+    dict->capacity = dict->count + 1;
+    encoder->widths = widths;
+    encoder->borrowed = 0;
+    return 0;
+}
+
+void get_ndb_key_encoder_image(const NDBKeyEncoder* encoder, NDBKeyEncoderImage* image) {
+    const KeyDictionary* dict = &encoder->dict;
+    memset(image, 0, sizeof(*image));
+    image->packed = dict->packed;
+    image->count = dict->count;
+    image->slot_mask = dict->mask;
+    image->slots = dict->slots;
+    image->slot_bytes = (dict->mask + 1) * sizeof(KeySlot);
+    image->widths = encoder->widths;
+    image->packed_keys = dict->packed ? dict->packed_keys : NULL;
+    image->key_offsets = dict->packed ? NULL : dict->key_offsets;
+    image->bytes = dict->packed ? NULL : dict->bytes;
+    image->key_bytes = dict->packed ? 0 : (uint64_t)dict->key_offsets[dict->count];
+}
+
+NDBKeyEncoder* load_ndb_key_encoder_image(const NDBTableC* right_table, const int* right_key_columns,
+                                          int num_key_columns, const NDBKeyEncoderImage* image) {
+    // A power-of-two slot count with an empty slot left, so lookups end
+    if (image->count < 0 || (image->slot_mask & (image->slot_mask + 1)) != 0 ||
+        (uint64_t)image->count > image->slot_mask || image->slot_bytes != (image->slot_mask + 1) * sizeof(KeySlot) ||
+        !image->slots || !image->widths || (image->packed ? !image->packed_keys :
+        !image->key_offsets || image->key_offsets[0] != 0 ||
+        (uint64_t)image->key_offsets[image->count] != image->key_bytes || (image->key_bytes && !image->bytes))) {
+        fprintf(stderr, "Error: inconsistent key encoder image\n");
+        return NULL;
+    }
+    NDBKeyEncoder* encoder = (NDBKeyEncoder*)calloc(1, sizeof(NDBKeyEncoder));
+    if (!encoder) {
+        return NULL;
+    }
+    encoder->borrowed = 1;
+    encoder->right_columns = (int*)malloc((num_key_columns > 0 ? num_key_columns : 1) * sizeof(int));
+    encoder->right = (KeyColumns){right_table, encoder->right_columns, num_key_columns};
+    if (!encoder->right_columns) {
+        free_ndb_key_encoder(encoder);
+        return NULL;
+    }
+    memcpy(encoder->right_columns, right_key_columns, num_key_columns * sizeof(int));
+    if (num_key_columns <= 0 || !valid_key_columns(&encoder->right, &encoder->right)) {
+        fprintf(stderr, "Error: join key columns must have known types\n");
+        free_ndb_key_encoder(encoder);
+        return NULL;
+    }
+
+    // Only read through the loaded pointers, never written or freed
+    KeyDictionary* dict = &encoder->dict;
+    dict->slots = (KeySlot*)image->slots;
+    dict->mask = image->slot_mask;
+    dict->count = image->count;
+    dict->packed = image->packed;
+    dict->packed_keys = (uint64_t*)image->packed_keys;
+    dict->key_offsets = (int64_t*)image->key_offsets;
+    dict->bytes = (uint8_t*)image->bytes;
+    dict->byte_capacity = (int64_t)image->key_bytes;
+    dict->capacity = image->count;
+    encoder->widths = (int*)image->widths;
+    return encoder;
+}
+
+// =================== NULL keys ===================
+
+int valid_ndb_join_key_columns(const NDBTableC* left_table, const int* left_key_columns,
+                               const NDBTableC* right_table, const int* right_key_columns,
+                               int num_key_columns) {
+    if (num_key_columns <= 0 || !left_key_columns || !right_key_columns) {
+        fprintf(stderr, "Error: a join needs at least one key column\n");
+        return 0;
+    }
+    for (int k = 0; k < num_key_columns; k++) {
+        if (left_key_columns[k] < 0 || left_key_columns[k] >= left_table->num_columns ||
+            right_key_columns[k] < 0 || right_key_columns[k] >= right_table->num_columns) {
+            fprintf(stderr, "Error: join key %d (columns %d and %d) is not a column of its table\n",
+                    k, left_key_columns[k], right_key_columns[k]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int find_ndb_null_keys(const NDBTableC* table, const int* key_columns, int num_key_columns,
+                       uint64_t** null_rows) {
+    int num_words = (table->num_rows + 63) / 64;
+    size_t num_bytes = ((size_t)table->num_rows + 7) / 8;
+    uint64_t* nulls = NULL;
+    uint64_t any = 0;
+    *null_rows = NULL;
+
+    for (int k = 0; k < num_key_columns; k++) {
+        const uint8_t* validity = table->columns[key_columns[k]].validity;
+        if (!validity) {
+            continue;
+        }
+        if (!nulls && !(nulls = (uint64_t*)calloc(num_words > 0 ? num_words : 1, sizeof(uint64_t)))) {
+            return -1;
+        }
+        // Bytes are little-endian bit order, so 8 of them form one word;
+        // the last word reads only the bytes the bitmap covers
+        for (int w = 0; w < num_words; w++) {
+            uint64_t valid = ~0ULL;
+            size_t offset = (size_t)w * 8;
+            memcpy(&valid, validity + offset, num_bytes - offset < 8 ? num_bytes - offset : 8);
+            nulls[w] |= ~valid;
+        }
+    }
+    if (nulls && table->num_rows % 64) {
+        nulls[num_words - 1] &= (1ULL << (table->num_rows % 64)) - 1;
+    }
+    for (int w = 0; nulls && w < num_words; w++) {
+        any |= nulls[w];
+    }
+    if (!any) {
+        free(nulls);
+        return 0;
+    }
+    *null_rows = nulls;
+    return 0;
+}
+
+int compact_ndb_non_null_keys(const int32_t* keys, const uint64_t* null_rows, int num_rows,
+                              int32_t* out_keys, int32_t* out_rows) {
+    int out = 0;
+    for (int base = 0; base < num_rows; base += 64) {
+        uint64_t present = ~null_rows[base >> 6];
+        if (num_rows - base < 64) {
+            present &= (1ULL << (num_rows - base)) - 1;
+        }
+        // All-valid words copy straight through
+        if (present == ~0ULL) {
+            for (int j = 0; j < 64; j++) {
+                out_keys[out + j] = keys[base + j];
+                out_rows[out + j] = base + j;
+            }
+            out += 64;
+            continue;
+        }
+        for (; present; present &= present - 1) {
+            int row = base + __builtin_ctzll(present);
+            out_keys[out] = keys[row];
+            out_rows[out++] = row;
+        }
+    }
+    return out;
+}
+
+void mask_ndb_null_keys(int32_t* keys, const uint64_t* null_rows, int start, int count, int32_t absent_key) {
+    int end = start + count;
+    for (int base = start & ~63; base < end; base += 64) {
+        uint64_t nulls = null_rows[base >> 6];
+        if (base < start) {
+            nulls &= ~0ULL << (start - base);
+        }
+        if (end - base < 64) {
+            nulls &= (1ULL << (end - base)) - 1;
+        }
+        for (; nulls; nulls &= nulls - 1) {
+            keys[base + __builtin_ctzll(nulls) - start] = absent_key;
+        }
+    }
+}
@@ -0,0 +1,516 @@
+#include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+#include "columnar_keys.h"
+#include "columnar_threadpool.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+// A 256-way scatter keeps one write stream per TLB entry / L1 line
+#define RADIX_MAX_BITS_PER_PASS 8
+#define RADIX_MAX_BITS 16
+// Build footprint per row: buckets at 75% load + group offsets + row ids
+#define RADIX_BUILD_BYTES_PER_ROW 24
+#define RADIX_DEFAULT_L2_BYTES (1L << 20)
+// Below this many input rows parallelism is not worth extra partitions
+#define RADIX_PARALLEL_MIN_ROWS 65536
+// Free pair slots guaranteed before each probe_hash_batch call
+#define RADIX_PROBE_RESERVE 1024
+
+// One join input, partitioned as structure-of-arrays. Each key is hashed
+// once; the hash travels with it through both passes into build and probe.
+typedef struct {
+    const NDBTableC* table;
+    int key_column;
+    const int32_t* codes;       // Encoded key of every row, NULL = read key_column
+    const uint64_t* nulls;      // Rows with a NULL key, left out of the partitions; or NULL
+    int num_rows;
+    NDBHashFunction hash_function;
+    int32_t* keys;
+    int32_t* rows;
+    uint64_t* hashes;
+    int32_t* scratch_keys;
+    int32_t* scratch_rows;
+    uint64_t* scratch_hashes;
+    int* chunk_hist;            // num_chunks x fanout1 histogram of pass 1
+    int* pass1_offsets;         // fanout1 + 1 bounds after pass 1
+    int* part_offsets;          // num_partitions + 1 final partition bounds
+} RadixRelation;
+
+typedef struct {
+    RadixRelation* relation;
+    int num_chunks;
+    int bits1;
+    int bits2;
+} RadixPartitionJob;
+
+typedef struct {
+    RadixRelation* left;
+    RadixRelation* right;
+    JoinType join_type;
+    int bloom_filter;           // Build a Bloom filter per partition
+    NDBRowPairs* chunks;        // Matched pairs of each partition
+    atomic_int failed;
+} RadixJoinJob;
+
+void init_ndb_join_options(NDBJoinOptions* options) {
+    options->num_threads = 0;
+    options->radix_bits = 0;
+    options->radix_passes = 0;
+    options->hash_function = NDB_HASH_DEFAULT;
+    options->bloom_filter = 0;
+    options->memory_limit = 0;
+    options->spill_directory = NULL;
+}
+
+static long l2_cache_bytes(void) {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (size > 0) {
+        return size;
+    }
+#endif
+    return RADIX_DEFAULT_L2_BYTES;
+}
+
+// Enough bits that one partition's build table fits in L2
+static int choose_radix_bits(int build_rows, int probe_rows, int num_threads) {
+    int64_t build_bytes = (int64_t)build_rows * RADIX_BUILD_BYTES_PER_ROW;
+    long l2 = l2_cache_bytes();
+    int bits = 0;
+    while (bits < RADIX_MAX_BITS && (build_bytes >> bits) > l2) {
+        bits++;
+    }
+    // Several partitions per worker so uneven partitions still balance
+    if ((int64_t)build_rows + probe_rows >= RADIX_PARALLEL_MIN_ROWS) {
+        while (bits < RADIX_MAX_BITS && (1 << bits) < 4 * num_threads) {
+            bits++;
+        }
+    }
+    return bits;
+}
+
+static inline int radix_of(uint64_t hash, int shift, int bits) {
+    if (bits == 0) {
+        return 0;
+    }
+    return (int)((hash >> shift) & ((1u << bits) - 1));
+}
+
+static void chunk_bounds(int num_rows, int num_chunks, int chunk, int* start, int* end) {
+    int64_t per_chunk = ((int64_t)num_rows + num_chunks - 1) / num_chunks;
+    int64_t s = per_chunk * chunk;
+    int64_t e = s + per_chunk;
+    *start = (int)(s < num_rows ? s : num_rows);
+    *end = (int)(e < num_rows ? e : num_rows);
+}
+
+// =================== Partitioning ===================
+
+// Pass 1a: read and hash the keys of one input chunk, histogram them on the top bits
+static void pass1_histogram_task(void* context, int chunk, int worker_id) {
+    RadixPartitionJob* job = (RadixPartitionJob*)context;
+    (void)worker_id;
+    RadixRelation* rel = job->relation;
+    int fanout = 1 << job->bits1;
+    int* hist = rel->chunk_hist + (size_t)chunk * fanout;
+    int start, end;
+    chunk_bounds(rel->num_rows, job->num_chunks, chunk, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        rel->scratch_keys[i] = rel->codes ? rel->codes[i] :
+                               get_int_key_from_ndb_column(rel->table, rel->key_column, i);
+    }
+    ndb_hash_keys(rel->hash_function, rel->scratch_keys + start, rel->scratch_hashes + start, end - start);
+
+    memset(hist, 0, fanout * sizeof(int));
+    for (int i = start; i < end; i++) {
+        if (rel->nulls && (rel->nulls[i >> 6] >> (i & 63)) & 1) {
+            continue;
+        }
+        hist[radix_of(rel->scratch_hashes[i], 64 - job->bits1, job->bits1)]++;
+    }
+}
+
+// Pass 1b: scatter one input chunk to its precomputed partition cursors
+static void pass1_scatter_task(void* context, int chunk, int worker_id) {
+    RadixPartitionJob* job = (RadixPartitionJob*)context;
+    (void)worker_id;
+    RadixRelation* rel = job->relation;
+    int fanout = 1 << job->bits1;
+    int* cursor = rel->chunk_hist + (size_t)chunk * fanout;
+    int start, end;
+    chunk_bounds(rel->num_rows, job->num_chunks, chunk, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        if (rel->nulls && (rel->nulls[i >> 6] >> (i & 63)) & 1) {
+            continue;
+        }
+        uint64_t hash = rel->scratch_hashes[i];
+        int pos = cursor[radix_of(hash, 64 - job->bits1, job->bits1)]++;
+        rel->keys[pos] = rel->scratch_keys[i];
+        rel->rows[pos] = i;
+        rel->hashes[pos] = hash;
+    }
+}
+
+// Pass 2: refine one pass-1 partition on the next bits, into scratch and back
+static void pass2_task(void* context, int part1, int worker_id) {
+    RadixPartitionJob* job = (RadixPartitionJob*)context;
+    (void)worker_id;
+    RadixRelation* rel = job->relation;
+    int fanout2 = 1 << job->bits2;
+    int shift = 64 - job->bits1 - job->bits2;
+    int* bounds = rel->part_offsets + (size_t)part1 * fanout2;
+    int start = rel->pass1_offsets[part1];
+    int end = rel->pass1_offsets[part1 + 1];
+
+    int hist[1 << RADIX_MAX_BITS_PER_PASS];
+    memset(hist, 0, fanout2 * sizeof(int));
+    for (int i = start; i < end; i++) {
+        hist[radix_of(rel->hashes[i], shift, job->bits2)]++;
+    }
+
+    int pos = start;
+    for (int p = 0; p < fanout2; p++) {
+        int size = hist[p];
+        hist[p] = pos;
+        bounds[p] = pos;
+        pos += size;
+    }
+
+    for (int i = start; i < end; i++) {
+        int dst = hist[radix_of(rel->hashes[i], shift, job->bits2)]++;
+        rel->scratch_keys[dst] = rel->keys[i];
+        rel->scratch_rows[dst] = rel->rows[i];
+        rel->scratch_hashes[dst] = rel->hashes[i];
+    }
+    memcpy(rel->keys + start, rel->scratch_keys + start, (end - start) * sizeof(int32_t));
+    memcpy(rel->rows + start, rel->scratch_rows + start, (end - start) * sizeof(int32_t));
+    memcpy(rel->hashes + start, rel->scratch_hashes + start, (end - start) * sizeof(uint64_t));
+}
+
+static int partition_relation(ThreadPool* pool, RadixRelation* rel, int bits1, int bits2) {
+    int num_chunks = thread_pool_size(pool);
+    int fanout1 = 1 << bits1;
+    int fanout2 = 1 << bits2;
+    size_t n = rel->num_rows > 0 ? rel->num_rows : 1;
+
+    rel->keys = (int32_t*)malloc(n * sizeof(int32_t));
+    rel->rows = (int32_t*)malloc(n * sizeof(int32_t));
+    rel->scratch_keys = (int32_t*)malloc(n * sizeof(int32_t));
+    rel->scratch_rows = (int32_t*)malloc(n * sizeof(int32_t));
+    rel->hashes = (uint64_t*)malloc(n * sizeof(uint64_t));
+    rel->scratch_hashes = (uint64_t*)malloc(n * sizeof(uint64_t));
+    rel->chunk_hist = (int*)malloc((size_t)num_chunks * fanout1 * sizeof(int));
+    rel->pass1_offsets = (int*)malloc(((size_t)fanout1 + 1) * sizeof(int));
+    rel->part_offsets = (int*)malloc(((size_t)fanout1 * fanout2 + 1) * sizeof(int));
+    if (!rel->keys || !rel->rows || !rel->scratch_keys || !rel->scratch_rows ||
+        !rel->hashes || !rel->scratch_hashes || !rel->chunk_hist || !rel->pass1_offsets || !rel->part_offsets) {
+        return -1;
+    }
+
+    RadixPartitionJob job = {rel, num_chunks, bits1, bits2};
+    thread_pool_run(pool, pass1_histogram_task, &job, num_chunks);
+
+    // Partition-major prefix sum: chunk c writes partition p after chunks < c
+    int pos = 0;
+    for (int p = 0; p < fanout1; p++) {
+        rel->pass1_offsets[p] = pos;
+        rel->part_offsets[(size_t)p * fanout2] = pos;
+        for (int c = 0; c < num_chunks; c++) {
+            int* slot = &rel->chunk_hist[(size_t)c * fanout1 + p];
+            int size = *slot;
+            *slot = pos;
+            pos += size;
+        }
+    }
+    rel->pass1_offsets[fanout1] = pos;
+    rel->part_offsets[(size_t)fanout1 * fanout2] = pos;
+
+    thread_pool_run(pool, pass1_scatter_task, &job, num_chunks);
+    if (bits2 > 0) {
+        thread_pool_run(pool, pass2_task, &job, fanout1);
+    }
+    return 0;
+}
+
+static void free_radix_relation(RadixRelation* rel) {
+    free(rel->keys);
+    free(rel->rows);
+    free(rel->scratch_keys);
+    free(rel->scratch_rows);
+    free(rel->hashes);
+    free(rel->scratch_hashes);
+    free(rel->chunk_hist);
+    free(rel->pass1_offsets);
+    free(rel->part_offsets);
+}
+
+// =================== Build and probe ===================
+
+static void join_partition_task(void* context, int part, int worker_id) {
+    RadixJoinJob* job = (RadixJoinJob*)context;
+    (void)worker_id;
+    NDBRowPairs* out = &job->chunks[part];
+    int build_start = job->right->part_offsets[part];
+    int build_count = job->right->part_offsets[part + 1] - build_start;
+    int probe_start = job->left->part_offsets[part];
+    int probe_end = job->left->part_offsets[part + 1];
+
+    if (build_count == 0 && !ndb_join_keeps_left(job->join_type) && job->join_type != LEFT_ANTI_JOIN) {
+        return;
+    }
+
+    // Semi/anti: key set of the partition, one probe pass with early exit
+    if (ndb_join_is_semi(job->join_type)) {
+        HashTable key_set;
+        int probe_count = probe_end - probe_start;
+        if (init_hash_table(&key_set, build_count, job->right->hash_function) != 0 ||
+            build_hash_key_set(&key_set, job->right->keys + build_start, job->right->hashes + build_start,
+                               build_count) != 0 ||
+            (job->bloom_filter && build_hash_table_bloom(&key_set) != 0) ||
+            reserve_ndb_row_pairs(out, probe_count) != 0) {
+            free_hash_table(&key_set);
+            atomic_store(&job->failed, 1);
+            return;
+        }
+        out->count = probe_hash_key_set(&key_set, job->left->keys + probe_start, job->left->hashes + probe_start,
+                                        probe_count, 0, job->join_type == LEFT_ANTI_JOIN, out->left_rows);
+        for (int64_t k = 0; k < out->count; k++) {
+            out->left_rows[k] = job->left->rows[probe_start + out->left_rows[k]];
+            out->right_rows[k] = -1;
+        }
+        free_hash_table(&key_set);
+        return;
+    }
+
+    // RIGHT/FULL: build positions of this partition that found a match.
+    // Only this worker touches it, the atomics in marking never contend.
+    uint64_t* matched = ndb_join_keeps_right(job->join_type) ?
+                        calloc((size_t)build_count / 64 + 1, sizeof(uint64_t)) : NULL;
+    if (ndb_join_keeps_right(job->join_type) && !matched) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+
+    HashTable table;
+    if (init_hash_table(&table, build_count, job->right->hash_function) != 0 ||
+        build_hash_table(&table, job->right->keys + build_start, job->right->hashes + build_start,
+                         NULL, build_count) != 0 ||
+        (job->bloom_filter && build_hash_table_bloom(&table) != 0)) {
+        free_hash_table(&table);
+        free(matched);
+        atomic_store(&job->failed, 1);
+        return;
+    }
+
+    // Batch probe with the hashes computed during partitioning; the probe
+    // emits positions within the partition, mapped back to rows after
+    const int32_t* build_rows = job->right->rows + build_start;
+    HashProbeCursor cursor;
+    init_hash_probe_cursor(&cursor);
+    int probe_count = probe_end - probe_start;
+    while (cursor.key_idx < probe_count) {
+        if (reserve_ndb_row_pairs(out, RADIX_PROBE_RESERVE) != 0) {
+            atomic_store(&job->failed, 1);
+            break;
+        }
+        int64_t first = out->count;
+        out->count += probe_hash_batch(&table, job->left->keys + probe_start,
+                                       job->left->hashes + probe_start, probe_count, 0,
+                                       ndb_join_keeps_left(job->join_type), &cursor,
+                                       out->left_rows + first, out->right_rows + first,
+                                       (int)(out->capacity - first));
+        if (matched) {
+            mark_ndb_matched_rows(matched, out->right_rows + first, out->count - first);
+        }
+        for (int64_t k = first; k < out->count; k++) {
+            out->left_rows[k] = job->left->rows[probe_start + out->left_rows[k]];
+            if (out->right_rows[k] >= 0) {
+                out->right_rows[k] = build_rows[out->right_rows[k]];
+            }
+        }
+    }
+
+    // Unmatched build rows close the partition
+    if (matched && !atomic_load(&job->failed) &&
+        append_unmatched_ndb_rows(out, matched, build_count, build_rows) != 0) {
+        atomic_store(&job->failed, 1);
+    }
+
+    free(matched);
+    free_hash_table(&table);
+}
+
+// =================== Partitioned hash join ===================
+
+// Keys come from the key columns, or from codes when those are set.
+// Rows set in left_nulls / right_nulls (either may be NULL) have a NULL key.
+static void partitioned_join_on_keys(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    const int32_t* left_codes,
+    const int32_t* right_codes,
+    const uint64_t* left_nulls,
+    const uint64_t* right_nulls,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+) {
+    // Run on the shared pool unless a specific worker count was asked for
+    ThreadPool* owned_pool = options->num_threads > 0 ? create_thread_pool(options->num_threads) : NULL;
+    ThreadPool* pool = owned_pool ? owned_pool : get_default_thread_pool();
+    if (!pool) {
+        fprintf(stderr, "Error: failed to start join worker pool\n");
+        return;
+    }
+
+    int bits = options->radix_bits > 0 ? options->radix_bits :
+               choose_radix_bits(right_table->num_rows, left_table->num_rows,
+                                 thread_pool_size(pool));
+    if (bits > RADIX_MAX_BITS) {
+        bits = RADIX_MAX_BITS;
+    }
+    int passes = options->radix_passes > 0 ? options->radix_passes :
+                 (bits > RADIX_MAX_BITS_PER_PASS ? 2 : 1);
+    int bits1 = passes >= 2 ? (bits + 1) / 2 : bits;
+    int bits2 = bits - bits1;
+    if (bits1 > RADIX_MAX_BITS_PER_PASS || bits2 > RADIX_MAX_BITS_PER_PASS) {
+        bits1 = (bits + 1) / 2;
+        bits2 = bits - bits1;
+    }
+    int num_partitions = 1 << (bits1 + bits2);
+
+    RadixRelation left = {.table = left_table, .key_column = left_key_column, .codes = left_codes,
+                          .nulls = left_nulls, .num_rows = left_table->num_rows,
+                          .hash_function = options->hash_function};
+    RadixRelation right = {.table = right_table, .key_column = right_key_column, .codes = right_codes,
+                           .nulls = right_nulls, .num_rows = right_table->num_rows,
+                           .hash_function = options->hash_function};
+    NDBRowPairs null_keys;
+    init_ndb_row_pairs(&null_keys);
+    NDBRowPairs* chunks = (NDBRowPairs*)calloc(num_partitions, sizeof(NDBRowPairs));
+    // Partitions fit in cache, so a filter in front of each only pays off
+    // when asked for explicitly
+    RadixJoinJob job = {.left = &left, .right = &right, .join_type = join_type,
+                        .bloom_filter = options->bloom_filter > 0, .chunks = chunks};
+    atomic_init(&job.failed, 0);
+
+    if (!chunks ||
+        partition_relation(pool, &right, bits1, bits2) != 0 ||
+        partition_relation(pool, &left, bits1, bits2) != 0) {
+        fprintf(stderr, "Error: out of memory partitioning join inputs\n");
+        atomic_store(&job.failed, 1);
+    } else {
+        thread_pool_run(pool, join_partition_task, &job, num_partitions);
+        // NULL-key rows never match: the sides that keep unmatched rows
+        // get them after all partitions
+        if ((left_nulls && (ndb_join_keeps_left(join_type) || join_type == LEFT_ANTI_JOIN) &&
+             append_null_key_ndb_rows(&null_keys, left_nulls, left_table->num_rows, 1) != 0) ||
+            (right_nulls && ndb_join_keeps_right(join_type) &&
+             append_null_key_ndb_rows(&null_keys, right_nulls, right_table->num_rows, 0) != 0)) {
+            atomic_store(&job.failed, 1);
+        }
+        if (atomic_load(&job.failed)) {
+            fprintf(stderr, "Error: out of memory joining partitions\n");
+        }
+    }
+
+    // Concatenate the partition results in partition order
+    int failed = atomic_load(&job.failed);
+    for (int p = 0; chunks && !failed && p < num_partitions; p++) {
+        emit_ndb_row_pairs(&chunks[p], 0, chunks[p].count, left_table, right_table,
+                           result_table, result_row_count, match_processor, unmatch_processor);
+    }
+    if (!failed) {
+        emit_ndb_row_pairs(&null_keys, 0, null_keys.count, left_table, right_table,
+                           result_table, result_row_count, match_processor, unmatch_processor);
+    }
+    free_ndb_row_pairs(&null_keys);
+
+    for (int p = 0; chunks && p < num_partitions; p++) {
+        free_ndb_row_pairs(&chunks[p]);
+    }
+    free(chunks);
+    free_radix_relation(&left);
+    free_radix_relation(&right);
+    free_thread_pool(owned_pool);
+}
+
+void partitioned_ndb_hash_join(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    int left_key_column,
+    int right_key_column,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+) {
+    partitioned_ndb_hash_join_multi(left_table, right_table, &left_key_column, &right_key_column, 1,
+                                    join_type, result_table, result_row_count,
+                                    match_processor, unmatch_processor, options);
+}
+
+void partitioned_ndb_hash_join_multi(
+    const NDBTableC* left_table,
+    const NDBTableC* right_table,
+    const int* left_key_columns,
+    const int* right_key_columns,
+    int num_key_columns,
+    JoinType join_type,
+    NDBTableC* result_table,
+    int* result_row_count,
+    ProcessNDBMatchFunc match_processor,
+    ProcessNDBUnmatchedFunc unmatch_processor,
+    const NDBJoinOptions* options
+) {
+    NDBJoinOptions defaults;
+    if (!options) {
+        init_ndb_join_options(&defaults);
+        options = &defaults;
+    }
+    *result_row_count = 0;
+
+    if (!valid_ndb_join_key_columns(left_table, left_key_columns, right_table, right_key_columns,
+                                    num_key_columns)) {
+        return;
+    }
+
+    uint64_t* left_nulls = NULL;
+    uint64_t* right_nulls = NULL;
+    if (find_ndb_null_keys(left_table, left_key_columns, num_key_columns, &left_nulls) != 0 ||
+        find_ndb_null_keys(right_table, right_key_columns, num_key_columns, &right_nulls) != 0) {
+        fprintf(stderr, "Error: failed to allocate NULL key bitmaps\n");
+        free(left_nulls);
+        return;
+    }
+
+    NDBKeyCodes codes;
+    if (!ndb_join_keys_need_codes(left_table, left_key_columns, right_table, right_key_columns,
+                                  num_key_columns)) {
+        partitioned_join_on_keys(left_table, right_table, left_key_columns[0], right_key_columns[0],
+                                 NULL, NULL, left_nulls, right_nulls, join_type, result_table, result_row_count,
+                                 match_processor, unmatch_processor, options);
+    } else if (encode_ndb_join_keys(left_table, left_key_columns, right_table, right_key_columns,
+                                    num_key_columns, &codes) == 0) {
+        partitioned_join_on_keys(left_table, right_table, -1, -1, codes.left, codes.right,
+                                 left_nulls, right_nulls, join_type, result_table, result_row_count,
+                                 match_processor, unmatch_processor, options);
+        free_ndb_key_codes(&codes);
+    }
+    free(left_nulls);
+    free(right_nulls);
+}
@@ -0,0 +1,102 @@
+#include "columnar_rel_runtime.h"
+#include "columnar_hashjoin.h"
+#include "columnar_hashtable.h"
+#include "columnar_keys.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// =================== Scans ===================
+
+int32_t ndb_rel_num_rows(const NDBTableC* table) {
+    return table ? table->num_rows : 0;
+}
+
+const int32_t* ndb_rel_int_column(const NDBTableC* table, int32_t column) {
+    if (!table || column < 0 || column >= table->num_columns || table->columns[column].type_id != 0) {
+        fprintf(stderr, "Error: rel pipeline reads column %d, which is not an int32 column\n", column);
+        return NULL;
+    }
+    return (const int32_t*)table->columns[column].values;
+}
+
+// =================== Hash tables ===================
+
+HashTable* ndb_rel_hash_build(const NDBTableC* table, int32_t key_column) {
+    if (!ndb_rel_int_column(table, key_column)) {
+        return NULL;
+    }
+    HashTable* hash_table = (HashTable*)malloc(sizeof(HashTable));
+    int32_t* keys = (int32_t*)malloc((table->num_rows > 0 ? table->num_rows : 1) * sizeof(int32_t));
+    int32_t* rows = (int32_t*)malloc((table->num_rows > 0 ? table->num_rows : 1) * sizeof(int32_t));
+    uint64_t* nulls = NULL;
+    if (!hash_table || !keys || !rows || find_ndb_null_keys(table, &key_column, 1, &nulls) != 0) {
+        free(hash_table);
+        free(keys);
+        free(rows);
+        return NULL;
+    }
+    // NULL keys match nothing, so their rows stay out of the table
+    int count = table->num_rows;
+    if (nulls) {
+        count = compact_ndb_non_null_keys(ndb_rel_int_column(table, key_column), nulls, count, keys, rows);
+    } else {
+        for (int i = 0; i < count; i++) {
+            keys[i] = get_int_key_from_ndb_column(table, key_column, i);
+        }
+    }
+
+    int status = init_hash_table(hash_table, count, NDB_HASH_DEFAULT);
+    if (status == 0) {
+        status = build_hash_table(hash_table, keys, NULL, nulls ? rows : NULL, count);
+        if (status != 0) {
+            free_hash_table(hash_table);
+        }
+    }
+    free(keys);
+    free(rows);
+    free(nulls);
+    if (status != 0) {
+        fprintf(stderr, "Error: failed to build hash table for %d rows\n", table->num_rows);
+        free(hash_table);
+        return NULL;
+    }
+    return hash_table;
+}
+
+void ndb_rel_hash_free(HashTable* table) {
+    if (table) {
+        free_hash_table(table);
+        free(table);
+    }
+}
+
+int32_t ndb_rel_lookup(const HashTable* table, int32_t key) {
+    return table ? lookup_hash(table, key) : -1;
+}
+
+const int32_t* ndb_rel_group_offsets(const HashTable* table) {
+    return table ? table->group_offsets : NULL;
+}
+
+const int32_t* ndb_rel_group_rows(const HashTable* table) {
+    return table ? table->row_ids : NULL;
+}
+
+// =================== Output ===================
+
+int32_t ndb_rel_append_int_row(NDBTableC* table, const int32_t* values, int32_t count) {
+    int row = table->num_rows;
+    int status = count <= table->num_columns ? 0 : -1;
+    for (int c = 0; c < count && status == 0; c++) {
+        status = table->columns[c].type_id == 0 ? 0 : -1;
+    }
+    if (status != 0 || reserve_ndb_table_rows(table, row + 1) != 0) {
+        fprintf(stderr, "Error: failed to append row %d to rel pipeline output\n", row);
+        return -1;
+    }
+    for (int c = 0; c < count; c++) {
+        ((int32_t*)table->columns[c].values)[row] = values[c];
+    }
+    table->num_rows = row + 1;
+    return 0;
+}
@@ -0,0 +1,393 @@
+#include "columnar_simd.h"
+#include "columnar_bloom.h"
+#include "columnar_hashtable.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define COLUMNAR_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define COLUMNAR_SIMD_X86 0
+#endif
+
+#define TAG_SLOT_MASK 0x7F
+#define TAG_EMPTY_BIT 0x80
+#define BYTE_REPEAT 0x0101010101010101ULL
+#define CRC32C_POLY 0x82F63B78u         // Reflected Castagnoli polynomial
+#define CRC32C_SEED 0xFFFFFFFFu
+
+typedef void (*HashKeysKernel)(const int32_t* keys, uint64_t* hashes, int count);
+typedef void (*MatchTagsKernel)(const HashBucket* buckets, uint64_t bucket_mask,
+                                const uint64_t* hashes, uint8_t* masks, int count);
+typedef void (*BloomTestKernel)(const uint64_t* blocks, uint64_t block_mask,
+                                const uint64_t* hashes, int count, uint64_t* pass);
+
+static uint32_t crc32c_table[256];
+
+// =================== Scalar kernels ===================
+
+static void hash_keys_scalar(const int32_t* keys, uint64_t* hashes, int count) {
+    for (int i = 0; i < count; i++) {
+        hashes[i] = multiply_shift_hash32(keys[i]);
+    }
+}
+
+static void init_crc32c_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc32c_table[i] = crc;
+    }
+}
+
+// Same as the crc32 instruction: no pre/post inversion, little-endian bytes
+static inline uint32_t crc32c_u32_soft(uint32_t crc, uint32_t value) {
+    crc ^= value;
+    for (int b = 0; b < 4; b++) {
+        crc = crc32c_table[crc & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void crc32c_keys_scalar(const int32_t* keys, uint64_t* hashes, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t lo = crc32c_u32_soft(CRC32C_SEED, (uint32_t)keys[i]);
+        uint32_t hi = crc32c_u32_soft(lo, (uint32_t)keys[i]);
+        hashes[i] = ((uint64_t)hi << 32) | lo;
+    }
+}
+
+// High bit of every zero byte of word (exact, unlike the borrow trick)
+static inline uint64_t zero_bytes(uint64_t word) {
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    return ~(((word & low7) + low7) | word | low7);
+}
+
+// Gather the high bits of the eight bytes into bits 0..7
+static inline uint8_t byte_high_bits(uint64_t high_bits) {
+    return (uint8_t)(((high_bits >> 7) * 0x0102040810204080ULL) >> 56);
+}
+
+// SWAR: compare all eight tag bytes of the home bucket at once
+static inline uint8_t match_tags_word(uint64_t tag_word, uint8_t tag) {
+    uint8_t match = byte_high_bits(zero_bytes(tag_word ^ (tag * BYTE_REPEAT))) & TAG_SLOT_MASK;
+    uint8_t empty = byte_high_bits(zero_bytes(tag_word)) & TAG_SLOT_MASK;
+    return (uint8_t)(match | (empty ? TAG_EMPTY_BIT : 0));
+}
+
+static void match_tags_scalar(const HashBucket* buckets, uint64_t bucket_mask,
+                              const uint64_t* hashes, uint8_t* masks, int count) {
+    for (int i = 0; i < count; i++) {
+        uint64_t tag_word;
+        memcpy(&tag_word, buckets[hash_bucket_index(hashes[i], bucket_mask)].tags, sizeof(tag_word));
+        masks[i] = match_tags_word(tag_word, hash_tag(hashes[i]));
+    }
+}
+
+// Hashes [first, count); the vector kernels finish their tail with it
+static void bloom_test_range(const uint64_t* blocks, uint64_t block_mask,
+                             const uint64_t* hashes, int first, int count, uint64_t* pass) {
+    for (int i = first; i < count; i++) {
+        uint64_t bits = ndb_bloom_bits(hashes[i]);
+        uint64_t hit = (blocks[ndb_bloom_block(hashes[i], block_mask)] & bits) == bits;
+        if ((i & 63) == 0) {
+            pass[i >> 6] = 0;
+        }
+        pass[i >> 6] |= hit << (i & 63);
+    }
+}
+
+static void bloom_test_scalar(const uint64_t* blocks, uint64_t block_mask,
+                              const uint64_t* hashes, int count, uint64_t* pass) {
+    bloom_test_range(blocks, block_mask, hashes, 0, count, pass);
+}
+
+#if COLUMNAR_SIMD_X86
+
+// Split the per-lane byte masks of a compare into slot bits plus empty bit
+static inline uint8_t lane_mask(uint64_t match_bits, uint64_t empty_bits, int lane) {
+    uint8_t match = (uint8_t)((match_bits >> (8 * lane)) & TAG_SLOT_MASK);
+    uint8_t empty = (uint8_t)((empty_bits >> (8 * lane)) & TAG_SLOT_MASK);
+    return (uint8_t)(match | (empty ? TAG_EMPTY_BIT : 0));
+}
+
+// =================== SSE4.2 kernels ===================
+
+__attribute__((target("sse4.2")))
+static void crc32c_keys_sse42(const int32_t* keys, uint64_t* hashes, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t lo = _mm_crc32_u32(CRC32C_SEED, (uint32_t)keys[i]);
+        uint32_t hi = _mm_crc32_u32(lo, (uint32_t)keys[i]);
+        hashes[i] = ((uint64_t)hi << 32) | lo;
+    }
+}
+
+// =================== AVX2 kernels ===================
+
+// (uint64)k * C for four zero-extended keys: C = c_hi * 2^32 + c_lo
+__attribute__((target("avx2")))
+static inline __m256i multiply_shift_avx2(__m256i keys64, __m256i c_lo, __m256i c_hi) {
+    __m256i lo = _mm256_mul_epu32(keys64, c_lo);
+    __m256i hi = _mm256_mul_epu32(keys64, c_hi);
+    __m256i product = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+    return _mm256_xor_si256(product, _mm256_srli_epi64(product, 32));
+}
+
+__attribute__((target("avx2")))
+static void hash_keys_avx2(const int32_t* keys, uint64_t* hashes, int count) {
+    const __m256i c_lo = _mm256_set1_epi64x((long long)(MULTIPLY_SHIFT_CONSTANT & 0xFFFFFFFFULL));
+    const __m256i c_hi = _mm256_set1_epi64x((long long)(MULTIPLY_SHIFT_CONSTANT >> 32));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i k = _mm256_loadu_si256((const __m256i*)(keys + i));
+        __m256i k_lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(k));
+        __m256i k_hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(k, 1));
+        _mm256_storeu_si256((__m256i*)(hashes + i), multiply_shift_avx2(k_lo, c_lo, c_hi));
+        _mm256_storeu_si256((__m256i*)(hashes + i + 4), multiply_shift_avx2(k_hi, c_lo, c_hi));
+    }
+    hash_keys_scalar(keys + i, hashes + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void match_tags_avx2(const HashBucket* buckets, uint64_t bucket_mask,
+                            const uint64_t* hashes, uint8_t* masks, int count) {
+    const __m256i mask_v = _mm256_set1_epi64x((long long)bucket_mask);
+    const __m256i tag_bits = _mm256_set1_epi64x(TAG_SLOT_MASK);
+    const __m256i occupied = _mm256_set1_epi64x(HASH_TAG_OCCUPIED);
+    const __m256i repeat = _mm256_set1_epi64x(0x01010101);
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i h = _mm256_loadu_si256((const __m256i*)(hashes + i));
+        __m256i offsets = _mm256_slli_epi64(_mm256_and_si256(h, mask_v), 6);
+        __m256i words = _mm256_i64gather_epi64((const long long*)buckets, offsets, 1);
+
+        // Broadcast each lane's tag into all eight bytes of the lane
+        __m256i tag = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(h, 32), tag_bits), occupied);
+        __m256i tag32 = _mm256_mul_epu32(tag, repeat);
+        __m256i tags = _mm256_or_si256(tag32, _mm256_slli_epi64(tag32, 32));
+
+        uint32_t match = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(words, tags));
+        uint32_t empty = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(words, zero));
+        for (int lane = 0; lane < 4; lane++) {
+            masks[i + lane] = lane_mask(match, empty, lane);
+        }
+    }
+    // The compiler emits no vzeroupper before this tail call; dirty upper
+    // halves would slow down all following SSE code
+    _mm256_zeroupper();
+    match_tags_scalar(buckets, bucket_mask, hashes + i, masks + i, count - i);
+}
+
+// 1 << (shift & 63) for the four 6-bit fields of the hash at 0, 6, 12, 18
+__attribute__((target("avx2")))
+static inline __m256i bloom_bits_avx2(__m256i h) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i low6 = _mm256_set1_epi64x(63);
+    __m256i bits = _mm256_sllv_epi64(one, _mm256_and_si256(h, low6));
+    bits = _mm256_or_si256(bits, _mm256_sllv_epi64(one, _mm256_and_si256(_mm256_srli_epi64(h, 6), low6)));
+    bits = _mm256_or_si256(bits, _mm256_sllv_epi64(one, _mm256_and_si256(_mm256_srli_epi64(h, 12), low6)));
+    return _mm256_or_si256(bits, _mm256_sllv_epi64(one, _mm256_and_si256(_mm256_srli_epi64(h, 18), low6)));
+}
+
+__attribute__((target("avx2")))
+static void bloom_test_avx2(const uint64_t* blocks, uint64_t block_mask,
+                            const uint64_t* hashes, int count, uint64_t* pass) {
+    const __m256i mask_v = _mm256_set1_epi64x((long long)block_mask);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i h = _mm256_loadu_si256((const __m256i*)(hashes + i));
+        __m256i index = _mm256_and_si256(_mm256_srli_epi64(h, 32), mask_v);
+        __m256i words = _mm256_i64gather_epi64((const long long*)blocks, index, 8);
+        __m256i bits = bloom_bits_avx2(h);
+        __m256i hit = _mm256_cmpeq_epi64(_mm256_and_si256(words, bits), bits);
+        if ((i & 63) == 0) {
+            pass[i >> 6] = 0;
+        }
+        pass[i >> 6] |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(hit)) << (i & 63);
+    }
+    _mm256_zeroupper();
+    bloom_test_range(blocks, block_mask, hashes, i, count, pass);
+}
+
+// =================== AVX-512 kernels ===================
+
+__attribute__((target("avx512f")))
+static inline __m512i multiply_shift_avx512(__m512i keys64, __m512i c_lo, __m512i c_hi) {
+    __m512i lo = _mm512_mul_epu32(keys64, c_lo);
+    __m512i hi = _mm512_mul_epu32(keys64, c_hi);
+    __m512i product = _mm512_add_epi64(lo, _mm512_slli_epi64(hi, 32));
+    return _mm512_xor_si512(product, _mm512_srli_epi64(product, 32));
+}
+
+__attribute__((target("avx512f")))
+static void hash_keys_avx512(const int32_t* keys, uint64_t* hashes, int count) {
+    const __m512i c_lo = _mm512_set1_epi64((long long)(MULTIPLY_SHIFT_CONSTANT & 0xFFFFFFFFULL));
+    const __m512i c_hi = _mm512_set1_epi64((long long)(MULTIPLY_SHIFT_CONSTANT >> 32));
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i k = _mm512_loadu_si512((const void*)(keys + i));
+        __m512i k_lo = _mm512_cvtepu32_epi64(_mm512_castsi512_si256(k));
+        __m512i k_hi = _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(k, 1));
+        _mm512_storeu_si512((void*)(hashes + i), multiply_shift_avx512(k_lo, c_lo, c_hi));
+        _mm512_storeu_si512((void*)(hashes + i + 8), multiply_shift_avx512(k_hi, c_lo, c_hi));
+    }
+    hash_keys_scalar(keys + i, hashes + i, count - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void match_tags_avx512(const HashBucket* buckets, uint64_t bucket_mask,
+                              const uint64_t* hashes, uint8_t* masks, int count) {
+    const __m512i mask_v = _mm512_set1_epi64((long long)bucket_mask);
+    const __m512i tag_bits = _mm512_set1_epi64(TAG_SLOT_MASK);
+    const __m512i occupied = _mm512_set1_epi64(HASH_TAG_OCCUPIED);
+    const __m512i repeat = _mm512_set1_epi64(0x01010101);
+    const __m512i zero = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i h = _mm512_loadu_si512((const void*)(hashes + i));
+        __m512i offsets = _mm512_slli_epi64(_mm512_and_si512(h, mask_v), 6);
+        __m512i words = _mm512_i64gather_epi64(offsets, (const void*)buckets, 1);
+
+        __m512i tag = _mm512_or_si512(_mm512_and_si512(_mm512_srli_epi64(h, 32), tag_bits), occupied);
+        __m512i tag32 = _mm512_mul_epu32(tag, repeat);
+        __m512i tags = _mm512_or_si512(tag32, _mm512_slli_epi64(tag32, 32));
+
+        uint64_t match = _mm512_cmpeq_epi8_mask(words, tags);
+        uint64_t empty = _mm512_cmpeq_epi8_mask(words, zero);
+        for (int lane = 0; lane < 8; lane++) {
+            masks[i + lane] = lane_mask(match, empty, lane);
+        }
+    }
+    // The compiler emits no vzeroupper before this tail call; dirty upper
+    // halves would slow down all following SSE code
+    _mm256_zeroupper();
+    match_tags_scalar(buckets, bucket_mask, hashes + i, masks + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void bloom_test_avx512(const uint64_t* blocks, uint64_t block_mask,
+                              const uint64_t* hashes, int count, uint64_t* pass) {
+    const __m512i mask_v = _mm512_set1_epi64((long long)block_mask);
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i low6 = _mm512_set1_epi64(63);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i h = _mm512_loadu_si512((const void*)(hashes + i));
+        __m512i index = _mm512_and_si512(_mm512_srli_epi64(h, 32), mask_v);
+        __m512i words = _mm512_i64gather_epi64(index, (const void*)blocks, 8);
+        __m512i bits = _mm512_sllv_epi64(one, _mm512_and_si512(h, low6));
+        bits = _mm512_or_si512(bits, _mm512_sllv_epi64(one, _mm512_and_si512(_mm512_srli_epi64(h, 6), low6)));
+        bits = _mm512_or_si512(bits, _mm512_sllv_epi64(one, _mm512_and_si512(_mm512_srli_epi64(h, 12), low6)));
+        bits = _mm512_or_si512(bits, _mm512_sllv_epi64(one, _mm512_and_si512(_mm512_srli_epi64(h, 18), low6)));
+        __mmask8 hit = _mm512_cmpeq_epi64_mask(_mm512_and_si512(words, bits), bits);
+        if ((i & 63) == 0) {
+            pass[i >> 6] = 0;
+        }
+        pass[i >> 6] |= (uint64_t)hit << (i & 63);
+    }
+    _mm256_zeroupper();
+    bloom_test_range(blocks, block_mask, hashes, i, count, pass);
+}
+
+#endif /* COLUMNAR_SIMD_X86 */
+
+// =================== Runtime dispatch ===================
+
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+static SimdLevel detected_level = SIMD_LEVEL_SCALAR;
+static SimdLevel active_level = SIMD_LEVEL_SCALAR;
+static HashKeysKernel hash_keys_kernel = hash_keys_scalar;
+static HashKeysKernel crc32c_keys_kernel = crc32c_keys_scalar;
+static MatchTagsKernel match_tags_kernel = match_tags_scalar;
+static BloomTestKernel bloom_test_kernel = bloom_test_scalar;
+
+static void select_kernels(SimdLevel level) {
+    active_level = level;
+    switch (level) {
+#if COLUMNAR_SIMD_X86
+    case SIMD_LEVEL_AVX512:
+        hash_keys_kernel = hash_keys_avx512;
+        crc32c_keys_kernel = crc32c_keys_sse42;
+        match_tags_kernel = match_tags_avx512;
+        bloom_test_kernel = bloom_test_avx512;
+        break;
+    case SIMD_LEVEL_AVX2:
+        // Every AVX2 CPU also implements SSE4.2
+        hash_keys_kernel = hash_keys_avx2;
+        crc32c_keys_kernel = crc32c_keys_sse42;
+        match_tags_kernel = match_tags_avx2;
+        bloom_test_kernel = bloom_test_avx2;
+        break;
+#endif
+    default:
+        active_level = SIMD_LEVEL_SCALAR;
+        hash_keys_kernel = hash_keys_scalar;
+        crc32c_keys_kernel = crc32c_keys_scalar;
+        match_tags_kernel = match_tags_scalar;
+        bloom_test_kernel = bloom_test_scalar;
+        break;
+    }
+}
+
+static void detect_cpu(void) {
+    init_crc32c_table();
+#if COLUMNAR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        detected_level = SIMD_LEVEL_AVX512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        detected_level = SIMD_LEVEL_AVX2;
+    }
+#endif
+    select_kernels(detected_level);
+}
+
+SimdLevel simd_detected_level(void) {
+    pthread_once(&dispatch_once, detect_cpu);
+    return detected_level;
+}
+
+SimdLevel simd_active_level(void) {
+    pthread_once(&dispatch_once, detect_cpu);
+    return active_level;
+}
+
+void simd_set_level(SimdLevel level) {
+    pthread_once(&dispatch_once, detect_cpu);
+    select_kernels(level < detected_level ? level : detected_level);
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SIMD_LEVEL_AVX512: return "avx512";
+    case SIMD_LEVEL_AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+void simd_multiply_shift_keys(const int32_t* keys, uint64_t* hashes, int count) {
+    pthread_once(&dispatch_once, detect_cpu);
+    hash_keys_kernel(keys, hashes, count);
+}
+
+void simd_crc32c_keys(const int32_t* keys, uint64_t* hashes, int count) {
+    pthread_once(&dispatch_once, detect_cpu);
+    crc32c_keys_kernel(keys, hashes, count);
+}
+
+void simd_match_bucket_tags(const HashBucket* buckets, uint64_t bucket_mask,
+                            const uint64_t* hashes, uint8_t* masks, int count) {
+    pthread_once(&dispatch_once, detect_cpu);
+    match_tags_kernel(buckets, bucket_mask, hashes, masks, count);
+}
+
+void simd_test_bloom_blocks(const uint64_t* blocks, uint64_t block_mask,
+                            const uint64_t* hashes, int count, uint64_t* pass) {
+    pthread_once(&dispatch_once, detect_cpu);
+    bloom_test_kernel(blocks, block_mask, hashes, count, pass);
+}
@@ -0,0 +1,87 @@
+#include "columnar_hashjoin.h"
+#include "columnar_types.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// =================== String column builder ===================
+
+// Make room for count more rows and extra_bytes more characters
+static int builder_reserve(NDBStringBuilder* builder, int count, int64_t extra_bytes) {
+    NDBArrayC* array = &builder->table->columns[builder->column_idx];
+    if ((int64_t)builder->row + count > INT32_MAX - 1) {
+        return -1;
+    }
+    if (builder->row + count > array->length &&
+        reserve_ndb_table_rows(builder->table, builder->row + count) != 0) {
+        return -1;
+    }
+    if (builder->tail + extra_bytes > array->value_capacity &&
+        reserve_ndb_string_bytes(builder->table, builder->column_idx, builder->tail + extra_bytes) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int init_ndb_string_builder(NDBStringBuilder* builder, NDBTableC* table, int column_idx, int row) {
+    if (column_idx < 0 || column_idx >= table->num_columns || row < 0 ||
+        table->columns[column_idx].type_id != NDB_TYPE_STRING) {
+        return -1;
+    }
+    // Only rows the table counts are known to be written; the buffers
+    // themselves start uninitialized
+    if (row > table->num_rows) {
+        fprintf(stderr, "Error: string column %d starts at row %d past the %d rows of its table\n",
+                column_idx, row, table->num_rows);
+        return -1;
+    }
+    builder->table = table;
+    builder->column_idx = column_idx;
+    builder->row = row;
+    builder->tail = 0;
+    if (builder_reserve(builder, 1, 0) != 0) {
+        return -1;
+    }
+    // Rows are written in order, so offsets[row] is where row - 1 ended
+    builder->tail = table->columns[column_idx].offsets[row];
+    return 0;
+}
+
+int append_ndb_string(NDBStringBuilder* builder, const char* str, int str_len) {
+    if (builder_reserve(builder, 1, str_len) != 0) {
+        return -1;
+    }
+    NDBArrayC* array = &builder->table->columns[builder->column_idx];
+    if (str_len > 0) {
+        memcpy((char*)array->values + builder->tail, str, str_len);
+    }
+    builder->tail += str_len;
+    array->offsets[++builder->row] = builder->tail;
+    return 0;
+}
+
+int append_ndb_string_run(NDBStringBuilder* builder, const NDBArrayC* src, int src_row, int count) {
+    if (count <= 0) {
+        return 0;
+    }
+    const int32_t* src_offsets = src->offsets;
+    int32_t base = src_offsets[src_row];
+    int32_t bytes = src_offsets[src_row + count] - base;
+    if (builder_reserve(builder, count, bytes) != 0) {
+        return -1;
+    }
+
+    // One copy for the characters, the offsets only need rebasing
+    NDBArrayC* array = &builder->table->columns[builder->column_idx];
+    memcpy((char*)array->values + builder->tail, (const char*)src->values + base, bytes);
+    int32_t* dst_offsets = array->offsets + builder->row + 1;
+    int32_t shift = builder->tail - base;
+    for (int i = 0; i < count; i++) {
+        dst_offsets[i] = src_offsets[src_row + i + 1] + shift;
+    }
+    builder->row += count;
+    builder->tail += bytes;
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include "columnar_threadpool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEQUE_ALIGNMENT 64
+
+// Morsel deque of one worker: morsels [head, tail) are still queued. The
+// owner pops from the head, thieves take the upper half from the tail.
+typedef struct {
+    _Alignas(DEQUE_ALIGNMENT) pthread_mutex_t lock;
+    int64_t head;
+    int64_t tail;
+} MorselDeque;
+
+struct ThreadPool {
+    pthread_t* threads;
+    MorselDeque* deques;            // One per worker, cache-line aligned
+    int num_threads;
+
+    pthread_mutex_t run_lock;       // Serializes jobs of concurrent callers
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;      // Signalled when a new job is published
+    pthread_cond_t work_done;       // Signalled when the last worker leaves a job
+
+    // Current job, guarded by lock
+    ThreadPoolMorselFunc morsel;
+    void* context;
+    int64_t begin;
+    int64_t end;
+    int64_t morsel_size;
+    int active_workers;
+    unsigned long generation;       // Bumped for every job
+    int shutdown;
+};
+
+typedef struct {
+    ThreadPool* pool;
+    int worker_id;
+} WorkerArgs;
+
+typedef struct {
+    ThreadPoolTaskFunc task;
+    void* context;
+} TaskAdapter;
+
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+static ThreadPool* default_pool = NULL;
+
+int online_core_count(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+static int pop_morsel(MorselDeque* deque, int64_t* morsel_idx) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *morsel_idx = deque->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Move half of some victim's queued morsels into the thief's own deque
+static int steal_morsels(ThreadPool* pool, int thief) {
+    for (int i = 1; i < pool->num_threads; i++) {
+        MorselDeque* victim = &pool->deques[(thief + i) % pool->num_threads];
+        int64_t start = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        int64_t remaining = victim->tail - victim->head;
+        if (remaining > 0) {
+            int64_t take = (remaining + 1) / 2;
+            end = victim->tail;
+            start = end - take;
+            victim->tail = start;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (end > start) {
+            MorselDeque* own = &pool->deques[thief];
+            pthread_mutex_lock(&own->lock);
+            own->head = start;
+            own->tail = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_morsels(ThreadPool* pool, int worker_id, ThreadPoolMorselFunc morsel,
+                        void* context, int64_t begin, int64_t end, int64_t morsel_size) {
+    MorselDeque* own = &pool->deques[worker_id];
+    for (;;) {
+        int64_t idx;
+        if (pop_morsel(own, &idx)) {
+            int64_t start = begin + idx * morsel_size;
+            int64_t stop = start + morsel_size < end ? start + morsel_size : end;
+            morsel(context, start, stop, worker_id);
+            continue;
+        }
+        // No new morsels are ever produced, so once every deque looked
+        // empty the remaining work is held by workers already running it
+        if (!steal_morsels(pool, worker_id)) {
+            return;
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    ThreadPool* pool = args->pool;
+    int worker_id = args->worker_id;
+    free(args);
+
+    unsigned long seen_generation = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen_generation) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen_generation = pool->generation;
+        ThreadPoolMorselFunc morsel = pool->morsel;
+        void* context = pool->context;
+        int64_t begin = pool->begin;
+        int64_t end = pool->end;
+        int64_t morsel_size = pool->morsel_size;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_morsels(pool, worker_id, morsel, context, begin, end, morsel_size);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active_workers == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool* create_thread_pool(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = online_core_count();
+    }
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    pool->deques = (MorselDeque*)aligned_alloc(DEQUE_ALIGNMENT, num_threads * sizeof(MorselDeque));
+    if (!pool->threads || !pool->deques) {
+        free(pool->threads);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].head = 0;
+        pool->deques[i].tail = 0;
+    }
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    // Workers only read num_threads once a job is published, so the pool
+    // is complete before any of them looks at another worker's deque
+    for (int i = 0; i < num_threads; i++) {
+        WorkerArgs* args = (WorkerArgs*)malloc(sizeof(WorkerArgs));
+        if (args) {
+            args->pool = pool;
+            args->worker_id = i;
+        }
+        if (!args || pthread_create(&pool->threads[i], NULL, worker_main, args) != 0) {
+            fprintf(stderr, "Error: failed to start worker thread %d\n", i);
+            free(args);
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        free_thread_pool(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void free_thread_pool(ThreadPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool* pool) {
+    return pool->num_threads;
+}
+
+static void create_default_pool(void) {
+    default_pool = create_thread_pool(0);
+}
+
+ThreadPool* get_default_thread_pool(void) {
+    pthread_once(&default_pool_once, create_default_pool);
+    return default_pool;
+}
+
+void thread_pool_parallel_for(ThreadPool* pool, int64_t begin, int64_t end, int64_t morsel_size,
+                              ThreadPoolMorselFunc morsel, void* context) {
+    if (end <= begin) {
+        return;
+    }
+    if (morsel_size <= 0) {
+        morsel_size = 1;
+    }
+    int64_t num_morsels = (end - begin + morsel_size - 1) / morsel_size;
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+
+    // Hand every worker a contiguous share of the morsels
+    for (int w = 0; w < pool->num_threads; w++) {
+        MorselDeque* deque = &pool->deques[w];
+        pthread_mutex_lock(&deque->lock);
+        deque->head = num_morsels * w / pool->num_threads;
+        deque->tail = num_morsels * (w + 1) / pool->num_threads;
+        pthread_mutex_unlock(&deque->lock);
+    }
+
+    pool->morsel = morsel;
+    pool->context = context;
+    pool->begin = begin;
+    pool->end = end;
+    pool->morsel_size = morsel_size;
+    pool->active_workers = pool->num_threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+
+    while (pool->active_workers > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+static void run_task_morsel(void* context, int64_t start, int64_t end, int worker_id) {
+    TaskAdapter* adapter = (TaskAdapter*)context;
+    for (int64_t idx = start; idx < end; idx++) {
+        adapter->task(adapter->context, (int)idx, worker_id);
+    }
+}
+
+void thread_pool_run(ThreadPool* pool, ThreadPoolTaskFunc task, void* context, int num_tasks) {
+    TaskAdapter adapter = {task, context};
+    thread_pool_parallel_for(pool, 0, num_tasks, 1, run_task_morsel, &adapter);
+}
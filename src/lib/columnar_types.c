@@ -0,0 +1,198 @@
+#include "columnar_types.h"
+#include "columnar_hashjoin.h"
+#include "columnar_keys.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =================== Type registry ===================
+
+static const NDBTypeInfo type_registry[NDB_NUM_TYPES] = {
+    [NDB_TYPE_INT32] = {"int32", sizeof(int32_t), NDB_TYPE_INT32, 1, 0},
+    [NDB_TYPE_STRING] = {"string", 0, NDB_TYPE_STRING, 0, 0},
+    [NDB_TYPE_INT64] = {"int64", sizeof(int64_t), NDB_TYPE_INT64, 0, 0},
+    [NDB_TYPE_FLOAT64] = {"float64", sizeof(double), NDB_TYPE_FLOAT64, 0, 0},
+    [NDB_TYPE_DATE32] = {"date32", sizeof(int32_t), NDB_TYPE_DATE32, 1, 0},
+    [NDB_TYPE_TIMESTAMP] = {"timestamp", sizeof(int64_t), NDB_TYPE_TIMESTAMP, 0, 0},
+    [NDB_TYPE_DICT_STRING] = {"dict_string", sizeof(int32_t), NDB_TYPE_STRING, 1, 1},
+    [NDB_TYPE_STRING_VIEW] = {"string_view", sizeof(int32_t), NDB_TYPE_STRING, 0, 1},
+};
+
+const NDBTypeInfo* ndb_type_info(int32_t type_id) {
+    if (type_id < 0 || type_id >= NDB_NUM_TYPES) {
+        return NULL;
+    }
+    return &type_registry[type_id];
+}
+
+// =================== Formatting ===================
+
+#define MICROS_PER_DAY INT64_C(86400000000)
+
+// Proleptic Gregorian date of a day count since 1970-01-01
+static void civil_from_days(int64_t days, int* year, int* month, int* day) {
+    days += 719468;             // Count from 0000-03-01: leap days end the year
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t day_of_era = days - era * 146097;
+    int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int64_t shifted_month = (5 * day_of_year + 2) / 153;
+    *day = (int)(day_of_year - (153 * shifted_month + 2) / 5 + 1);
+    *month = (int)(shifted_month < 10 ? shifted_month + 3 : shifted_month - 9);
+    *year = (int)(year_of_era + era * 400 + (*month <= 2));
+}
+
+int format_ndb_value(const NDBTableC* table, int column_idx, int row_idx, char* buf, size_t size) {
+    if (is_ndb_value_null(table, column_idx, row_idx)) {
+        return snprintf(buf, size, "NULL");
+    }
+    const NDBArrayC* array = &table->columns[column_idx];
+    int year, month, day;
+    switch (array->type_id) {
+    case NDB_TYPE_INT32:
+        return snprintf(buf, size, "%d", ((const int32_t*)array->values)[row_idx]);
+    case NDB_TYPE_INT64:
+        return snprintf(buf, size, "%" PRId64, ((const int64_t*)array->values)[row_idx]);
+    case NDB_TYPE_FLOAT64:
+        return snprintf(buf, size, "%.17g", ((const double*)array->values)[row_idx]);
+    case NDB_TYPE_DATE32:
+        civil_from_days(((const int32_t*)array->values)[row_idx], &year, &month, &day);
+        return snprintf(buf, size, "%04d-%02d-%02d", year, month, day);
+    case NDB_TYPE_TIMESTAMP: {
+        int64_t micros = ((const int64_t*)array->values)[row_idx];
+        int64_t days = micros / MICROS_PER_DAY - (micros % MICROS_PER_DAY < 0);
+        int64_t time = micros - days * MICROS_PER_DAY;
+        civil_from_days(days, &year, &month, &day);
+        return snprintf(buf, size, "%04d-%02d-%02d %02d:%02d:%02d.%06d", year, month, day,
+                        (int)(time / 3600000000), (int)(time / 60000000 % 60), (int)(time / 1000000 % 60),
+                        (int)(time % 1000000));
+    }
+    case NDB_TYPE_STRING:
+    case NDB_TYPE_DICT_STRING:
+    case NDB_TYPE_STRING_VIEW: {
+        char* str;
+        int len;
+        get_ndb_string_value(table, column_idx, row_idx, &str, &len);
+        return snprintf(buf, size, "%.*s", len, str ? str : "");
+    }
+    default:
+        return snprintf(buf, size, "?");
+    }
+}
+
+// =================== Dictionary strings ===================
+
+NDBTableC* build_ndb_string_dictionary(const NDBTableC* table, int column) {
+    if (column < 0 || column >= table->num_columns || table->columns[column].type_id != NDB_TYPE_STRING) {
+        fprintf(stderr, "Error: dictionary source column %d is not a string column\n", column);
+        return NULL;
+    }
+
+    // Join-key codes number the distinct strings in first seen order
+    NDBKeyCodes codes;
+    if (encode_ndb_join_keys(table, &column, table, &column, 1, &codes) != 0) {
+        return NULL;
+    }
+    NDBFieldC field = {.name = "value", .type_id = NDB_TYPE_STRING, .nullable = 0};
+    NDBTableC* dictionary = create_ndb_table(codes.distinct, 1, &field);
+    NDBStringBuilder builder;
+    if (!dictionary || init_ndb_string_builder(&builder, dictionary, 0, 0) != 0) {
+        free_ndb_table(dictionary);
+        free_ndb_key_codes(&codes);
+        return NULL;
+    }
+    int32_t next = 0;
+    for (int row = 0; row < table->num_rows; row++) {
+        if (codes.right[row] != next) {
+            continue;
+        }
+        char* str;
+        int len;
+        get_ndb_string_value(table, column, row, &str, &len);
+        if (append_ndb_string(&builder, str, len) != 0) {
+            free_ndb_table(dictionary);
+            dictionary = NULL;
+            break;
+        }
+        next++;
+    }
+    if (dictionary) {
+        dictionary->num_rows = next;
+    }
+    free_ndb_key_codes(&codes);
+    return dictionary;
+}
+
+int encode_ndb_dictionary_column(const NDBTableC* src_table, int src_column,
+                                 const NDBTableC* dictionary,
+                                 NDBTableC* dst_table, int dst_column) {
+    if (src_column < 0 || src_column >= src_table->num_columns ||
+        src_table->columns[src_column].type_id != NDB_TYPE_STRING ||
+        dst_column < 0 || dst_column >= dst_table->num_columns ||
+        dst_table->columns[dst_column].type_id != NDB_TYPE_DICT_STRING ||
+        dictionary->num_columns != 1 || dictionary->columns[0].type_id != NDB_TYPE_STRING) {
+        fprintf(stderr, "Error: dictionary encoding needs a string source and a dictionary string target\n");
+        return -1;
+    }
+
+    int dictionary_column = 0;
+    NDBKeyCodes codes;
+    if (encode_ndb_join_keys(src_table, &src_column, dictionary, &dictionary_column, 1, &codes) != 0) {
+        return -1;
+    }
+    // Codes follow first appearance, so a dictionary of distinct strings
+    // numbers itself 0 .. num_rows - 1
+    int status = codes.distinct == dictionary->num_rows ? 0 : -1;
+    if (status != 0) {
+        fprintf(stderr, "Error: dictionary holds duplicate strings\n");
+    } else if (reserve_ndb_table_rows(dst_table, src_table->num_rows) != 0) {
+        status = -1;
+    }
+
+    NDBArrayC* dst = &dst_table->columns[dst_column];
+    if (status == 0) {
+        dst->dictionary = dictionary;
+        if (dst_table->num_rows < src_table->num_rows) {
+            dst_table->num_rows = src_table->num_rows;
+        }
+    }
+    int32_t* values = (int32_t*)dst->values;
+    for (int row = 0; status == 0 && row < src_table->num_rows; row++) {
+        if (is_ndb_value_null(src_table, src_column, row)) {
+            values[row] = 0;
+            set_ndb_value_null(dst_table, dst_column, row);
+        } else if (codes.left[row] < 0) {
+            fprintf(stderr, "Error: row %d holds a string missing from the dictionary\n", row);
+            status = -1;
+        } else {
+            values[row] = codes.left[row];
+        }
+    }
+    free_ndb_key_codes(&codes);
+    return status;
+}
+
+// =================== String views ===================
+
+NDBTableC* view_ndb_string_column(const NDBTableC* table, int column) {
+    if (column < 0 || column >= table->num_columns || table->columns[column].type_id != NDB_TYPE_STRING) {
+        fprintf(stderr, "Error: view source column %d is not a string column\n", column);
+        return NULL;
+    }
+    NDBFieldC field = {.name = table->fields[column].name, .type_id = NDB_TYPE_STRING,
+                       .nullable = table->fields[column].nullable};
+    NDBTableC* view = wrap_ndb_table(table->num_rows, 1, &field);
+    if (!view) {
+        return NULL;
+    }
+    // No release: the buffers stay the source table's
+    const NDBArrayC* src = &table->columns[column];
+    NDBArrayC* array = &view->columns[0];
+    array->validity = src->validity;
+    array->offsets = src->offsets;
+    array->values = src->values;
+    array->null_count = src->null_count;
+    array->value_capacity = src->value_capacity;
+    return view;
+}
@@ -0,0 +1,120 @@
+#include "rel/RelDialect.h"
+
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/DialectImplementation.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+using namespace mlir;
+using namespace ndb::rel;
+
+#include "rel/RelOpsDialect.cpp.inc"
+#include "rel/RelOpsEnums.cpp.inc"
+
+#define GET_TYPEDEF_CLASSES
+#include "rel/RelOpsTypes.cpp.inc"
+
+// =================== Dialect ===================
+
+void RelDialect::initialize() {
+    addTypes<
+#define GET_TYPEDEF_LIST
+#include "rel/RelOpsTypes.cpp.inc"
+        >();
+    addOperations<
+#define GET_OP_LIST
+#include "rel/RelOps.cpp.inc"
+        >();
+}
+
+// =================== Verifiers ===================
+
+// The lowering and the runtime handle int32 columns only
+static LogicalResult verifyStream(Operation* op, StreamType type) {
+    if (type.getNumColumns() == 0) {
+        return op->emitOpError("stream must have at least one column");
+    }
+    for (Type column : type.getColumnTypes()) {
+        if (!column.isSignlessInteger(32)) {
+            return op->emitOpError("stream columns must be i32, got ") << column;
+        }
+    }
+    return success();
+}
+
+static LogicalResult verifyColumn(Operation* op, int64_t column, unsigned num_columns, StringRef what) {
+    if (column < 0 || column >= num_columns) {
+        return op->emitOpError() << what << " column " << column << " out of range [0, " << num_columns << ")";
+    }
+    return success();
+}
+
+LogicalResult ScanOp::verify() {
+    StreamType type = getResult().getType();
+    if (failed(verifyStream(*this, type))) {
+        return failure();
+    }
+    if (getColumns().size() != type.getNumColumns()) {
+        return emitOpError("scans ") << getColumns().size() << " columns into a stream of "
+                                     << type.getNumColumns();
+    }
+    for (int32_t column : getColumns()) {
+        if (column < 0) {
+            return emitOpError("negative table column ") << column;
+        }
+    }
+    return success();
+}
+
+LogicalResult FilterOp::verify() {
+    StreamType type = getInput().getType();
+    if (failed(verifyStream(*this, type))) {
+        return failure();
+    }
+    return verifyColumn(*this, getColumn(), type.getNumColumns(), "filter");
+}
+
+LogicalResult ProjectOp::verify() {
+    StreamType input = getInput().getType();
+    StreamType result = getResult().getType();
+    if (failed(verifyStream(*this, input)) || failed(verifyStream(*this, result))) {
+        return failure();
+    }
+    if (getColumns().size() != result.getNumColumns()) {
+        return emitOpError("projects ") << getColumns().size() << " columns into a stream of "
+                                        << result.getNumColumns();
+    }
+    for (int32_t column : getColumns()) {
+        if (failed(verifyColumn(*this, column, input.getNumColumns(), "projected"))) {
+            return failure();
+        }
+    }
+    return success();
+}
+
+LogicalResult HashProbeOp::verify() {
+    StreamType input = getInput().getType();
+    StreamType result = getResult().getType();
+    if (failed(verifyStream(*this, input)) || failed(verifyStream(*this, result))) {
+        return failure();
+    }
+    if (failed(verifyColumn(*this, getKey(), input.getNumColumns(), "key"))) {
+        return failure();
+    }
+    // The lowering reads the payload columns from the build table
+    if (!getHashTable().getDefiningOp<HashBuildOp>()) {
+        return emitOpError("hash table must come from a rel.hash_build");
+    }
+    if (result.getNumColumns() != input.getNumColumns() + getBuildColumns().size()) {
+        return emitOpError("result must have the input columns followed by ")
+               << getBuildColumns().size() << " build columns";
+    }
+    for (int32_t column : getBuildColumns()) {
+        if (column < 0) {
+            return emitOpError("negative build column ") << column;
+        }
+    }
+    return success();
+}
+
+#define GET_OP_CLASSES
+#include "rel/RelOps.cpp.inc"
@@ -0,0 +1,143 @@
+#include "rel/RelDialect.h"
+#include "rel/RelPasses.h"
+
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+
+using namespace mlir;
+using namespace ndb::rel;
+
+// Rewrites that shrink pipelines before they are lowered: projections
+// collapse into the scan so unused columns are never loaded, and filters
+// move towards the scan so rejected rows skip projections and probes.
+
+namespace {
+
+// =================== Projections ===================
+
+// project(x, [0 .. n)) with n = columns of x is x itself
+struct FoldIdentityProject : OpRewritePattern<ProjectOp> {
+    using OpRewritePattern::OpRewritePattern;
+
+    LogicalResult matchAndRewrite(ProjectOp op, PatternRewriter& rewriter) const override {
+        ArrayRef<int32_t> columns = op.getColumns();
+        if (op.getType() != op.getInput().getType()) {
+            return failure();
+        }
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (columns[i] != (int32_t)i) {
+                return failure();
+            }
+        }
+        rewriter.replaceOp(op, op.getInput());
+        return success();
+    }
+};
+
+// project(project(x, a), b) = project(x, a[b[i]])
+struct ComposeProjects : OpRewritePattern<ProjectOp> {
+    using OpRewritePattern::OpRewritePattern;
+
+    LogicalResult matchAndRewrite(ProjectOp op, PatternRewriter& rewriter) const override {
+        auto inner = op.getInput().getDefiningOp<ProjectOp>();
+        if (!inner) {
+            return failure();
+        }
+        SmallVector<int32_t> columns;
+        for (int32_t column : op.getColumns()) {
+            columns.push_back(inner.getColumns()[column]);
+        }
+        rewriter.replaceOpWithNewOp<ProjectOp>(op, op.getType(), inner.getInput(), columns);
+        return success();
+    }
+};
+
+// project(scan(t, a), b) = scan(t, a[b[i]]) when nothing else reads the scan
+struct ProjectIntoScan : OpRewritePattern<ProjectOp> {
+    using OpRewritePattern::OpRewritePattern;
+
+    LogicalResult matchAndRewrite(ProjectOp op, PatternRewriter& rewriter) const override {
+        auto scan = op.getInput().getDefiningOp<ScanOp>();
+        if (!scan || !scan->hasOneUse()) {
+            return failure();
+        }
+        SmallVector<int32_t> columns;
+        for (int32_t column : op.getColumns()) {
+            columns.push_back(scan.getColumns()[column]);
+        }
+        rewriter.replaceOpWithNewOp<ScanOp>(op, op.getType(), scan.getTable(), columns);
+        return success();
+    }
+};
+
+// =================== Filters ===================
+
+// filter(project(x, p), c) = project(filter(x, p[c]), p)
+struct FilterBeforeProject : OpRewritePattern<FilterOp> {
+    using OpRewritePattern::OpRewritePattern;
+
+    LogicalResult matchAndRewrite(FilterOp op, PatternRewriter& rewriter) const override {
+        auto project = op.getInput().getDefiningOp<ProjectOp>();
+        if (!project || !project->hasOneUse()) {
+            return failure();
+        }
+        auto filter = rewriter.create<FilterOp>(op.getLoc(), project.getInput(),
+                                                project.getColumns()[op.getColumn()],
+                                                op.getPredicate(), op.getConstant());
+        rewriter.replaceOpWithNewOp<ProjectOp>(op, op.getType(), filter.getResult(), project.getColumns());
+        return success();
+    }
+};
+
+// A filter on a probe-side column runs before the probe, so rejected rows
+// are never looked up or duplicated by matches
+struct FilterBeforeProbe : OpRewritePattern<FilterOp> {
+    using OpRewritePattern::OpRewritePattern;
+
+    LogicalResult matchAndRewrite(FilterOp op, PatternRewriter& rewriter) const override {
+        auto probe = op.getInput().getDefiningOp<HashProbeOp>();
+        if (!probe || !probe->hasOneUse() || op.getColumn() >= probe.getInput().getType().getNumColumns()) {
+            return failure();
+        }
+        auto filter = rewriter.create<FilterOp>(op.getLoc(), probe.getInput(), op.getColumn(),
+                                                op.getPredicate(), op.getConstant());
+        rewriter.replaceOpWithNewOp<HashProbeOp>(op, op.getType(), filter.getResult(), probe.getHashTable(),
+                                                 probe.getKey(), probe.getBuildColumns());
+        return success();
+    }
+};
+
+// =================== Pass ===================
+
+struct RelFusionPass : PassWrapper<RelFusionPass, OperationPass<ModuleOp>> {
+    MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(RelFusionPass)
+
+    StringRef getArgument() const override { return "rel-fuse"; }
+    StringRef getDescription() const override {
+        return "Fold projections into scans and move filters towards the scan";
+    }
+
+    void runOnOperation() override {
+        RewritePatternSet patterns(&getContext());
+        ProjectOp::getCanonicalizationPatterns(patterns, &getContext());
+        FilterOp::getCanonicalizationPatterns(patterns, &getContext());
+        if (failed(applyPatternsGreedily(getOperation(), std::move(patterns)))) {
+            signalPassFailure();
+        }
+    }
+};
+
+} // namespace
+
+void ProjectOp::getCanonicalizationPatterns(RewritePatternSet& results, MLIRContext* context) {
+    results.add<FoldIdentityProject, ComposeProjects, ProjectIntoScan>(context);
+}
+
+void FilterOp::getCanonicalizationPatterns(RewritePatternSet& results, MLIRContext* context) {
+    results.add<FilterBeforeProject, FilterBeforeProbe>(context);
+}
+
+std::unique_ptr<Pass> ndb::rel::createRelFusionPass() {
+    return std::make_unique<RelFusionPass>();
+}
@@ -0,0 +1,408 @@
+#include "rel/RelDialect.h"
+#include "rel/RelPasses.h"
+
+#include "mlir/Conversion/ArithToLLVM/ArithToLLVM.h"
+#include "mlir/Conversion/ControlFlowToLLVM/ControlFlowToLLVM.h"
+#include "mlir/Conversion/FuncToLLVM/ConvertFuncToLLVMPass.h"
+#include "mlir/Conversion/ReconcileUnrealizedCasts/ReconcileUnrealizedCasts.h"
+#include "mlir/Conversion/SCFToControlFlow/SCFToControlFlow.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Pass/PassRegistry.h"
+#include "mlir/Transforms/Passes.h"
+
+using namespace mlir;
+using namespace ndb::rel;
+
+// A pipeline rel.scan -> (filter | project | hash_probe)* -> rel.materialize
+// becomes one loop over the scanned rows. Each operator is emitted inline
+// into the body of the previous one: consecutive filters become a single
+// branch-free predicate guarding the rest of the pipeline, projections
+// only rename SSA values, and a probe opens an inner loop over the build
+// rows of the key's group. Streams therefore never exist in memory; only
+// the rows reaching the sink are written. Column pointers and hash table
+// arrays are loaded before the loop, which leaves LLVM a counted loop of
+// loads, compares and selects to optimize.
+
+namespace {
+
+// =================== Runtime ===================
+
+// Declarations of the columnar_rel_runtime.h entry points
+struct Runtime {
+    LLVM::LLVMFuncOp num_rows;
+    LLVM::LLVMFuncOp int_column;
+    LLVM::LLVMFuncOp hash_build;
+    LLVM::LLVMFuncOp hash_free;
+    LLVM::LLVMFuncOp lookup;
+    LLVM::LLVMFuncOp group_offsets;
+    LLVM::LLVMFuncOp group_rows;
+    LLVM::LLVMFuncOp append_int_row;
+};
+
+static LLVM::LLVMFuncOp declareFunction(ModuleOp module, StringRef name, Type result, ArrayRef<Type> params) {
+    if (auto fn = module.lookupSymbol<LLVM::LLVMFuncOp>(name)) {
+        return fn;
+    }
+    OpBuilder builder(module.getContext());
+    builder.setInsertionPointToStart(module.getBody());
+    return builder.create<LLVM::LLVMFuncOp>(module.getLoc(), name, LLVM::LLVMFunctionType::get(result, params));
+}
+
+static Runtime declareRuntime(ModuleOp module) {
+    MLIRContext* ctx = module.getContext();
+    Type ptr = LLVM::LLVMPointerType::get(ctx);
+    Type i32 = IntegerType::get(ctx, 32);
+    Type void_type = LLVM::LLVMVoidType::get(ctx);
+    Runtime rt;
+    rt.num_rows = declareFunction(module, "ndb_rel_num_rows", i32, {ptr});
+    rt.int_column = declareFunction(module, "ndb_rel_int_column", ptr, {ptr, i32});
+    rt.hash_build = declareFunction(module, "ndb_rel_hash_build", ptr, {ptr, i32});
+    rt.hash_free = declareFunction(module, "ndb_rel_hash_free", void_type, {ptr});
+    rt.lookup = declareFunction(module, "ndb_rel_lookup", i32, {ptr, i32});
+    rt.group_offsets = declareFunction(module, "ndb_rel_group_offsets", ptr, {ptr});
+    rt.group_rows = declareFunction(module, "ndb_rel_group_rows", ptr, {ptr});
+    rt.append_int_row = declareFunction(module, "ndb_rel_append_int_row", i32, {ptr, ptr, i32});
+    return rt;
+}
+
+// =================== Pipelines ===================
+
+// A built hash table and the table its payload columns come from
+struct HashTableInfo {
+    Value handle;
+    Value build_table;
+};
+
+// Arrays of a probe stage, loaded once before the scan loop
+struct ProbeArrays {
+    Value offsets;
+    Value rows;
+    SmallVector<Value> build_columns;
+};
+
+class PipelineLowering {
+public:
+    PipelineLowering(OpBuilder& builder, const Runtime& rt, const DenseMap<Value, HashTableInfo>& hash_tables,
+                     func::FuncOp func)
+        : b(builder), rt(rt), hash_tables(hash_tables), func(func) {
+        MLIRContext* ctx = builder.getContext();
+        ptr_type = LLVM::LLVMPointerType::get(ctx);
+        i32 = builder.getI32Type();
+        i64 = builder.getI64Type();
+    }
+
+    LogicalResult lower(MaterializeOp sink);
+
+private:
+    Value call(LLVM::LLVMFuncOp fn, ValueRange args) {
+        return b.create<LLVM::CallOp>(loc, fn, args).getResult();
+    }
+    Value constI32(int32_t v) { return b.create<arith::ConstantOp>(loc, b.getI32IntegerAttr(v)); }
+    Value constI64(int64_t v) { return b.create<arith::ConstantOp>(loc, b.getI64IntegerAttr(v)); }
+    Value loadI32(Value base, Value index) {
+        Value address = b.create<LLVM::GEPOp>(loc, ptr_type, i32, base, ValueRange{index});
+        return b.create<LLVM::LoadOp>(loc, i32, address);
+    }
+    // Column pointer of a table; rows_valid turns false when it is NULL
+    Value columnPointer(Value table, int32_t column) {
+        Value values = call(rt.int_column, {table, constI32(column)});
+        Value null = b.create<LLVM::ZeroOp>(loc, ptr_type);
+        Value valid = b.create<LLVM::ICmpOp>(loc, LLVM::ICmpPredicate::ne, values, null);
+        rows_valid = b.create<arith::AndIOp>(loc, rows_valid, valid);
+        return values;
+    }
+
+    Value compare(FilterOp filter, ArrayRef<Value> values);
+    void emitStage(size_t stage, SmallVector<Value> values);
+    void emitProbe(HashProbeOp probe, size_t stage, SmallVector<Value> values);
+    void emitMaterialize(MaterializeOp sink, ArrayRef<Value> values);
+
+    OpBuilder& b;
+    const Runtime& rt;
+    const DenseMap<Value, HashTableInfo>& hash_tables;
+    func::FuncOp func;
+    Location loc = UnknownLoc::get(b.getContext());
+    Type ptr_type, i32, i64;
+
+    SmallVector<Operation*> chain;              // Stages after the scan, sink last
+    DenseMap<Operation*, ProbeArrays> probes;
+    Value rows_valid;                           // All column pointers non-NULL
+    Value result_table;
+    Value row_buffer;                           // One output row, passed to the runtime
+};
+
+LogicalResult PipelineLowering::lower(MaterializeOp sink) {
+    loc = sink.getLoc();
+
+    // Walk from the sink back to the scan
+    ScanOp scan;
+    for (Value stream = sink.getInput(); !scan;) {
+        Operation* op = stream.getDefiningOp();
+        if (!op || !isa<ScanOp, FilterOp, ProjectOp, HashProbeOp>(op)) {
+            return sink.emitOpError("stream does not come from a rel.scan pipeline");
+        }
+        scan = dyn_cast<ScanOp>(op);
+        if (!scan) {
+            chain.push_back(op);
+            stream = op->getOperand(0);
+        }
+    }
+    std::reverse(chain.begin(), chain.end());
+    chain.push_back(sink);
+
+    // Tables are function arguments, converted to !llvm.ptr at the end
+    auto asPointer = [&](Value table) -> Value {
+        return b.create<UnrealizedConversionCastOp>(loc, ptr_type, table).getResult(0);
+    };
+
+    // Everything loop invariant goes before the loop
+    rows_valid = b.create<arith::ConstantOp>(loc, b.getBoolAttr(true));
+    Value table = asPointer(scan.getTable());
+    SmallVector<Value> columns;
+    for (int32_t column : scan.getColumns()) {
+        columns.push_back(columnPointer(table, column));
+    }
+    for (Operation* op : chain) {
+        auto probe = dyn_cast<HashProbeOp>(op);
+        if (!probe) {
+            continue;
+        }
+        HashTableInfo info = hash_tables.lookup(probe.getHashTable());
+        ProbeArrays& arrays = probes[op];
+        arrays.offsets = call(rt.group_offsets, {info.handle});
+        arrays.rows = call(rt.group_rows, {info.handle});
+        for (int32_t column : probe.getBuildColumns()) {
+            arrays.build_columns.push_back(columnPointer(info.build_table, column));
+        }
+    }
+    result_table = asPointer(sink.getResultTable());
+    {
+        OpBuilder::InsertionGuard guard(b);
+        b.setInsertionPointToStart(&func.getBody().front());
+        Value width = b.create<arith::ConstantOp>(loc, b.getI64IntegerAttr(sink.getInput().getType().getNumColumns()));
+        row_buffer = b.create<LLVM::AllocaOp>(loc, ptr_type, i32, width);
+    }
+
+    // A column that is not int32 stops the pipeline before the first row
+    Value num_rows = b.create<arith::ExtSIOp>(loc, i64, call(rt.num_rows, {table}));
+    num_rows = b.create<arith::SelectOp>(loc, rows_valid, num_rows, constI64(0));
+
+    auto loop = b.create<scf::ForOp>(loc, constI64(0), num_rows, constI64(1));
+    OpBuilder::InsertionGuard guard(b);
+    b.setInsertionPoint(loop.getBody()->getTerminator());
+    SmallVector<Value> values;
+    for (Value column : columns) {
+        values.push_back(loadI32(column, loop.getInductionVar()));
+    }
+    emitStage(0, values);
+    return success();
+}
+
+Value PipelineLowering::compare(FilterOp filter, ArrayRef<Value> values) {
+    arith::CmpIPredicate predicate = arith::CmpIPredicate::eq;
+    switch (filter.getPredicate()) {
+    case CmpPredicate::eq: predicate = arith::CmpIPredicate::eq; break;
+    case CmpPredicate::ne: predicate = arith::CmpIPredicate::ne; break;
+    case CmpPredicate::lt: predicate = arith::CmpIPredicate::slt; break;
+    case CmpPredicate::le: predicate = arith::CmpIPredicate::sle; break;
+    case CmpPredicate::gt: predicate = arith::CmpIPredicate::sgt; break;
+    case CmpPredicate::ge: predicate = arith::CmpIPredicate::sge; break;
+    }
+    return b.create<arith::CmpIOp>(loc, predicate, values[filter.getColumn()],
+                                   constI32((int32_t)filter.getConstant()));
+}
+
+void PipelineLowering::emitStage(size_t stage, SmallVector<Value> values) {
+    Operation* op = chain[stage];
+
+    if (auto filter = dyn_cast<FilterOp>(op)) {
+        // Adjacent filters: one combined predicate, one branch
+        Value cond = compare(filter, values);
+        size_t next = stage + 1;
+        while (auto more = dyn_cast<FilterOp>(chain[next])) {
+            cond = b.create<arith::AndIOp>(loc, cond, compare(more, values));
+            next++;
+        }
+        auto if_op = b.create<scf::IfOp>(loc, cond, /*withElseRegion=*/false);
+        OpBuilder::InsertionGuard guard(b);
+        b.setInsertionPoint(if_op.thenBlock()->getTerminator());
+        emitStage(next, values);
+        return;
+    }
+
+    if (auto project = dyn_cast<ProjectOp>(op)) {
+        SmallVector<Value> projected;
+        for (int32_t column : project.getColumns()) {
+            projected.push_back(values[column]);
+        }
+        emitStage(stage + 1, projected);
+        return;
+    }
+
+    if (auto probe = dyn_cast<HashProbeOp>(op)) {
+        emitProbe(probe, stage, values);
+        return;
+    }
+
+    emitMaterialize(cast<MaterializeOp>(op), values);
+}
+
+void PipelineLowering::emitProbe(HashProbeOp probe, size_t stage, SmallVector<Value> values) {
+    const ProbeArrays& arrays = probes.find(probe.getOperation())->second;
+    Value handle = hash_tables.lookup(probe.getHashTable()).handle;
+    Value group = call(rt.lookup, {handle, values[probe.getKey()]});
+    Value found = b.create<arith::CmpIOp>(loc, arith::CmpIPredicate::sge, group, constI32(0));
+    auto if_op = b.create<scf::IfOp>(loc, found, /*withElseRegion=*/false);
+    OpBuilder::InsertionGuard guard(b);
+    b.setInsertionPoint(if_op.thenBlock()->getTerminator());
+
+    // Build rows of the group: rows[offsets[group] .. offsets[group + 1])
+    Value g = b.create<arith::ExtSIOp>(loc, i64, group);
+    Value begin = b.create<arith::ExtSIOp>(loc, i64, loadI32(arrays.offsets, g));
+    Value g_next = b.create<arith::AddIOp>(loc, g, constI64(1));
+    Value end = b.create<arith::ExtSIOp>(loc, i64, loadI32(arrays.offsets, g_next));
+    auto matches = b.create<scf::ForOp>(loc, begin, end, constI64(1));
+    b.setInsertionPoint(matches.getBody()->getTerminator());
+    Value row = b.create<arith::ExtSIOp>(loc, i64, loadI32(arrays.rows, matches.getInductionVar()));
+    for (Value column : arrays.build_columns) {
+        values.push_back(loadI32(column, row));
+    }
+    emitStage(stage + 1, values);
+}
+
+void PipelineLowering::emitMaterialize(MaterializeOp sink, ArrayRef<Value> values) {
+    for (size_t i = 0; i < values.size(); i++) {
+        Value slot = b.create<LLVM::GEPOp>(loc, ptr_type, i32, row_buffer, ValueRange{constI64((int64_t)i)});
+        b.create<LLVM::StoreOp>(loc, values[i], slot);
+    }
+    call(rt.append_int_row, {result_table, row_buffer, constI32((int32_t)values.size())});
+}
+
+// =================== Pass ===================
+
+struct ConvertRelToLLVMPass : PassWrapper<ConvertRelToLLVMPass, OperationPass<ModuleOp>> {
+    MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(ConvertRelToLLVMPass)
+
+    StringRef getArgument() const override { return "convert-rel-to-llvm"; }
+    StringRef getDescription() const override {
+        return "Lower rel pipelines to fused loops calling the columnar runtime";
+    }
+    void getDependentDialects(DialectRegistry& registry) const override {
+        registry.insert<arith::ArithDialect, scf::SCFDialect, LLVM::LLVMDialect>();
+    }
+
+    void runOnOperation() override {
+        ModuleOp module = getOperation();
+        Runtime rt = declareRuntime(module);
+        WalkResult result = module.walk([&](func::FuncOp func) {
+            return failed(lowerFunction(func, rt)) ? WalkResult::interrupt() : WalkResult::advance();
+        });
+        if (result.wasInterrupted()) {
+            signalPassFailure();
+        }
+    }
+
+    LogicalResult lowerFunction(func::FuncOp func, const Runtime& rt);
+};
+
+LogicalResult ConvertRelToLLVMPass::lowerFunction(func::FuncOp func, const Runtime& rt) {
+    if (func.isExternal()) {
+        return success();
+    }
+    MLIRContext* ctx = func.getContext();
+    Type ptr_type = LLVM::LLVMPointerType::get(ctx);
+    OpBuilder b(ctx);
+
+    // Hash tables are built where the rel.hash_build was and freed before
+    // every return
+    DenseMap<Value, HashTableInfo> hash_tables;
+    SmallVector<HashBuildOp> builds;
+    func.walk([&](HashBuildOp op) { builds.push_back(op); });
+    for (HashBuildOp op : builds) {
+        b.setInsertionPoint(op);
+        Value table = b.create<UnrealizedConversionCastOp>(op.getLoc(), ptr_type, op.getTable()).getResult(0);
+        Value key = b.create<arith::ConstantOp>(op.getLoc(), b.getI32IntegerAttr((int32_t)op.getKey()));
+        Value handle = b.create<LLVM::CallOp>(op.getLoc(), rt.hash_build, ValueRange{table, key}).getResult();
+        hash_tables[op.getResult()] = HashTableInfo{handle, table};
+    }
+    func.walk([&](func::ReturnOp ret) {
+        b.setInsertionPoint(ret);
+        for (auto& entry : hash_tables) {
+            b.create<LLVM::CallOp>(ret.getLoc(), rt.hash_free, ValueRange{entry.second.handle});
+        }
+    });
+
+    // One fused loop per sink
+    SmallVector<MaterializeOp> sinks;
+    func.walk([&](MaterializeOp op) { sinks.push_back(op); });
+    for (MaterializeOp sink : sinks) {
+        b.setInsertionPoint(sink);
+        PipelineLowering pipeline(b, rt, hash_tables, func);
+        if (failed(pipeline.lower(sink))) {
+            return failure();
+        }
+    }
+
+    // All rel ops are now dead; erase users before producers
+    SmallVector<Operation*> rel_ops;
+    func.walk([&](Operation* op) {
+        if (isa_and_nonnull<RelDialect>(op->getDialect())) {
+            rel_ops.push_back(op);
+        }
+    });
+    for (Operation* op : llvm::reverse(rel_ops)) {
+        op->dropAllUses();
+        op->erase();
+    }
+
+    // !rel.table arguments become pointers, making the casts no-ops
+    Block& entry = func.getBody().front();
+    for (BlockArgument arg : entry.getArguments()) {
+        if (isa<TableType>(arg.getType())) {
+            arg.setType(ptr_type);
+        } else if (isa<HashTableType, StreamType>(arg.getType())) {
+            return func.emitOpError("rel hash tables and streams cannot cross function boundaries");
+        }
+    }
+    func.setType(FunctionType::get(ctx, entry.getArgumentTypes(), func.getFunctionType().getResults()));
+    SmallVector<UnrealizedConversionCastOp> casts;
+    func.walk([&](UnrealizedConversionCastOp cast) { casts.push_back(cast); });
+    for (UnrealizedConversionCastOp cast : casts) {
+        if (cast.getNumOperands() == 1 && cast.getOperand(0).getType() == cast.getResult(0).getType()) {
+            cast.getResult(0).replaceAllUsesWith(cast.getOperand(0));
+            cast.erase();
+        }
+    }
+    return success();
+}
+
+} // namespace
+
+std::unique_ptr<Pass> ndb::rel::createConvertRelToLLVMPass() {
+    return std::make_unique<ConvertRelToLLVMPass>();
+}
+
+void ndb::rel::buildRelToLLVMPipeline(OpPassManager& pm) {
+    pm.addPass(createRelFusionPass());
+    pm.addPass(createCanonicalizerPass());
+    pm.addPass(createConvertRelToLLVMPass());
+    pm.addPass(createCSEPass());
+    pm.addPass(createSCFToControlFlowPass());
+    pm.addPass(createArithToLLVMConversionPass());
+    pm.addPass(createConvertControlFlowToLLVMPass());
+    pm.addPass(createConvertFuncToLLVMPass());
+    pm.addPass(createReconcileUnrealizedCastsPass());
+}
+
+void ndb::rel::registerRelPasses() {
+    registerPass([] { return createRelFusionPass(); });
+    registerPass([] { return createConvertRelToLLVMPass(); });
+    PassPipelineRegistration<>("rel-to-llvm", "Lower rel pipelines down to the LLVM dialect",
+                               buildRelToLLVMPipeline);
+}
@@ -0,0 +1,24 @@
+// rel-opt: run rel dialect passes over .mlir files, e.g.
+//   rel-opt --rel-to-llvm query.mlir | mlir-translate --mlir-to-llvmir
+// and link the result with the columnar library (columnar_rel_runtime.h).
+
+#include "rel/RelDialect.h"
+#include "rel/RelPasses.h"
+
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlow.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/DialectRegistry.h"
+#include "mlir/Tools/mlir-opt/MlirOptMain.h"
+#include "mlir/Transforms/Passes.h"
+
+int main(int argc, char** argv) {
+    mlir::DialectRegistry registry;
+    registry.insert<ndb::rel::RelDialect, mlir::func::FuncDialect, mlir::arith::ArithDialect,
+                    mlir::scf::SCFDialect, mlir::cf::ControlFlowDialect, mlir::LLVM::LLVMDialect>();
+    mlir::registerTransformsPasses();
+    ndb::rel::registerRelPasses();
+    return mlir::asMainReturnCode(mlir::MlirOptMain(argc, argv, "NDB relational optimizer\n", registry));
+}